@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Batch.h"
+#include "Board.h"
+#include "ChessGame.h"
+#include "KOTHChessGame.h"
+#include "SpookyChessGame.h"
+#include "Game.h"
+#include "Prompts.h"
+
+namespace {
+
+//reads a square like "e2", false if it isn't one
+bool parse_square(const std::string& s, Position& pos) {
+    if (s.size() != 2 || s[0] < 'a' || s[0] > 'h' || s[1] < '1' || s[1] > '8') {
+        return false;
+    }
+    pos = Position(s[0] - 'a', s[1] - '1');
+    return true;
+}
+
+}
+
+
+void BatchRunner::run(std::istream& script) {
+    QuietPrompts quiet;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string line;
+    start_game();
+    while (std::getline(script, line)) {
+        std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+        std::istringstream is(line);
+        std::string first;
+        if (!(is >> first) || first[0] == '#') {
+            continue;
+        }
+        if (first == "new") {
+            end_game();
+            start_game();
+            continue;
+        }
+        play_line(line);
+    }
+    end_game();
+    _report.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool BatchRunner::run_file(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if (!input_file.is_open()) {
+        return false;
+    }
+    run(input_file);
+    return true;
+}
+
+void BatchRunner::start_game() {
+    delete _game;
+    if (_variant == VARIANT_KOTH) {
+        _game = new KOTHChessGame();
+    } else if (_variant == VARIANT_SPOOKY) {
+        _game = new SpookyChessGame();
+    } else {
+        _game = new ChessGame();
+    }
+    _finished = false;
+    _game_moves = 0;
+}
+
+void BatchRunner::end_game() {
+    if (_game == nullptr) {
+        return;
+    }
+    //a "new" at the end of a script doesn't make an empty game
+    if (_game_moves > 0) {
+        _report.games++;
+        if (!_finished) {
+            _report.unfinished++;
+        }
+    }
+    delete _game;
+    _game = nullptr;
+}
+
+//submit one "fr fr" line and record what the rules made of it
+void BatchRunner::play_line(const std::string& line) {
+    std::istringstream is(line);
+    std::string one, two;
+    Position start, end;
+    if (!(is >> one >> two) || !parse_square(one, start) || !parse_square(two, end)) {
+        _report.parse_errors++;
+        return;
+    }
+    _report.moves++;
+    _game_moves++;
+    if (_finished) {
+        _report.illegal++;
+        _report.errors[status::GAME_OVER]++;
+        return;
+    }
+    Player mover = _game->player_turn();
+    int result = _game->make_move(start, end);
+    if (result < 0) {
+        _report.illegal++;
+        _report.errors[result]++;
+        return;
+    }
+    if (draw_status(result)) {
+        _report.draws++;
+        _finished = true;
+    } else if (result == status::MOVE_CHECKMATE || result == status::MOVE_CAPTURE_HILL) {
+        //in spooky chess the ghost can leave the mover itself mated, or
+        //both kings in check with only the opponent mated
+        Board board;
+        Player winner = mover;
+        Player opponent = static_cast<Player>(1 - mover);
+        if (_game->to_board(board) && board.in_check(mover) &&
+            !(board.in_check(opponent) && !board.can_move(opponent))) {
+            winner = opponent;
+        }
+        if (winner == WHITE) {
+            _report.white_wins++;
+        } else {
+            _report.black_wins++;
+        }
+        _finished = true;
+    }
+}
+
+void BatchRunner::print_report(std::ostream& os) const {
+    double rate = _report.seconds > 0 ? _report.moves / _report.seconds : 0;
+    os << "games:           " << _report.games << "\n"
+       << "moves validated: " << _report.moves << "\n"
+       << "illegal moves:   " << _report.illegal << "\n"
+       << "parse errors:    " << _report.parse_errors << "\n"
+       << "white wins:      " << _report.white_wins << "\n"
+       << "black wins:      " << _report.black_wins << "\n"
+       << "draws:           " << _report.draws << "\n"
+       << "unfinished:      " << _report.unfinished << "\n"
+       << "seconds:         " << std::fixed << std::setprecision(3) << _report.seconds << "\n"
+       << "moves/second:    " << std::setprecision(0) << rate << "\n";
+    for (std::map<int, unsigned long>::const_iterator it = _report.errors.begin(); it != _report.errors.end(); ++it) {
+        os << "  status " << it->first << ": " << it->second << "\n";
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include "Board.h"
+#include "Game.h"
+
+/*
+Headless replay of move scripts through the rules engine, for regression
+and load testing. A script holds the same "fr fr" lines a player would type.
+A line reading "new" starts the next game, blank lines and lines starting
+with '#' are skipped. Prompts output is discarded while replaying.
+*/
+
+// Totals collected over every replayed game
+struct BatchReport {
+    unsigned long games;
+    unsigned long moves;          // every move line submitted
+    unsigned long illegal;        // moves the rules rejected
+    unsigned long parse_errors;   // lines that were not a move at all
+    unsigned long white_wins, black_wins, draws, unfinished;
+    std::map<int, unsigned long> errors;   // status code -> count
+    double seconds;
+
+    BatchReport() : games(0), moves(0), illegal(0), parse_errors(0),
+                    white_wins(0), black_wins(0), draws(0), unfinished(0), seconds(0) {}
+};
+
+
+class BatchRunner {
+
+public:
+
+    // Replays games of the given variant
+    BatchRunner(Variant variant) : _variant(variant), _game(nullptr), _finished(false), _game_moves(0) {}
+
+    ~BatchRunner() { delete _game; }
+
+    // Replay every game in the stream
+    void run(std::istream& script);
+
+    // Replay a script file. Returns false if it can't be opened.
+    bool run_file(const std::string& filename);
+
+    const BatchReport& report() const { return _report; }
+
+    // Print throughput, illegal move counts and results
+    void print_report(std::ostream& os) const;
+
+private:
+
+    Variant _variant;
+    Game* _game;
+    bool _finished;
+    unsigned long _game_moves;
+    BatchReport _report;
+
+    void start_game();
+
+    void end_game();
+
+    void play_line(const std::string& line);
+
+};
+
+#endif // BATCH_H
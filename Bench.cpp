@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Bench.h"
+#include "Board.h"
+#include "Engine.h"
+#include "Fen.h"
+
+namespace {
+
+struct BenchPosition {
+    Variant variant;
+    int reduction;          // plies less than the bench depth
+    const char* fen;
+};
+
+//openings, middlegames with tactics, castling and promotions, endgames,
+//a King of the Hill race and Spooky Chess chance nodes, which multiply
+//the tree so much they're searched two plies shallower. Changing any of
+//them changes the signature.
+const BenchPosition BENCH_POSITIONS[] = {
+    {VARIANT_CHESS, 0, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {VARIANT_CHESS, 0, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {VARIANT_CHESS, 0, "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+    {VARIANT_CHESS, 0, "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"},
+    {VARIANT_CHESS, 0, "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8"},
+    {VARIANT_CHESS, 0, "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1"},
+    {VARIANT_CHESS, 0, "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 14"},
+    {VARIANT_CHESS, 0, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {VARIANT_CHESS, 0, "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"},
+    {VARIANT_CHESS, 0, "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1"},
+    {VARIANT_KOTH, 0, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {VARIANT_KOTH, 0, "8/pp3k2/2p5/8/8/2P5/PP2K3/8 w - - 0 30"},
+    {VARIANT_SPOOKY, 2, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ghost d5;"},
+    {VARIANT_SPOOKY, 2, "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4 ghost a6;"},
+};
+
+}
+
+BenchReport run_bench(int depth, std::ostream* progress) {
+    BenchReport report;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const BenchPosition& p : BENCH_POSITIONS) {
+        FenPosition fen;
+        Board board;
+        parse_fen(p.fen, p.variant, fen);
+        fen_to_board(fen, p.variant, board);
+        SearchLimits limits;
+        limits.depth = std::max(1, depth - p.reduction);
+        Engine engine(16);
+        engine.set_use_tablebases(false);
+        engine.search(board, limits);
+        report.positions++;
+        report.nodes += engine.nodes();
+        if (progress) {
+            *progress << "position " << report.positions << ": " << engine.nodes() << " nodes" << std::endl;
+        }
+    }
+    report.milliseconds = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return report;
+}
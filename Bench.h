@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <iostream>
+
+/*
+Search benchmark over a fixed set of built-in positions (standard chess,
+King of the Hill and Spooky Chess) searched to a fixed depth, two plies
+less in Spooky Chess.
+
+Each position is searched by a fresh engine with one thread, a 16 MB
+transposition table and no opening book or tablebases, so the node total
+depends on nothing but the search code: it is the same on every machine
+and every run, and a change to it means the search changed. The time and
+nodes per second measure the build and the machine.
+*/
+
+static const int BENCH_DEPTH = 6;
+
+struct BenchReport {
+    int positions;
+    uint64_t nodes;
+    int milliseconds;
+
+    BenchReport() : positions(0), nodes(0), milliseconds(0) {}
+
+    uint64_t nodes_per_second() const { return nodes * 1000 / (uint64_t) (milliseconds + 1); }
+};
+
+// Search every bench position to `depth', printing a line for each to
+// `progress' when it isn't null
+BenchReport run_bench(int depth = BENCH_DEPTH, std::ostream* progress = nullptr);
+
+#endif // BENCH_H
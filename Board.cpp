@@ -0,0 +1,573 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Board.h"
+#include "Piece.h"
+#include "Hill.h"
+
+namespace {
+
+const int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+const int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+//first four are rook directions, last four bishop directions
+const int RAY_STEPS[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+
+// Lookup tables built once: jump targets and the squares along each ray
+struct Tables {
+    int knight[64][8], knight_count[64];
+    int king[64][8], king_count[64];
+    int ray[64][8][7], ray_count[64][8];
+    uint64_t piece_key[32][64];
+    uint64_t unmoved_key[64];
+    uint64_t side_key;
+
+    Tables() {
+        for (int sq = 0; sq < 64; sq++) {
+            int x = square_x(sq), y = square_y(sq);
+            knight_count[sq] = king_count[sq] = 0;
+            for (int d = 0; d < 8; d++) {
+                int nx = x + KNIGHT_STEPS[d][0], ny = y + KNIGHT_STEPS[d][1];
+                if (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+                    knight[sq][knight_count[sq]++] = make_square(nx, ny);
+                }
+                nx = x + KING_STEPS[d][0];
+                ny = y + KING_STEPS[d][1];
+                if (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+                    king[sq][king_count[sq]++] = make_square(nx, ny);
+                }
+                ray_count[sq][d] = 0;
+                nx = x + RAY_STEPS[d][0];
+                ny = y + RAY_STEPS[d][1];
+                while (nx >= 0 && nx < 8 && ny >= 0 && ny < 8) {
+                    ray[sq][d][ray_count[sq][d]++] = make_square(nx, ny);
+                    nx += RAY_STEPS[d][0];
+                    ny += RAY_STEPS[d][1];
+                }
+            }
+        }
+        //zobrist keys from a fixed splitmix64 stream so hashes are reproducible
+        uint64_t state = 0x5EED5EED5EEDULL;
+        for (int c = 0; c < 32; c++) {
+            for (int sq = 0; sq < 64; sq++) {
+                piece_key[c][sq] = next(state);
+            }
+        }
+        for (int sq = 0; sq < 64; sq++) {
+            unmoved_key[sq] = next(state);
+        }
+        side_key = next(state);
+    }
+
+    static uint64_t next(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+//kings and rooks remember whether they moved since it decides castling
+bool castling_piece(uint8_t code) {
+    int type = code_type(code);
+    return code != 0 && (type == KING_ENUM || type == ROOK_ENUM);
+}
+
+}
+
+
+std::string move_to_string(Move m) {
+    std::string s;
+    s += (char) ('a' + square_x(move_from(m)));
+    s += (char) ('1' + square_y(move_from(m)));
+    s += (char) ('a' + square_x(move_to(m)));
+    s += (char) ('1' + square_y(move_to(m)));
+    if (move_flags(m) & FLAG_PROMOTION) {
+        s += 'q';
+    }
+    return s;
+}
+
+
+Board::Board(Variant variant) : _variant(variant) {
+    clear();
+}
+
+Board Board::start_position(Variant variant) {
+    Board b(variant);
+    const int back[8] = {
+        ROOK_ENUM, KNIGHT_ENUM, BISHOP_ENUM, QUEEN_ENUM,
+        KING_ENUM, BISHOP_ENUM, KNIGHT_ENUM, ROOK_ENUM
+    };
+    for (int x = 0; x < 8; x++) {
+        b.put(make_square(x, 0), piece_code(back[x], WHITE));
+        b.put(make_square(x, 1), piece_code(PAWN_ENUM, WHITE));
+        b.put(make_square(x, 6), piece_code(PAWN_ENUM, BLACK));
+        b.put(make_square(x, 7), piece_code(back[x], BLACK));
+    }
+    if (variant == VARIANT_SPOOKY) {
+        b.put(make_square(0, 4), GHOST_CODE);
+    }
+    b.refresh();
+    return b;
+}
+
+void Board::clear() {
+    std::memset(_squares, 0, sizeof(_squares));
+    _moved = 0;
+    _side = WHITE;
+    _turn = 1;
+    _king[WHITE] = _king[BLACK] = -1;
+    _ghost = -1;
+    _key = 0;
+}
+
+void Board::set_moved(int sq, bool moved) {
+    if (moved) {
+        _moved |= 1ULL << sq;
+    } else {
+        _moved &= ~(1ULL << sq);
+    }
+}
+
+void Board::refresh() {
+    const Tables& t = tables();
+    _king[WHITE] = _king[BLACK] = -1;
+    _ghost = -1;
+    _key = _side == BLACK ? t.side_key : 0;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t c = _squares[sq];
+        if (c == 0) continue;
+        _key ^= t.piece_key[c][sq];
+        if (castling_piece(c) && !has_moved(sq)) {
+            _key ^= t.unmoved_key[sq];
+        }
+        if (c == GHOST_CODE) {
+            _ghost = sq;
+        } else if (code_type(c) == KING_ENUM) {
+            _king[code_owner(c)] = sq;
+        }
+    }
+}
+
+bool Board::attacked(int sq, Player by) const {
+    const Tables& t = tables();
+    int x = square_x(sq), y = square_y(sq);
+    //pawns capture one square diagonally forward
+    int py = by == WHITE ? y - 1 : y + 1;
+    if (py >= 0 && py < 8) {
+        uint8_t pawn = piece_code(PAWN_ENUM, by);
+        if (x > 0 && _squares[make_square(x - 1, py)] == pawn) return true;
+        if (x < 7 && _squares[make_square(x + 1, py)] == pawn) return true;
+    }
+    uint8_t knight = piece_code(KNIGHT_ENUM, by);
+    for (int i = 0; i < t.knight_count[sq]; i++) {
+        if (_squares[t.knight[sq][i]] == knight) return true;
+    }
+    uint8_t king = piece_code(KING_ENUM, by);
+    for (int i = 0; i < t.king_count[sq]; i++) {
+        if (_squares[t.king[sq][i]] == king) return true;
+    }
+    uint8_t queen = piece_code(QUEEN_ENUM, by);
+    for (int d = 0; d < 8; d++) {
+        uint8_t slider = piece_code(d < 4 ? ROOK_ENUM : BISHOP_ENUM, by);
+        for (int i = 0; i < t.ray_count[sq][d]; i++) {
+            uint8_t c = _squares[t.ray[sq][d][i]];
+            if (c == 0) continue;
+            if (c == slider || c == queen) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+void Board::generate_moves(MoveList& list) const {
+    generate(list, false);
+}
+
+void Board::generate_captures(MoveList& list) const {
+    generate(list, true);
+}
+
+void Board::generate_moves_to(int to, MoveList& list) const {
+    generate(list, false, to);
+}
+
+//stops at the first legal move instead of generating all of them
+bool Board::has_legal_move() const {
+    MoveList pseudo;
+    generate_pseudo(pseudo, false);
+    for (int i = 0; i < pseudo.size; i++) {
+        if (legal_after(pseudo.moves[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Board::can_move(Player p) const {
+    if (p == _side) {
+        return has_legal_move();
+    }
+    Board copy = *this;
+    copy._side = p;
+    return copy.has_legal_move();
+}
+
+Move Board::find_move(int from, int to) const {
+    MoveList list;
+    generate(list, false, to);
+    for (int i = 0; i < list.size; i++) {
+        if (move_from(list.moves[i]) == from) {
+            return list.moves[i];
+        }
+    }
+    return NO_MOVE;
+}
+
+Move Board::parse_move(const std::string& text) const {
+    if (text.size() < 4 || text.size() > 5) {
+        return NO_MOVE;
+    }
+    int x1 = text[0] - 'a', y1 = text[1] - '1';
+    int x2 = text[2] - 'a', y2 = text[3] - '1';
+    if (x1 < 0 || x1 > 7 || y1 < 0 || y1 > 7 || x2 < 0 || x2 > 7 || y2 < 0 || y2 > 7) {
+        return NO_MOVE;
+    }
+    Move m = find_move(make_square(x1, y1), make_square(x2, y2));
+    //pawns only ever promote to a queen
+    if (text.size() == 5 && (text[4] != 'q' || !(move_flags(m) & FLAG_PROMOTION))) {
+        return NO_MOVE;
+    }
+    return m;
+}
+
+//keeps the pseudo legal moves that don't leave the king in check.
+//An `only_to' square >= 0 keeps only the moves ending there.
+void Board::generate(MoveList& list, bool captures_only, int only_to) const {
+    MoveList pseudo;
+    generate_pseudo(pseudo, captures_only);
+    for (int i = 0; i < pseudo.size; i++) {
+        if (only_to >= 0 && move_to(pseudo.moves[i]) != only_to) continue;
+        if (legal_after(pseudo.moves[i])) {
+            list.push(pseudo.moves[i]);
+        }
+    }
+}
+
+//generates pseudo legal moves with the same shapes as ChessPiece.cpp
+void Board::generate_pseudo(MoveList& pseudo, bool captures_only) const {
+    const Tables& t = tables();
+    Player us = _side;
+    Player them = static_cast<Player>(1 - us);
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t c = _squares[sq];
+        if (c == 0 || code_owner(c) != us) continue;
+        int type = code_type(c);
+        int x = square_x(sq), y = square_y(sq);
+        if (type == PAWN_ENUM) {
+            int dir = us == WHITE ? 1 : -1;
+            int last = us == WHITE ? 7 : 0;
+            int ny = y + dir;
+            if (ny < 0 || ny > 7) continue;
+            int promo = ny == last ? FLAG_PROMOTION : 0;
+            int ahead = make_square(x, ny);
+            if (_squares[ahead] == 0 && (!captures_only || promo)) {
+                pseudo.push(pack_move(sq, ahead, promo));
+                int home = us == WHITE ? 1 : 6;
+                int two = make_square(x, y + 2 * dir);
+                if (y == home && !captures_only && _squares[two] == 0) {
+                    pseudo.push(pack_move(sq, two, 0));
+                }
+            }
+            for (int dx = -1; dx <= 1; dx += 2) {
+                if (x + dx < 0 || x + dx > 7) continue;
+                int target = make_square(x + dx, ny);
+                uint8_t q = _squares[target];
+                if (q != 0 && code_owner(q) == them) {
+                    pseudo.push(pack_move(sq, target, FLAG_CAPTURE | promo));
+                }
+            }
+        } else if (type == KNIGHT_ENUM || type == KING_ENUM) {
+            const int (*targets)[8] = type == KNIGHT_ENUM ? t.knight : t.king;
+            int count = type == KNIGHT_ENUM ? t.knight_count[sq] : t.king_count[sq];
+            for (int i = 0; i < count; i++) {
+                int target = targets[sq][i];
+                uint8_t q = _squares[target];
+                if (q == 0) {
+                    if (!captures_only) pseudo.push(pack_move(sq, target, 0));
+                } else if (code_owner(q) == them) {
+                    pseudo.push(pack_move(sq, target, FLAG_CAPTURE));
+                }
+            }
+        } else if (type == ROOK_ENUM || type == BISHOP_ENUM || type == QUEEN_ENUM) {
+            int first = type == BISHOP_ENUM ? 4 : 0;
+            int last = type == ROOK_ENUM ? 4 : 8;
+            for (int d = first; d < last; d++) {
+                for (int i = 0; i < t.ray_count[sq][d]; i++) {
+                    int target = t.ray[sq][d][i];
+                    uint8_t q = _squares[target];
+                    if (q == 0) {
+                        if (!captures_only) pseudo.push(pack_move(sq, target, 0));
+                        continue;
+                    }
+                    if (code_owner(q) == them) {
+                        pseudo.push(pack_move(sq, target, FLAG_CAPTURE));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    //castling, mirroring Game::can_castle and Game::check_castle_checking
+    int k = _king[us];
+    if (!captures_only && k >= 0 && !has_moved(k) && !attacked(k, them)) {
+        int x = square_x(k);
+        uint8_t rook = piece_code(ROOK_ENUM, us);
+        if (x + 3 < 8 && _squares[k + 1] == 0 && _squares[k + 2] == 0 &&
+            _squares[k + 3] == rook && !has_moved(k + 3) &&
+            !attacked(k + 1, them) && !attacked(k + 2, them)) {
+            pseudo.push(pack_move(k, k + 2, FLAG_CASTLE));
+        }
+        if (x - 4 >= 0 && _squares[k - 1] == 0 && _squares[k - 2] == 0 && _squares[k - 3] == 0 &&
+            _squares[k - 4] == rook && !has_moved(k - 4) &&
+            !attacked(k - 1, them) && !attacked(k - 2, them)) {
+            pseudo.push(pack_move(k, k - 2, FLAG_CASTLE));
+        }
+    }
+}
+
+bool Board::legal_after(Move m) const {
+    Board copy = *this;
+    Undo undo;
+    copy.make(m, undo);
+    return !copy.in_check(_side);
+}
+
+//moves a piece between squares keeping the hash and move flags current
+void Board::move_piece(int from, int to) {
+    const Tables& t = tables();
+    uint8_t c = _squares[from];
+    _key ^= t.piece_key[c][from] ^ t.piece_key[c][to];
+    if (castling_piece(c) && !has_moved(from)) {
+        _key ^= t.unmoved_key[from];
+    }
+    _squares[to] = c;
+    _squares[from] = 0;
+    _moved &= ~(1ULL << from);
+    _moved |= 1ULL << to;
+}
+
+void Board::make(Move m, Undo& undo) {
+    const Tables& t = tables();
+    int from = move_from(m), to = move_to(m), flags = move_flags(m);
+    undo.key = _key;
+    undo.moved = _moved;
+    undo.captured = _squares[to];
+    uint8_t q = _squares[to];
+    if (q != 0) {
+        _key ^= t.piece_key[q][to];
+        if (castling_piece(q) && !has_moved(to)) {
+            _key ^= t.unmoved_key[to];
+        }
+        if (q == GHOST_CODE) {
+            _ghost = -1;
+        }
+    }
+    move_piece(from, to);
+    if (flags & FLAG_CASTLE) {
+        if (to > from) {
+            move_piece(from + 3, from + 1);
+        } else {
+            move_piece(from - 4, from - 1);
+        }
+    }
+    if (flags & FLAG_PROMOTION) {
+        uint8_t queen = piece_code(QUEEN_ENUM, _side);
+        _key ^= t.piece_key[_squares[to]][to] ^ t.piece_key[queen][to];
+        _squares[to] = queen;
+    }
+    if (code_type(_squares[to]) == KING_ENUM) {
+        _king[_side] = to;
+    }
+    if (q != 0 && code_type(q) == KING_ENUM) {
+        _king[code_owner(q)] = -1;
+    }
+    _side = static_cast<Player>(1 - _side);
+    _key ^= t.side_key;
+    _turn++;
+}
+
+void Board::unmake(Move m, const Undo& undo) {
+    int from = move_from(m), to = move_to(m), flags = move_flags(m);
+    _side = static_cast<Player>(1 - _side);
+    _turn--;
+    uint8_t c = _squares[to];
+    if (flags & FLAG_PROMOTION) {
+        c = piece_code(PAWN_ENUM, _side);
+    }
+    _squares[from] = c;
+    _squares[to] = undo.captured;
+    if (flags & FLAG_CASTLE) {
+        if (to > from) {
+            _squares[from + 3] = _squares[from + 1];
+            _squares[from + 1] = 0;
+        } else {
+            _squares[from - 4] = _squares[from - 1];
+            _squares[from - 1] = 0;
+        }
+    }
+    if (code_type(c) == KING_ENUM) {
+        _king[_side] = from;
+    }
+    if (undo.captured != 0) {
+        if (undo.captured == GHOST_CODE) {
+            _ghost = to;
+        } else if (code_type(undo.captured) == KING_ENUM) {
+            _king[code_owner(undo.captured)] = to;
+        }
+    }
+    _moved = undo.moved;
+    _key = undo.key;
+}
+
+//the hill is the four central squares, same as KOTHChessGame::conquered_hill
+bool Board::on_hill(Player p) const {
+    return _king[p] >= 0 && HillTable::standard().on_hill(_king[p]);
+}
+
+bool Board::can_reach_hill(Player p) const {
+    const HillTable& hill = HillTable::standard();
+    int k = _king[p];
+    if (k < 0 || hill.distance(k) != 1) {
+        return false;
+    }
+    if (p != _side) {
+        Board copy = *this;
+        copy._side = p;
+        return copy.can_reach_hill(p);
+    }
+    for (size_t i = 0; i < hill.squares().size(); i++) {
+        int sq = hill.squares()[i];
+        if (std::abs(square_x(sq) - square_x(k)) <= 1 && std::abs(square_y(sq) - square_y(k)) <= 1 &&
+            find_move(k, sq) != NO_MOVE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//bare kings, a single minor piece, or only bishops on squares of one colour
+bool Board::insufficient_material() const {
+    int minors = 0, knights = 0, bishop_colours = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t code = _squares[sq];
+        if (code == 0 || code == GHOST_CODE || code_type(code) == KING_ENUM) {
+            continue;
+        }
+        if (code_type(code) == KNIGHT_ENUM) {
+            knights++;
+        } else if (code_type(code) == BISHOP_ENUM) {
+            bishop_colours |= 1 << ((square_x(sq) + square_y(sq)) % 2);
+        } else {
+            return false;
+        }
+        minors++;
+    }
+    return minors <= 1 || (knights == 0 && bishop_colours != 3);
+}
+
+int Board::ghost_jump(Rng& rng) const {
+    int sq = (int) rng.below(BOARD_SQUARES);
+    while (_squares[sq] != 0 && code_type(_squares[sq]) == KING_ENUM) {
+        sq = (int) rng.below(BOARD_SQUARES);
+    }
+    return sq;
+}
+
+uint8_t Board::move_ghost() {
+    if (_ghost < 0) {
+        return 0;
+    }
+    int to = ghost_jump(_rng);
+    if (to == _ghost) {
+        return 0;
+    }
+    Undo undo;
+    jump_ghost(to, undo);
+    return undo.captured;
+}
+
+//same order of checks as ChessGame, KOTHChessGame and SpookyChessGame::make_move
+bool Board::play(Move m, Rng& rng, Player& winner) {
+    Player us = _side;
+    Player them = static_cast<Player>(1 - us);
+    Undo undo;
+    make(m, undo);
+    winner = NO_ONE;
+    if (_variant == VARIANT_KOTH && on_hill(us)) {
+        winner = us;
+        return true;
+    }
+    if (!has_legal_move()) {
+        winner = in_check(them) ? us : NO_ONE;
+        return true;
+    }
+    if (_variant != VARIANT_SPOOKY || _ghost < 0) {
+        return false;
+    }
+    Undo jump;
+    jump_ghost(ghost_jump(rng), jump);
+    bool them_check = in_check(them), us_check = in_check(us);
+    bool them_moves = has_legal_move(), us_moves = can_move(us);
+    if (them_check && !them_moves) {
+        winner = us;
+    } else if (us_check && !us_moves) {
+        winner = them;
+    } else if (!them_moves || !us_moves) {
+        winner = NO_ONE;
+    } else if (us_check && !them_check) {
+        winner = them;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint64_t Board::placement_key() const {
+    return _ghost >= 0 ? _key ^ tables().piece_key[GHOST_CODE][_ghost] : _key;
+}
+
+void Board::jump_ghost(int to, Undo& undo) {
+    const Tables& t = tables();
+    undo.key = _key;
+    undo.moved = _moved;
+    undo.captured = _squares[to];
+    if (to == _ghost) {
+        return;
+    }
+    uint8_t q = _squares[to];
+    if (q != 0) {
+        _key ^= t.piece_key[q][to];
+        if (castling_piece(q) && !has_moved(to)) {
+            _key ^= t.unmoved_key[to];
+        }
+    }
+    _key ^= t.piece_key[GHOST_CODE][_ghost] ^ t.piece_key[GHOST_CODE][to];
+    _squares[_ghost] = 0;
+    _squares[to] = GHOST_CODE;
+    _ghost = to;
+}
+
+void Board::unjump_ghost(int from, const Undo& undo) {
+    _squares[_ghost] = undo.captured;
+    _squares[from] = GHOST_CODE;
+    _ghost = from;
+    _moved = undo.moved;
+    _key = undo.key;
+}
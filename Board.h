@@ -0,0 +1,232 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <cstdint>
+#include <string>
+#include "Enumerations.h"
+#include "Piece.h"
+#include "Rng.h"
+
+/*
+Compact 8x8 mailbox copy of a Game, made by Game::to_board, used by the
+engine. It follows the same rules as Game::can_make_move (no en passant,
+pawns always promote to a queen, castling allowed while king and rook are
+unmoved) but makes and unmakes moves in place instead of allocating pieces.
+*/
+
+// Chess variants understood by the engine
+enum Variant {
+    VARIANT_CHESS = 0,
+    VARIANT_KOTH,
+    VARIANT_SPOOKY
+};
+
+// A move packed into 16 bits:
+// bits 0-5 start square, bits 6-11 end square, bits 12-15 flags
+typedef uint16_t Move;
+
+enum MoveFlag {
+    FLAG_CAPTURE = 1,
+    FLAG_CASTLE = 2,
+    FLAG_PROMOTION = 4
+};
+
+// a1a1 can never be a legal move so it doubles as "no move"
+static const Move NO_MOVE = 0;
+
+static const int BOARD_SQUARES = 64;
+static const int MAX_MOVES = 256;
+
+inline Move pack_move(int from, int to, int flags) {
+    return static_cast<Move>(from | (to << 6) | (flags << 12));
+}
+inline int move_from(Move m) { return m & 63; }
+inline int move_to(Move m) { return (m >> 6) & 63; }
+inline int move_flags(Move m) { return m >> 12; }
+
+inline int square_x(int sq) { return sq & 7; }
+inline int square_y(int sq) { return sq >> 3; }
+inline int make_square(int x, int y) { return y * 8 + x; }
+
+// Coordinate notation of a move (ie "e2e4", "e7e8q")
+std::string move_to_string(Move m);
+
+// Piece codes stored on the board: 0 is empty, otherwise the low
+// three bits hold piece_type + 1 and the next two bits the owner
+inline uint8_t piece_code(int piece_type, Player owner) {
+    return static_cast<uint8_t>((piece_type + 1) | (owner << 3));
+}
+inline int code_type(uint8_t code) { return (code & 7) - 1; }
+inline Player code_owner(uint8_t code) { return static_cast<Player>(code >> 3); }
+
+static const uint8_t GHOST_CODE = (GHOST_ENUM + 1) | (NO_ONE << 3);
+
+
+// Fixed capacity list of moves so move generation never allocates
+struct MoveList {
+    Move moves[MAX_MOVES];
+    int size;
+
+    MoveList() : size(0) {}
+    void push(Move m) { moves[size++] = m; }
+    bool contains(Move m) const {
+        for (int i = 0; i < size; i++) {
+            if (moves[i] == m) return true;
+        }
+        return false;
+    }
+};
+
+
+// Everything needed to take back a move made with Board::make
+struct Undo {
+    uint64_t key;
+    uint64_t moved;
+    uint8_t captured;
+};
+
+
+class Board {
+
+public:
+
+    // Creates an empty board with white to move on turn 1
+    Board(Variant variant = VARIANT_CHESS);
+
+    // Creates the standard start-of-game position for a variant
+    static Board start_position(Variant variant);
+
+    // Remove every piece and reset the move flags
+    void clear();
+
+    // Place a piece code on a square (0 clears it). Call refresh()
+    // once the whole position has been placed.
+    void put(int sq, uint8_t code) { _squares[sq] = code; }
+
+    // Mark whether the piece on a square has moved
+    void set_moved(int sq, bool moved);
+
+    void set_side(Player side) { _side = side; }
+
+    void set_turn(int turn) { _turn = turn; }
+
+    // Spooky Chess: the generator that will move the ghost
+    void set_rng(const Rng& rng) { _rng = rng; }
+
+    // Recompute king squares, ghost square and hash after editing
+    void refresh();
+
+    uint8_t at(int sq) const { return _squares[sq]; }
+
+    bool has_moved(int sq) const { return (_moved >> sq) & 1; }
+
+    Player side() const { return _side; }
+
+    int turn() const { return _turn; }
+
+    Variant variant() const { return _variant; }
+
+    int king_square(Player p) const { return _king[p]; }
+
+    int ghost_square() const { return _ghost; }
+
+    uint64_t key() const { return _key; }
+
+    const Rng& rng() const { return _rng; }
+
+    // True if any piece of player `by' attacks the square
+    bool attacked(int sq, Player by) const;
+
+    // True if the player's king is under attack
+    bool in_check(Player p) const {
+        return _king[p] >= 0 && attacked(_king[p], static_cast<Player>(1 - p));
+    }
+
+    // Fill the list with every legal move for the side to move
+    void generate_moves(MoveList& list) const;
+
+    // Fill the list with legal captures and promotions only
+    void generate_captures(MoveList& list) const;
+
+    // Fill the list with the legal moves ending on one square
+    void generate_moves_to(int to, MoveList& list) const;
+
+    // True if the side to move has at least one legal move
+    bool has_legal_move() const;
+
+    // True if player `p' would have a legal move were it their turn
+    bool can_move(Player p) const;
+
+    // Find the legal move from `from' to `to', NO_MOVE if there is none
+    Move find_move(int from, int to) const;
+
+    // Find the legal move written in coordinate notation ("e2e4", "e7e8q"),
+    // NO_MOVE if the text is malformed or the move is illegal
+    Move parse_move(const std::string& text) const;
+
+    // Make a legal move, recording what is needed to take it back
+    void make(Move m, Undo& undo);
+
+    // Take back the last move made with make()
+    void unmake(Move m, const Undo& undo);
+
+    // King of the Hill: true if the player's king stands on the hill
+    bool on_hill(Player p) const;
+
+    // King of the Hill: true if the player's king could step onto the
+    // hill with a legal move were it their turn
+    bool can_reach_hill(Player p) const;
+
+    // True if neither side has the pieces left to mate, whatever the
+    // variant (King of the Hill games go on regardless)
+    bool insufficient_material() const;
+
+    // Spooky Chess: the square the ghost jumps to next, drawing from `rng'
+    // exactly as SpookyChessGame::move_ghost does (kings are redrawn)
+    int ghost_jump(Rng& rng) const;
+
+    // Spooky Chess: jump the ghost with the board's own generator,
+    // removing whatever stood on its new square. Returns the captured
+    // piece code, 0 if none.
+    uint8_t move_ghost();
+
+    // Make a legal move and apply what the variant's make_move does after
+    // it: the hill, mate and stalemate, and in Spooky Chess the ghost jump
+    // drawn from `rng' and the checks that follow it. Returns true if the
+    // game is over, with the winner (NO_ONE for a draw) in `winner'.
+    bool play(Move m, Rng& rng, Player& winner);
+
+    // Hash of the pieces without the ghost, the same for positions that
+    // only differ in where the ghost stands
+    uint64_t placement_key() const;
+
+    // Spooky Chess: put the ghost on `to' (never a king's square),
+    // removing whatever stood there
+    void jump_ghost(int to, Undo& undo);
+
+    // Take back jump_ghost, `from' being where the ghost stood before
+    void unjump_ghost(int from, const Undo& undo);
+
+private:
+
+    uint8_t _squares[BOARD_SQUARES];
+    uint64_t _moved;
+    uint64_t _key;
+    Player _side;
+    int _turn;
+    int _king[2];
+    int _ghost;
+    Variant _variant;
+    Rng _rng;
+
+    void generate(MoveList& list, bool captures_only, int only_to = -1) const;
+
+    void generate_pseudo(MoveList& pseudo, bool captures_only) const;
+
+    bool legal_after(Move m) const;
+
+    void move_piece(int from, int to);
+
+};
+
+#endif // BOARD_H
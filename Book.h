@@ -0,0 +1,125 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Board.h"
+
+/*
+Opening book in the Polyglot file format: 16-byte big-endian entries of
+position key, move, weight and a learn field, sorted by key. A book is
+memory-mapped and searched in place, so opening one costs the same
+whatever its size and pages are only read when a probe touches them.
+
+The keys are Polyglot's own Zobrist hash, polyglot_key(), so books built
+by other programs can be probed and books built here by BookBuilder can
+be read by them. The rules here have no en passant, so the en passant
+part of the key never applies. Books are for standard chess only.
+*/
+
+// A book move for the current position and how often it should be played
+struct BookMove {
+    Move move;
+    int weight;
+};
+
+// Polyglot key of a position: its standard Random64 numbers for the
+// pieces, the castling rights and the side to move
+uint64_t polyglot_key(const Board& b);
+
+// Polyglot encoding of a move: castling is written as the king taking
+// its own rook, promotions always to a queen
+uint16_t book_encode(Move m);
+
+// The legal move of `b' a book entry stands for, NO_MOVE if there is none
+Move book_decode(const Board& b, uint16_t move);
+
+
+class OpeningBook {
+
+public:
+
+    OpeningBook() : _map(nullptr), _length(0), _entries(nullptr), _size(0) {}
+
+    ~OpeningBook();
+
+    // Map a book file, false if it is missing or not a book
+    bool open(const std::string& path);
+
+    // Every legal book move of a standard chess position, most played first
+    void moves(const Board& b, std::vector<BookMove>& list) const;
+
+    // A book move chosen at random in proportion to the weights,
+    // NO_MOVE when the position is not in the book
+    Move pick(const Board& b, Rng& rng) const;
+
+    // Number of entries
+    size_t size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+    // The book named by $BOOK ("book.bin" when unset), mapped on first use
+    static const OpeningBook& shared();
+
+private:
+
+    void* _map;
+    size_t _length;
+    const uint8_t* _entries;
+    size_t _size;
+
+    // Key of the i-th entry
+    uint64_t key(size_t i) const;
+
+    //owns its mapping
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+};
+
+
+// Collects the moves of finished games and writes them out as a book
+class BookBuilder {
+
+public:
+
+    // Book the first `max_plies' moves of each game, keeping moves
+    // played in at least `min_games' games
+    BookBuilder(int max_plies = 20, int min_games = 1) : _max_plies(max_plies), _min_games(min_games) {}
+
+    // Add a standard chess game played from `start'. Winning moves weigh
+    // 2 and drawing moves 1, the loser's moves are left out; unfinished
+    // games ("*") only count towards `min_games'.
+    void add_game(const Board& start, const std::vector<Move>& moves, const std::string& result);
+
+    // Distinct position and move pairs collected
+    size_t size() const { return _stats.size(); }
+
+    // Sort and write the book, false on I/O errors. Returns the number
+    // of entries written in `entries'.
+    bool write(const std::string& path, size_t& entries) const;
+
+private:
+
+    struct Stats {
+        uint32_t games;
+        uint32_t weight;
+    };
+
+    struct KeyHash {
+        size_t operator()(const std::pair<uint64_t, uint16_t>& k) const {
+            return (size_t) (k.first ^ (k.second * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+
+    int _max_plies;
+    int _min_games;
+    std::unordered_map<std::pair<uint64_t, uint16_t>, Stats, KeyHash> _stats;
+
+};
+
+#endif // BOOK_H
@@ -1,13 +1,15 @@
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <string>
 
 #include "Game.h"
 #include "ChessGame.h"
 #include "Prompts.h"
 #include "Piece.h"
+#include "Fen.h"
+#include "Board.h"
+#include "Tablebase.h"
 
 
 // Set up the chess board with standard initial pieces
@@ -26,71 +28,12 @@ ChessGame::ChessGame(): Game() {
 }
 
 
-// Set up the chess board with game state loaded from file
-ChessGame::ChessGame(const std::string filename) : Game() {
-
+// Set up the chess board in a position given as FEN
+ChessGame::ChessGame(const FenPosition& fen) : Game() {
     initialize_factories();
-
-    std::ifstream input_file;
-    input_file.open(filename);
-    if (!input_file.is_open()) {
-      Prompts::load_failure();
-      exit(1);
-    }
-    std::string temp;
-    input_file >> temp;
-    //make sure save file is of the correct game type
-    if (temp != "chess") {
-      Prompts::load_failure();
-      input_file.close();
-      exit(1);
-    }
-    int turn = 0;
-    input_file >> turn;
-    _turn = turn + 1;
-    int player, piece_type;
-    std::string coordinate;
-    //create all pieces according to file output
-    while (input_file >> player) {
-      input_file >> coordinate;
-      input_file >> piece_type;
-      int x = (int) coordinate[0] - 97;
-      int y = coordinate[1] - 49;
-      init_piece(static_cast<PieceEnum>(piece_type), static_cast<Player>(player), Position(x, y));
-    }
-    input_file.close();
+    load_fen(fen);
 }
 
-//Saves game state out to file
-//Format:
-//gametype (chess)
-//turnnumber (5)
-//player location pieceType (0 a1 1) means there is a white rook on square a1
-void ChessGame::save_file() const {
-  Prompts::save_game();
-  std::string filename;
-  std::getline(std::cin, filename);
-  std::ofstream output_file;
-  output_file.open(filename);
-  if (output_file.is_open()) {
-    output_file << return_game_type() << "\n";
-    output_file << turn() - 1  << "\n";
-    //Note, override this function for spooky to make sure it's different
-    for (unsigned int x = 0; x < _height; x++) {
-      for (unsigned int y = 0; y < _width; y++) {
-        Piece * p = _pieces[index(Position(y, x))];
-        if (p != nullptr) {
-          output_file << p->owner() << " ";
-          output_file << (char) (y + 97) << x + 1 << " ";
-          output_file << p->piece_type() << "\n";
-        }
-      }
-    }
-    output_file.close();
-  } else {
-    Prompts::save_failure();
-  }
-}
 
 // Perform a move from the start Position to the end Position
 // The method returns an integer with the status
@@ -108,21 +51,24 @@ int ChessGame::make_move(Position start, Position end) {
       return status::MOVE_CHECKMATE;
     }
     Prompts::check(player_turn());
-    _turn++;
-    return status::MOVE_CHECK;
+    return next_turn(status::MOVE_CHECK);
   }
   if (!player_can_move(opponent)) {
     Prompts::stalemate();
     return status::MOVE_STALEMATE;
   }
-  _turn++;
-  return result;
+  return next_turn(result);
 }
 
 // Report whether the chess game is over
 bool ChessGame::game_over() const {
   Player opponent = static_cast<Player>(1 - player_turn());
-  return !player_can_move(opponent);
+  return !player_can_move(opponent) || draw_by_rule() != 0;
+}
+
+//endgames the tables show to be drawn are as dead as bare kings
+bool ChessGame::insufficient_material(const Board& board) const {
+  return Game::insufficient_material(board) || Tablebases::shared().dead_draw(board);
 }
 
 
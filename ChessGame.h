@@ -16,15 +16,16 @@ public:
     // Creates new game in standard start-of-game state
     ChessGame();
 
-    // Creates game with state indicated in specified file
-    ChessGame(std::string filename);
+    // Creates game in the position described by a parsed FEN
+    ChessGame(const FenPosition& fen);
 
     // Perform a move from the start Position to the end Position
     // The method returns an integer with the status
     // >= 0 is SUCCESS, < 0 is failure
     virtual int make_move(Position start, Position end) override;
 
-    // Reports whether the chess game is over
+    // Reports whether the chess game is over: no legal reply, or a draw
+    // by repetition, the fifty-move rule or insufficient material
     virtual bool game_over() const override;
 
 protected:
@@ -33,10 +34,11 @@ protected:
     // used in chess (doesn't make the actual pieces)
     virtual void initialize_factories();
 
-    virtual void save_file() const;
-
     virtual std::string return_game_type() const override { return "chess";}
 
+    // Also true in endgames the tablebases show neither side can win
+    virtual bool insufficient_material(const Board& board) const override;
+
 //private methods
 private:
 
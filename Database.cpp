@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Database.h"
+
+namespace {
+
+const char DATABASE_MAGIC[4] = {'T', 'C', 'D', 'B'};
+
+const uint32_t DATABASE_VERSION = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t games;
+    uint64_t moves;
+    uint64_t starts;
+    uint64_t entries;
+    uint32_t bits;
+    uint32_t reserved;
+};
+
+// Offsets of the sections, each aligned to 8 bytes
+struct Layout {
+    size_t first_move, info, start, moves, starts, directory, entries, length;
+};
+
+size_t align(size_t offset) {
+    return (offset + 7) & ~(size_t) 7;
+}
+
+Layout layout(uint64_t games, uint64_t moves, uint64_t starts, uint64_t entries, int bits) {
+    Layout l;
+    l.first_move = align(sizeof(Header));
+    l.info = align(l.first_move + (games + 1) * 8);
+    l.start = align(l.info + games);
+    l.moves = align(l.start + games * 4);
+    l.starts = align(l.moves + moves * 2);
+    l.directory = align(l.starts + starts * SNAPSHOT_SIZE);
+    l.entries = align(l.directory + (((uint64_t) 1 << bits) + 1) * 8);
+    l.length = l.entries + entries * 16;
+    return l;
+}
+
+// About four entries a bucket
+int bucket_bits(uint64_t entries) {
+    int bits = 1;
+    while (bits < 40 && ((uint64_t) 1 << bits) * 4 < entries) {
+        bits++;
+    }
+    return bits;
+}
+
+}
+
+GameResult parse_result(const std::string& result) {
+    if (result == "1-0") {
+        return RESULT_WHITE;
+    } else if (result == "0-1") {
+        return RESULT_BLACK;
+    } else if (result == "1/2-1/2") {
+        return RESULT_DRAW;
+    }
+    return RESULT_UNKNOWN;
+}
+
+
+GameDatabase::~GameDatabase() {
+    if (_map != nullptr) {
+        munmap(_map, _length);
+    }
+}
+
+//only the header is read, the columns are paged in as queries touch them
+bool GameDatabase::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    Header h;
+    std::memcpy(&h, map, sizeof(h));
+    Layout l = layout(h.games, h.moves, h.starts, h.entries, (int) h.bits);
+    if (std::memcmp(h.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) != 0 || h.version != DATABASE_VERSION ||
+        h.bits < 1 || h.bits > 40 || l.length != (size_t) st.st_size) {
+        munmap(map, (size_t) st.st_size);
+        return false;
+    }
+    if (_map != nullptr) {
+        munmap(_map, _length);
+    }
+    _map = map;
+    _length = (size_t) st.st_size;
+    _games = h.games;
+    _moves = h.moves;
+    _starts = h.starts;
+    _entries = h.entries;
+    _bits = (int) h.bits;
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    _first_move = reinterpret_cast<const uint64_t*>(base + l.first_move);
+    _info = base + l.info;
+    _start = reinterpret_cast<const uint32_t*>(base + l.start);
+    _move_column = reinterpret_cast<const uint16_t*>(base + l.moves);
+    _start_column = reinterpret_cast<const Snapshot*>(base + l.starts);
+    _directory = reinterpret_cast<const uint64_t*>(base + l.directory);
+    _entry_column = reinterpret_cast<const Entry*>(base + l.entries);
+    return true;
+}
+
+void GameDatabase::lookup(uint64_t key, const Entry*& first, const Entry*& last) const {
+    uint64_t b = key >> (64 - _bits);
+    const Entry* begin = _entry_column + _directory[b];
+    last = _entry_column + _directory[b + 1];
+    first = std::lower_bound(begin, last, key, [](const Entry& e, uint64_t k) { return e.key < k; });
+}
+
+void GameDatabase::find(uint64_t key, std::vector<DatabaseHit>& hits, size_t limit) const {
+    hits.clear();
+    if (_map == nullptr) {
+        return;
+    }
+    const Entry* e;
+    const Entry* last;
+    lookup(key, e, last);
+    for (; e != last && e->key == key && hits.size() < limit; ++e) {
+        DatabaseHit hit = {e->game, e->ply};
+        hits.push_back(hit);
+    }
+}
+
+size_t GameDatabase::count(uint64_t key) const {
+    if (_map == nullptr) {
+        return 0;
+    }
+    const Entry* first;
+    const Entry* last;
+    lookup(key, first, last);
+    const Entry* end = std::upper_bound(first, last, key, [](uint64_t k, const Entry& e) { return k < e.key; });
+    return (size_t) (end - first);
+}
+
+//each hit's next move, which is legal here unless two positions share a key
+void GameDatabase::moves(const Board& b, std::vector<DatabaseMove>& list) const {
+    list.clear();
+    std::vector<DatabaseHit> hits;
+    find(b.key(), hits);
+    std::map<Move, DatabaseMove> stats;
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (hits[i].ply >= plies(hits[i].game)) {
+            continue;
+        }
+        Move m = move(hits[i].game, hits[i].ply);
+        DatabaseMove& s = stats[m];
+        s.move = m;
+        s.games++;
+        switch (result(hits[i].game)) {
+        case RESULT_WHITE:
+            s.white++;
+            break;
+        case RESULT_BLACK:
+            s.black++;
+            break;
+        case RESULT_DRAW:
+            s.draws++;
+            break;
+        default:
+            break;
+        }
+    }
+    for (auto it = stats.begin(); it != stats.end(); ++it) {
+        list.push_back(it->second);
+    }
+    std::stable_sort(list.begin(), list.end(),
+                     [](const DatabaseMove& a, const DatabaseMove& c) { return a.games > c.games; });
+}
+
+size_t GameDatabase::plies(uint32_t game) const {
+    return (size_t) (_first_move[game + 1] - _first_move[game]);
+}
+
+Move GameDatabase::move(uint32_t game, size_t ply) const {
+    return static_cast<Move>(_move_column[_first_move[game] + ply]);
+}
+
+GameResult GameDatabase::result(uint32_t game) const {
+    return static_cast<GameResult>(_info[game] & 3);
+}
+
+Board GameDatabase::start(uint32_t game) const {
+    if (_start[game] == NO_START) {
+        return Board::start_position(static_cast<Variant>((_info[game] >> 2) & 3));
+    }
+    Board b;
+    int halfmove_clock;
+    bool over;
+    unpack_snapshot(_start_column[_start[game]], b, halfmove_clock, over);
+    return b;
+}
+
+const GameDatabase& GameDatabase::shared() {
+    //mapped by the first caller, thread safe as a function-local static
+    struct Shared : GameDatabase {
+        Shared() {
+            const char* path = std::getenv("GAMES");
+            open(path ? path : "games.db");
+        }
+    };
+    static const Shared database;
+    return database;
+}
+
+
+bool DatabaseBuilder::add_game(const Board& start, const std::vector<Move>& moves, GameResult result) {
+    if (_info.size() >= NO_START) {
+        return false;
+    }
+    uint32_t index = NO_START;
+    if (start.key() != Board::start_position(start.variant()).key() || start.turn() != 1) {
+        Snapshot s;
+        if (!pack_snapshot(start, 0, false, s)) {
+            return false;
+        }
+        index = (uint32_t) _starts.size();
+        _starts.push_back(s);
+    }
+    if (_first_move.empty()) {
+        _first_move.push_back(0);
+    }
+    _moves.insert(_moves.end(), moves.begin(), moves.end());
+    _first_move.push_back(_moves.size());
+    _info.push_back((uint8_t) (result | (start.variant() << 2)));
+    _start.push_back(index);
+    return true;
+}
+
+//the file is sized and mapped first and the index built in place with a
+//counting sort: one replay of every game counts the entries of each
+//bucket, a second one files them, and each bucket is sorted on its own
+bool DatabaseBuilder::write(const std::string& path, size_t& entries) const {
+    uint64_t games = _info.size();
+    uint64_t total = _moves.size() + games;
+    int bits = bucket_bits(total);
+    Layout l = layout(games, _moves.size(), _starts.size(), total, bits);
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    void* map = ftruncate(fd, (off_t) l.length) == 0
+                ? mmap(nullptr, l.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    uint8_t* base = static_cast<uint8_t*>(map);
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+    h.version = DATABASE_VERSION;
+    h.games = games;
+    h.moves = _moves.size();
+    h.starts = _starts.size();
+    h.entries = total;
+    h.bits = (uint32_t) bits;
+    std::memcpy(base, &h, sizeof(h));
+    if (games > 0) {
+        std::memcpy(base + l.first_move, _first_move.data(), _first_move.size() * 8);
+        std::memcpy(base + l.info, _info.data(), _info.size());
+        std::memcpy(base + l.start, _start.data(), _start.size() * 4);
+    }
+    if (!_moves.empty()) {
+        std::memcpy(base + l.moves, _moves.data(), _moves.size() * 2);
+    }
+    if (!_starts.empty()) {
+        std::memcpy(base + l.starts, _starts.data(), _starts.size() * SNAPSHOT_SIZE);
+    }
+
+    //both passes see the same positions in the same order
+    uint64_t* directory = reinterpret_cast<uint64_t*>(base + l.directory);
+    GameDatabase::Entry* column = reinterpret_cast<GameDatabase::Entry*>(base + l.entries);
+    uint64_t buckets = (uint64_t) 1 << bits;
+    std::vector<uint64_t> next;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t game = 0; game < games; game++) {
+            Board b = _start[game] == NO_START
+                      ? Board::start_position(static_cast<Variant>(_info[game] >> 2)) : Board();
+            if (_start[game] != NO_START) {
+                int halfmove_clock;
+                bool over;
+                unpack_snapshot(_starts[_start[game]], b, halfmove_clock, over);
+            }
+            uint64_t first = _first_move[game], plies = _first_move[game + 1] - first;
+            for (uint64_t ply = 0; ; ply++) {
+                uint64_t bucket = b.key() >> (64 - bits);
+                if (pass == 0) {
+                    directory[bucket + 1]++;
+                } else {
+                    GameDatabase::Entry e = {b.key(), game, (uint32_t) ply};
+                    column[next[bucket]++] = e;
+                }
+                if (ply == plies) {
+                    break;
+                }
+                Undo undo;
+                b.make(static_cast<Move>(_moves[first + ply]), undo);
+            }
+        }
+        if (pass == 0) {
+            for (uint64_t i = 0; i < buckets; i++) {
+                directory[i + 1] += directory[i];
+            }
+            next.assign(directory, directory + buckets);
+        }
+    }
+    for (uint64_t i = 0; i < buckets; i++) {
+        std::sort(column + directory[i], column + directory[i + 1],
+                  [](const GameDatabase::Entry& a, const GameDatabase::Entry& c) {
+                      return a.key != c.key ? a.key < c.key : (a.game != c.game ? a.game < c.game : a.ply < c.ply);
+                  });
+    }
+    bool ok = munmap(map, l.length) == 0;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    entries = (size_t) total;
+    return true;
+}
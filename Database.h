@@ -0,0 +1,158 @@
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Board.h"
+#include "Snapshot.h"
+
+/*
+Game database in one memory-mapped file, in the byte order of the machine
+that wrote it. A machine of the other byte order reads the header's
+version number byte-swapped, so it refuses the file instead of misreading
+it:
+
+    header        "TCDB", version, and the counts of each section
+    first move    64 bits per game, plus one: where its moves start
+    info          8 bits per game: result (bits 0-1), variant (2-3)
+    start         32 bits per game: its start position, or NO_START for
+                  the variant's usual one
+    moves         the moves of all games one after another, 16-bit Moves
+    starts        start positions as 40-byte Snapshots
+    directory     64 bits per bucket, plus one: where its entries start
+    entries       (position key, game, ply), sorted by key
+
+Each column holds one field of every game, so a query reads only the
+fields it needs. The entries are a hash index of every position of every
+game: the top bits of a Board::key() name its bucket in the directory,
+which is a short run of entries sorted by key, so finding the games that
+reached a position costs a directory read and a search of one bucket,
+and a popular position's games are read in one sequential run.
+*/
+
+static const uint32_t NO_START = 0xFFFFFFFF;
+
+enum GameResult {
+    RESULT_UNKNOWN = 0,
+    RESULT_WHITE,
+    RESULT_BLACK,
+    RESULT_DRAW
+};
+
+// Result of a PGN result string ("1-0", "0-1", "1/2-1/2", anything else)
+GameResult parse_result(const std::string& result);
+
+// A position reached in a game: before its move `ply'
+struct DatabaseHit {
+    uint32_t game;
+    uint32_t ply;
+};
+
+// A move played from a position and how those games ended
+struct DatabaseMove {
+    Move move;
+    uint32_t games;
+    uint32_t white;
+    uint32_t black;
+    uint32_t draws;
+};
+
+
+class GameDatabase {
+
+public:
+
+    GameDatabase() : _map(nullptr), _length(0), _games(0), _moves(0), _starts(0), _entries(0), _bits(0) {}
+
+    ~GameDatabase();
+
+    // Map a database file, false if it is missing or not a database
+    bool open(const std::string& path);
+
+    size_t games() const { return (size_t) _games; }
+
+    // Positions indexed
+    size_t entries() const { return (size_t) _entries; }
+
+    // Every time a position was reached, in game order, at most `limit'
+    void find(uint64_t key, std::vector<DatabaseHit>& hits, size_t limit = SIZE_MAX) const;
+
+    // Number of times a position was reached
+    size_t count(uint64_t key) const;
+
+    // Moves played from a position, most played first
+    void moves(const Board& b, std::vector<DatabaseMove>& list) const;
+
+    size_t plies(uint32_t game) const;
+
+    Move move(uint32_t game, size_t ply) const;
+
+    GameResult result(uint32_t game) const;
+
+    // The position a game started from
+    Board start(uint32_t game) const;
+
+    // The database named by $GAMES ("games.db" when unset), mapped on first use
+    static const GameDatabase& shared();
+
+private:
+
+    void* _map;
+    size_t _length;
+    uint64_t _games, _moves, _starts, _entries;
+    int _bits;                          // bucket bits
+
+    struct Entry {
+        uint64_t key;
+        uint32_t game;
+        uint32_t ply;
+    };
+
+    const uint64_t* _first_move;
+    const uint8_t* _info;
+    const uint32_t* _start;
+    const uint16_t* _move_column;
+    const Snapshot* _start_column;
+    const uint64_t* _directory;
+    const Entry* _entry_column;
+
+    // First entry of the key, or where it would be, and the end of its bucket
+    void lookup(uint64_t key, const Entry*& first, const Entry*& last) const;
+
+    friend class DatabaseBuilder;
+
+    //owns its mapping
+    GameDatabase(const GameDatabase&) = delete;
+    GameDatabase& operator=(const GameDatabase&) = delete;
+
+};
+
+
+// Collects games in memory and writes them out with their index
+class DatabaseBuilder {
+
+public:
+
+    // Add a game of legal moves played from `start'. Returns false when
+    // the database is full (2^32 games) or `start' doesn't fit a Snapshot.
+    bool add_game(const Board& start, const std::vector<Move>& moves, GameResult result);
+
+    size_t size() const { return _info.size(); }
+
+    // Write the database, false on I/O errors. Returns the number of
+    // positions indexed in `entries'.
+    bool write(const std::string& path, size_t& entries) const;
+
+private:
+
+    std::vector<uint64_t> _first_move;
+    std::vector<uint8_t> _info;
+    std::vector<uint32_t> _start;
+    std::vector<uint16_t> _moves;
+    std::vector<Snapshot> _starts;
+
+};
+
+#endif // DATABASE_H
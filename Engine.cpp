@@ -0,0 +1,650 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "Engine.h"
+#include "Board.h"
+#include "Piece.h"
+#include "Hill.h"
+#include "Tablebase.h"
+#include "Book.h"
+
+namespace {
+
+// Piece values indexed by PieceEnum
+const int PIECE_VALUES[7] = {100, 500, 320, 330, 900, 0, 0};
+
+// Most nodes the search visits between looks at the clock
+const uint64_t CHECK_INTERVAL = 1024;
+
+// Spooky Chess chance nodes share the table with the decision node of the
+// same position, so their keys are salted
+const uint64_t CHANCE_KEY = 0xC4A9CE5EED0B0B0ULL;
+
+// King of the Hill: bonus for a king by its distance to the hill
+const int HILL_BONUS[8] = {0, 90, 40, 15, 0, 0, 0, 0};
+
+//0 on the rim up to 6 on the four central squares
+int centrality(int sq) {
+    int x = square_x(sq), y = square_y(sq);
+    int dx = std::min(std::abs(x - 3), std::abs(x - 4));
+    int dy = std::min(std::abs(y - 3), std::abs(y - 4));
+    return 6 - dx - dy;
+}
+
+//positional bonus for a piece from its owner's point of view
+int placement(int type, Player owner, int sq, bool endgame) {
+    int rank = owner == WHITE ? square_y(sq) : 7 - square_y(sq);
+    int center = centrality(sq);
+    switch (type) {
+    case PAWN_ENUM:
+        return rank * 6 + (center >= 5 ? 10 : 0);
+    case KNIGHT_ENUM:
+        return center * 6 - 15;
+    case BISHOP_ENUM:
+        return center * 3;
+    case ROOK_ENUM:
+        return rank == 6 ? 15 : 0;
+    case QUEEN_ENUM:
+        return center;
+    case KING_ENUM:
+        return endgame ? center * 5 : -center * 5;
+    }
+    return 0;
+}
+
+}
+
+
+int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+
+Engine::Engine(size_t hash_mb) : _tt(hash_mb), _tablebases(Tablebases::shared()), _book(OpeningBook::shared()),
+    _own_book(false), _use_tablebases(true), _book_rng(std::chrono::steady_clock::now().time_since_epoch().count()),
+    _stop(false), _movetime(0) {
+    set_threads(1);
+}
+
+void Engine::set_threads(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    _workers.clear();
+    for (int i = 0; i < threads; i++) {
+        _workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        _workers.back()->id = i;
+    }
+    clear();
+}
+
+void Engine::clear() {
+    _tt.clear();
+    for (size_t i = 0; i < _workers.size(); i++) {
+        Worker& w = *_workers[i];
+        w.nodes = 0;
+        w.next_check = 0;
+        std::memset(w.killers, 0, sizeof(w.killers));
+        std::memset(w.history, 0, sizeof(w.history));
+    }
+}
+
+uint64_t Engine::nodes() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < _workers.size(); i++) {
+        total += _workers[i]->node_count();
+    }
+    return total;
+}
+
+int Engine::elapsed() const {
+    return (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - _start).count();
+}
+
+int Engine::evaluate(const Board& b) {
+    int material[2] = {0, 0};
+    bool queens = false;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t c = b.at(sq);
+        if (c == 0 || c == GHOST_CODE) continue;
+        material[code_owner(c)] += PIECE_VALUES[code_type(c)];
+        if (code_type(c) == QUEEN_ENUM) queens = true;
+    }
+    bool endgame = !queens || material[WHITE] + material[BLACK] < 2600;
+    int score = material[WHITE] - material[BLACK];
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t c = b.at(sq);
+        if (c == 0 || c == GHOST_CODE) continue;
+        int bonus = placement(code_type(c), code_owner(c), sq, endgame);
+        score += code_owner(c) == WHITE ? bonus : -bonus;
+    }
+    //King of the Hill: a king near the hill is a threat whatever the material
+    if (b.variant() == VARIANT_KOTH) {
+        const HillTable& hill = HillTable::standard();
+        for (int p = 0; p < 2; p++) {
+            int k = b.king_square(static_cast<Player>(p));
+            int bonus = k >= 0 ? HILL_BONUS[hill.distance(k)] : 0;
+            score += p == WHITE ? bonus : -bonus;
+        }
+    }
+    return b.side() == WHITE ? score : -score;
+}
+
+std::vector<PVLine> Engine::search(const Board& root, const SearchLimits& limits) {
+    _limits = limits;
+    _stop = false;
+    _movetime = limits.movetime;
+    _start = std::chrono::steady_clock::now();
+    _tt.new_search();
+    for (size_t i = 0; i < _workers.size(); i++) {
+        _workers[i]->nodes = 0;
+        _workers[i]->next_check = 0;
+        std::memset(_workers[i]->killers, 0, sizeof(_workers[i]->killers));
+    }
+    //a book move is reported as a depth 0 line without a score
+    Move book_move = _own_book ? _book.pick(root, _book_rng) : NO_MOVE;
+    if (book_move != NO_MOVE) {
+        std::vector<PVLine> result(1);
+        result[0].score = 0;
+        result[0].pv.push_back(book_move);
+        if (_listener) {
+            _listener(result);
+        }
+        return result;
+    }
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < _workers.size(); i++) {
+        helpers.push_back(std::thread(&Engine::iterate, this, std::ref(*_workers[i]), std::cref(root), nullptr));
+    }
+    std::vector<PVLine> result;
+    iterate(*_workers[0], root, &result);
+    _stop = true;
+    for (size_t i = 0; i < helpers.size(); i++) {
+        helpers[i].join();
+    }
+    return result;
+}
+
+//iterative deepening on one thread. Only the main worker passes
+//`result'; helpers start at staggered depths and search a single line.
+void Engine::iterate(Worker& w, const Board& root, std::vector<PVLine>* result) {
+    Board b = root;
+    MoveList list;
+    b.generate_moves(list);
+    if (list.size == 0) {
+        return;
+    }
+    order_moves(w, b, list, NO_MOVE, 0);
+    std::vector<RootMove> moves(list.size);
+    for (int i = 0; i < list.size; i++) {
+        moves[i].move = list.moves[i];
+        moves[i].score = -INFINITE_SCORE;
+        moves[i].pv.assign(1, list.moves[i]);
+    }
+    size_t lines = result ? std::min((size_t) std::max(1, _limits.multipv), moves.size()) : 1;
+    int max_depth = std::min(_limits.depth, MAX_PLY - 1);
+    if (max_depth < 1) max_depth = 1;
+
+    for (int depth = 1 + w.id % 2; depth <= max_depth; depth++) {
+        //each line searches the root moves not already claimed by a better line
+        for (size_t pv_index = 0; pv_index < lines; pv_index++) {
+            search_root(w, b, moves, pv_index, depth);
+            if (_stop) break;
+            std::stable_sort(moves.begin() + pv_index, moves.end(),
+                             [](const RootMove& a, const RootMove& c) { return a.score > c.score; });
+        }
+        if (!result) {
+            if (_stop) break;
+            continue;
+        }
+        //an unfinished iteration is only better than nothing at depth 1
+        if (_stop && depth > 1) break;
+        std::stable_sort(moves.begin(), moves.begin() + lines,
+                         [](const RootMove& a, const RootMove& c) { return a.score > c.score; });
+        result->assign(lines, PVLine());
+        for (size_t i = 0; i < lines; i++) {
+            (*result)[i].score = moves[i].score;
+            (*result)[i].depth = depth;
+            (*result)[i].pv = moves[i].pv;
+        }
+        if (_listener) {
+            _listener(*result);
+        }
+        if (_stop) break;
+    }
+}
+
+//search the root moves from index `first' on with a full window
+int Engine::search_root(Worker& w, Board& b, std::vector<RootMove>& moves, size_t first, int depth) {
+    int alpha = -INFINITE_SCORE, beta = INFINITE_SCORE;
+    for (size_t i = first; i < moves.size(); i++) {
+        RootMove& rm = moves[i];
+        Undo undo;
+        b.make(rm.move, undo);
+        int score;
+        if (i == first) {
+            score = -reply(w, b, depth - 1, -beta, -alpha, 1);
+        } else {
+            score = -reply(w, b, depth - 1, -alpha - 1, -alpha, 1);
+            if (score > alpha && !_stop) {
+                score = -reply(w, b, depth - 1, -beta, -alpha, 1);
+            }
+        }
+        b.unmake(rm.move, undo);
+        if (_stop) {
+            return alpha;
+        }
+        if (score > alpha) {
+            alpha = score;
+            rm.score = score;
+            rm.pv.assign(1, rm.move);
+            for (int j = 1; j < w.pv_length[1]; j++) {
+                rm.pv.push_back(w.pv[1][j]);
+            }
+        } else {
+            rm.score = -INFINITE_SCORE;
+        }
+    }
+    return alpha;
+}
+
+int Engine::alpha_beta(Worker& w, Board& b, int depth, int alpha, int beta, int ply) {
+    w.pv_length[ply] = ply;
+    if (ply >= MAX_PLY) {
+        return evaluate(b);
+    }
+    Player us = b.side();
+    Player them = static_cast<Player>(1 - us);
+    bool koth = b.variant() == VARIANT_KOTH;
+    //the previous mover already won by reaching the hill
+    if (koth && b.on_hill(them)) {
+        return -MATE_SCORE + ply;
+    }
+    //a king one legal step from the hill wins on this move
+    if (koth && b.can_reach_hill(us)) {
+        return MATE_SCORE - ply - 1;
+    }
+    bool check = b.in_check(us);
+    if (check) {
+        depth++;
+    }
+    if (depth <= 0) {
+        return quiesce(w, b, alpha, beta, ply);
+    }
+    if (out_of_budget(w)) {
+        return 0;
+    }
+    w.count_node();
+
+    //endgame tables know the exact result
+    TbResult tb;
+    if (ply > 0 && _use_tablebases && _tablebases.max_pieces() > 0 && _tablebases.probe(b, tb)) {
+        if (tb.outcome == TB_DRAW) {
+            return 0;
+        }
+        int plies = ply + std::min(tb.plies, MAX_TB_PLIES);
+        return tb.outcome == TB_WIN ? MATE_SCORE - plies : -MATE_SCORE + plies;
+    }
+
+    bool pv_node = beta - alpha > 1;
+    Move tt_move = NO_MOVE;
+    TTHit hit;
+    if (_tt.probe(b.key(), hit)) {
+        tt_move = hit.move;
+        if (!pv_node && hit.depth >= depth) {
+            int score = score_from_tt(hit.score, ply);
+            if (hit.bound == BOUND_EXACT ||
+                (hit.bound == BOUND_LOWER && score >= beta) ||
+                (hit.bound == BOUND_UPPER && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    MoveList list;
+    b.generate_moves(list);
+    if (list.size == 0) {
+        return check ? -MATE_SCORE + ply : 0;
+    }
+    order_moves(w, b, list, tt_move, ply);
+
+    int best = -INFINITE_SCORE;
+    Move best_move = NO_MOVE;
+    int original_alpha = alpha;
+    const HillTable& hill = HillTable::standard();
+    for (int i = 0; i < list.size; i++) {
+        Move m = list.moves[i];
+        //King of the Hill: a king arriving next to the hill is searched a ply deeper
+        int new_depth = depth - 1;
+        if (koth && move_from(m) == b.king_square(us) &&
+            hill.distance(move_to(m)) == 1 && hill.distance(move_from(m)) > 1) {
+            new_depth++;
+        }
+        Undo undo;
+        b.make(m, undo);
+        int score;
+        if (koth && !b.on_hill(us) && b.can_reach_hill(them)) {
+            //the opponent walks onto the hill unopposed, no need to search
+            score = -MATE_SCORE + ply + 2;
+        } else if (i == 0) {
+            score = -reply(w, b, new_depth, -beta, -alpha, ply + 1);
+        } else {
+            score = -reply(w, b, new_depth, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && score < beta && !_stop) {
+                score = -reply(w, b, new_depth, -beta, -alpha, ply + 1);
+            }
+        }
+        b.unmake(m, undo);
+        if (_stop) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            best_move = m;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(w, ply, m);
+                if (alpha >= beta) {
+                    if (!(move_flags(m) & FLAG_CAPTURE)) {
+                        if (w.killers[ply][0] != m) {
+                            w.killers[ply][1] = w.killers[ply][0];
+                            w.killers[ply][0] = m;
+                        }
+                        w.history[move_from(m)][move_to(m)] += depth * depth;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    Bound bound = best >= beta ? BOUND_LOWER : (best > original_alpha ? BOUND_EXACT : BOUND_UPPER);
+    _tt.store(b.key(), best_move, score_to_tt(best, ply), depth, bound);
+    return best;
+}
+
+//the opponent's turn after a move; in Spooky Chess the ghost jumps first
+int Engine::reply(Worker& w, Board& b, int depth, int alpha, int beta, int ply) {
+    if (b.variant() == VARIANT_SPOOKY && b.ghost_square() >= 0) {
+        return chance(w, b, depth, alpha, beta, ply);
+    }
+    return alpha_beta(w, b, depth, alpha, beta, ply);
+}
+
+//Spooky Chess chance node, entered after every move. The game ends at
+//once if the player to move is mated or stalemated; otherwise the ghost
+//jumps to one of the n non-king squares with probability 1/n.
+//Landing on an empty square only moves a blocker, so those landings are
+//searched once as "the ghost stays" with their combined weight, and each
+//capture is searched separately two plies shallower. Star1: with weighted
+//sum S over the landings searched so far and weight r left, the result
+//lies in [(S + r*L) / n, (S + r*U) / n], which both narrows the window of
+//every landing and stops the node once the window is out of reach.
+int Engine::chance(Worker& w, Board& b, int depth, int alpha, int beta, int ply) {
+    w.pv_length[ply] = ply;
+    if (ply >= MAX_PLY) {
+        return evaluate(b);
+    }
+    Player us = b.side();
+    if (!b.has_legal_move()) {
+        return b.in_check(us) ? -MATE_SCORE + ply : 0;
+    }
+    int n = 0, swing = 0, count = 0;
+    int captures[BOARD_SQUARES];
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t c = b.at(sq);
+        if (c != 0 && code_type(c) == KING_ENUM) continue;
+        n++;
+        if (c == 0 || c == GHOST_CODE) continue;
+        captures[count++] = sq;
+        swing += code_owner(c) == us ? -PIECE_VALUES[code_type(c)] : PIECE_VALUES[code_type(c)];
+    }
+    //near the horizon a capture landing is valued as the ghost staying
+    //minus the piece it takes, so every piece is lost with probability 1/n
+    if (depth < 3) {
+        int expected = swing / n;
+        if (depth <= 0) {
+            return quiesce(w, b, alpha - expected, beta - expected, ply) + expected;
+        }
+        return ghost_outcome(w, b, depth, alpha - expected, beta - expected, ply) + expected;
+    }
+    if (out_of_budget(w)) {
+        return 0;
+    }
+    w.count_node();
+
+    uint64_t key = b.key() ^ CHANCE_KEY;
+    TTHit hit;
+    if (_tt.probe(key, hit) && hit.depth >= depth) {
+        int score = score_from_tt(hit.score, ply);
+        if (hit.bound == BOUND_EXACT ||
+            (hit.bound == BOUND_LOWER && score >= beta) ||
+            (hit.bound == BOUND_UPPER && score <= alpha)) {
+            return score;
+        }
+    }
+
+    //biggest swings first, they decide the Star1 cutoffs soonest
+    std::sort(captures, captures + count, [&b](int x, int y) {
+        return PIECE_VALUES[code_type(b.at(x))] > PIECE_VALUES[code_type(b.at(y))];
+    });
+    const int low = -CHANCE_BOUND, high = CHANCE_BOUND;
+    int sum = 0, left = n;
+    int ghost = b.ghost_square();
+    Move line[MAX_PLY + 1];
+    int line_length = ply;
+    for (int i = -1; i < count; i++) {
+        int weight = i < 0 ? n - count : 1;
+        int child_depth = i < 0 ? depth : depth - 2;
+        left -= weight;
+        int child_alpha = std::max(low - 1, (n * alpha - sum - left * high) / weight - 1);
+        int child_beta = std::min(high + 1, (n * beta - sum - left * low) / weight + 1);
+        int score;
+        if (i < 0) {
+            score = ghost_outcome(w, b, child_depth, child_alpha, child_beta, ply);
+            //report the line where the ghost stays put
+            line_length = w.pv_length[ply];
+            std::copy(w.pv[ply] + ply, w.pv[ply] + line_length, line + ply);
+        } else {
+            Undo undo;
+            b.jump_ghost(captures[i], undo);
+            score = ghost_outcome(w, b, child_depth, child_alpha, child_beta, ply);
+            b.unjump_ghost(ghost, undo);
+        }
+        if (_stop) {
+            return 0;
+        }
+        sum += weight * std::max(low, std::min(high, score));
+        if (sum + left * high <= n * alpha) {
+            sum += left * high;
+            break;
+        }
+        if (sum + left * low >= n * beta) {
+            sum += left * low;
+            break;
+        }
+    }
+    int value = sum / n;
+    std::copy(line + ply, line + line_length, w.pv[ply] + ply);
+    w.pv_length[ply] = line_length;
+    Bound bound = value >= beta ? BOUND_LOWER : (value <= alpha ? BOUND_UPPER : BOUND_EXACT);
+    _tt.store(key, NO_MOVE, score_to_tt(value, ply), depth, bound);
+    return value;
+}
+
+//one ghost landing, judged the way SpookyChessGame::make_move does once
+//the ghost has moved: either king may now be mated, stalemated, or the
+//player who just moved may be left in check, which loses
+int Engine::ghost_outcome(Worker& w, Board& b, int depth, int alpha, int beta, int ply) {
+    Player us = b.side();
+    Player mover = static_cast<Player>(1 - us);
+    bool check = b.in_check(us), mover_check = b.in_check(mover);
+    bool can_move = b.has_legal_move();
+    if (check && !can_move) {
+        return -MATE_SCORE + ply;
+    }
+    bool mover_can_move = b.can_move(mover);
+    if (mover_check && !mover_can_move) {
+        return MATE_SCORE - ply;
+    }
+    if (!can_move || !mover_can_move) {
+        return 0;
+    }
+    if (mover_check && !check) {
+        return MATE_SCORE - ply;
+    }
+    return alpha_beta(w, b, depth, alpha, beta, ply);
+}
+
+//only look at captures until the position is quiet
+int Engine::quiesce(Worker& w, Board& b, int alpha, int beta, int ply) {
+    w.pv_length[ply] = ply;
+    if (out_of_budget(w)) {
+        return 0;
+    }
+    w.count_node();
+    if (ply >= MAX_PLY) {
+        return evaluate(b);
+    }
+    Player us = b.side();
+    if (b.variant() == VARIANT_KOTH) {
+        if (b.on_hill(static_cast<Player>(1 - us))) {
+            return -MATE_SCORE + ply;
+        }
+        if (b.can_reach_hill(us)) {
+            return MATE_SCORE - ply - 1;
+        }
+    }
+    MoveList list;
+    int best;
+    if (b.in_check(us)) {
+        b.generate_moves(list);
+        if (list.size == 0) {
+            return -MATE_SCORE + ply;
+        }
+        best = -INFINITE_SCORE;
+    } else {
+        best = evaluate(b);
+        if (best >= beta) {
+            return best;
+        }
+        if (best > alpha) {
+            alpha = best;
+        }
+        b.generate_captures(list);
+    }
+    order_moves(w, b, list, NO_MOVE, ply);
+    for (int i = 0; i < list.size; i++) {
+        Move m = list.moves[i];
+        Undo undo;
+        b.make(m, undo);
+        int score = -quiesce(w, b, -beta, -alpha, ply + 1);
+        b.unmake(m, undo);
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(w, ply, m);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    return best;
+}
+
+//hash move, then captures by most valuable victim, then killers and history
+void Engine::order_moves(const Worker& w, const Board& b, MoveList& list, Move tt_move, int ply) const {
+    int scores[MAX_MOVES];
+    for (int i = 0; i < list.size; i++) {
+        Move m = list.moves[i];
+        int score;
+        if (m == tt_move) {
+            score = 1 << 30;
+        } else if (move_flags(m) & (FLAG_CAPTURE | FLAG_PROMOTION)) {
+            int victim = b.at(move_to(m)) ? PIECE_VALUES[code_type(b.at(move_to(m)))] : 0;
+            int attacker = PIECE_VALUES[code_type(b.at(move_from(m)))];
+            score = (1 << 28) + victim * 16 - attacker / 16 +
+                (move_flags(m) & FLAG_PROMOTION ? PIECE_VALUES[QUEEN_ENUM] : 0);
+        } else if (m == w.killers[ply][0]) {
+            score = (1 << 27) + 1;
+        } else if (m == w.killers[ply][1]) {
+            score = 1 << 27;
+        } else {
+            score = w.history[move_from(m)][move_to(m)];
+        }
+        scores[i] = score;
+    }
+    //insertion sort, lists are short
+    for (int i = 1; i < list.size; i++) {
+        Move m = list.moves[i];
+        int s = scores[i];
+        int j = i - 1;
+        while (j >= 0 && scores[j] < s) {
+            scores[j + 1] = scores[j];
+            list.moves[j + 1] = list.moves[j];
+            j--;
+        }
+        scores[j + 1] = s;
+        list.moves[j + 1] = m;
+    }
+}
+
+//only the main worker watches the clock and node budget. It looks again
+//after at most CHECK_INTERVAL nodes, and no later than the node limit.
+bool Engine::out_of_budget(Worker& w) {
+    if (_stop) {
+        return true;
+    }
+    if (w.id != 0 || w.node_count() < w.next_check) {
+        return false;
+    }
+    w.next_check = w.node_count() + CHECK_INTERVAL;
+    int movetime = _movetime;
+    if (_limits.nodes) {
+        uint64_t total = nodes();
+        if (total >= _limits.nodes) {
+            _stop = true;
+            return true;
+        }
+        w.next_check = std::min(w.next_check, w.node_count() + (_limits.nodes - total));
+    }
+    if (movetime && elapsed() >= movetime) {
+        _stop = true;
+    }
+    return _stop;
+}
+
+void Engine::update_pv(Worker& w, int ply, Move m) {
+    w.pv[ply][ply] = m;
+    for (int j = ply + 1; j < w.pv_length[ply + 1]; j++) {
+        w.pv[ply][j] = w.pv[ply + 1][j];
+    }
+    w.pv_length[ply] = std::max(w.pv_length[ply + 1], ply + 1);
+}
+
+std::string format_score(int score) {
+    if (score >= MATE_BOUND) {
+        return "#" + std::to_string((MATE_SCORE - score + 1) / 2);
+    }
+    if (score <= -MATE_BOUND) {
+        return "#-" + std::to_string((MATE_SCORE + score) / 2);
+    }
+    std::string sign = score < 0 ? "-" : "+";
+    int cp = std::abs(score);
+    std::string frac = std::to_string(cp % 100);
+    if (frac.size() < 2) frac = "0" + frac;
+    return sign + std::to_string(cp / 100) + "." + frac;
+}
@@ -0,0 +1,188 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Board.h"
+#include "TranspositionTable.h"
+
+class OpeningBook;
+class Tablebases;
+
+/*
+Alpha-beta search over a Board. There was never an AI opponent in this
+game, so the engine is only used to analyse positions for the players.
+
+In standard chess endgames covered by the tablebases (see Tablebase.h)
+the search takes the exact result from the tables instead of searching.
+With its own book enabled, standard chess positions in the opening book
+(see Book.h) are answered with a weighted random book move at once.
+
+In Spooky Chess the ghost jumps at random after every move, so the search
+becomes expectimax: each move leads to a chance node averaging over the
+ghost's landing squares, pruned with Star1 bounds and cached in the
+transposition table like any other node.
+*/
+
+static const int MAX_PLY = 64;
+static const int MATE_SCORE = 30000;
+static const int INFINITE_SCORE = 32000;
+
+// Longest tablebase mate, in plies, that scores as a mate
+static const int MAX_TB_PLIES = 256;
+
+// Scores above this bound are forced mates, found by the search or in
+// the tablebases
+static const int MATE_BOUND = MATE_SCORE - MAX_PLY - MAX_TB_PLIES;
+
+// Spooky Chess chance nodes clamp the value of each ghost landing to
+// +-CHANCE_BOUND, keeping the Star1 bounds tight enough to prune
+static const int CHANCE_BOUND = 3000;
+
+// What the search is allowed to spend. Zero means no limit.
+struct SearchLimits {
+    int depth;
+    int multipv;
+    uint64_t nodes;
+    int movetime;   // milliseconds
+
+    SearchLimits() : depth(MAX_PLY - 1), multipv(1), nodes(0), movetime(0) {}
+};
+
+// One analysed line: a root move, its score for the side
+// to move and the expected continuation starting with it
+struct PVLine {
+    int score;
+    int depth;
+    std::vector<Move> pv;
+
+    PVLine() : score(-INFINITE_SCORE), depth(0) {}
+};
+
+
+class Engine {
+
+public:
+
+    // Called after every completed iteration with the current lines
+    typedef std::function<void(const std::vector<PVLine>&)> Listener;
+
+    // Creates an engine with a transposition table of `hash_mb' megabytes
+    Engine(size_t hash_mb = 16);
+
+    // Search the position and return the best `limits.multipv' root moves,
+    // best first. All lines share the transposition table, so the second
+    // line onwards is mostly answered from positions the first one stored.
+    std::vector<PVLine> search(const Board& root, const SearchLimits& limits);
+
+    // Ask a running search to return as soon as possible (thread safe)
+    void stop() { _stop = true; }
+
+    // Change the time limit of a running search (thread safe). The
+    // limit counts from the start of the search, zero removes it.
+    void set_movetime(int milliseconds) { _movetime = milliseconds; }
+
+    // Resize the transposition table
+    void set_hash(size_t megabytes) { _tt.resize(megabytes); }
+
+    // Number of threads searching together. Helper threads search the
+    // same root at staggered depths and share results through the
+    // transposition table only.
+    void set_threads(int threads);
+
+    int threads() const { return (int) _workers.size(); }
+
+    // Play moves from the opening book when the root is in it
+    void set_own_book(bool own_book) { _own_book = own_book; }
+
+    // Take endgame results from the tablebases (on by default)
+    void set_use_tablebases(bool use) { _use_tablebases = use; }
+
+    // Forget everything learned in previous searches
+    void clear();
+
+    // Report every completed iteration to `listener'
+    void set_listener(Listener listener) { _listener = listener; }
+
+    // Nodes visited by the last search, over all threads
+    uint64_t nodes() const;
+
+    // Milliseconds since the last search started
+    int elapsed() const;
+
+    // Static evaluation in centipawns for the side to move
+    static int evaluate(const Board& b);
+
+private:
+
+    struct RootMove {
+        Move move;
+        int score;
+        std::vector<Move> pv;
+    };
+
+    // Search state owned by one thread. Worker 0 reports the results.
+    // nodes() reads the node counts while the workers run, so they are
+    // atomic; only the owner writes its count, which needs no locked add.
+    struct Worker {
+        int id;
+        std::atomic<uint64_t> nodes;
+        uint64_t next_check;      // node count of the next budget check
+        Move pv[MAX_PLY + 1][MAX_PLY + 1];
+        int pv_length[MAX_PLY + 1];
+        Move killers[MAX_PLY + 1][2];
+        int history[BOARD_SQUARES][BOARD_SQUARES];
+
+        uint64_t node_count() const { return nodes.load(std::memory_order_relaxed); }
+        void count_node() { nodes.store(node_count() + 1, std::memory_order_relaxed); }
+    };
+
+    TranspositionTable _tt;
+    const Tablebases& _tablebases;
+    const OpeningBook& _book;
+    bool _own_book;
+    bool _use_tablebases;
+    Rng _book_rng;
+    std::vector<std::unique_ptr<Worker> > _workers;
+    std::atomic<bool> _stop;
+    std::atomic<int> _movetime;
+    SearchLimits _limits;
+    std::chrono::steady_clock::time_point _start;
+    Listener _listener;
+
+    void iterate(Worker& w, const Board& root, std::vector<PVLine>* result);
+
+    int search_root(Worker& w, Board& b, std::vector<RootMove>& moves, size_t first, int depth);
+
+    int alpha_beta(Worker& w, Board& b, int depth, int alpha, int beta, int ply);
+
+    int reply(Worker& w, Board& b, int depth, int alpha, int beta, int ply);
+
+    int chance(Worker& w, Board& b, int depth, int alpha, int beta, int ply);
+
+    int ghost_outcome(Worker& w, Board& b, int depth, int alpha, int beta, int ply);
+
+    int quiesce(Worker& w, Board& b, int alpha, int beta, int ply);
+
+    void order_moves(const Worker& w, const Board& b, MoveList& list, Move tt_move, int ply) const;
+
+    bool out_of_budget(Worker& w);
+
+    void update_pv(Worker& w, int ply, Move m);
+
+};
+
+// Convert a score to/from its transposition table form, where
+// mate scores count from the stored node instead of the root
+int score_to_tt(int score, int ply);
+int score_from_tt(int score, int ply);
+
+// Human readable score: pawns for the side to move ("+0.35") or mate ("#3")
+std::string format_score(int score);
+
+#endif // ENGINE_H
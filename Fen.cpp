@@ -0,0 +1,244 @@
+#include <cstring>
+#include <string>
+
+#include "Fen.h"
+#include "Board.h"
+#include "Piece.h"
+
+namespace {
+
+// FEN letter of each PieceEnum, white pieces
+const char FEN_LETTERS[] = "PRNBQK";
+
+// Castling letters in CastlingRight order
+const char CASTLING_LETTERS[] = "KQkq";
+
+int skip_spaces(const char* text, int i) {
+    while (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n') i++;
+    return i;
+}
+
+//reads an unsigned number, false if there is none
+bool read_number(const char* text, int& i, uint64_t& n) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    n = 0;
+    while (text[i] >= '0' && text[i] <= '9') {
+        n = n * 10 + (uint64_t) (text[i++] - '0');
+    }
+    return true;
+}
+
+int read_square(const char* text) {
+    if (text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8') return -1;
+    return make_square(text[0] - 'a', text[1] - '1');
+}
+
+bool opcode_is(const EpdOperation& op, const char* name) {
+    return std::strlen(name) == op.opcode_length && !std::strncmp(op.opcode, name, op.opcode_length);
+}
+
+}
+
+
+const EpdOperation* FenPosition::operation(const char* opcode) const {
+    for (int i = 0; i < operation_count; i++) {
+        if (opcode_is(operations[i], opcode)) return &operations[i];
+    }
+    return nullptr;
+}
+
+bool FenPosition::piece_moved(int sq) const {
+    uint8_t c = squares[sq];
+    int type = code_type(c);
+    if (c == 0 || (type != KING_ENUM && type != ROOK_ENUM)) {
+        return false;
+    }
+    int white = code_owner(c) == WHITE;
+    int home = white ? 0 : 7;
+    bool king_side = castling[white ? WHITE_KING_SIDE : BLACK_KING_SIDE];
+    bool queen_side = castling[white ? WHITE_QUEEN_SIDE : BLACK_QUEEN_SIDE];
+    if (type == KING_ENUM) {
+        return !(sq == make_square(4, home) && (king_side || queen_side));
+    }
+    return !((sq == make_square(7, home) && king_side) || (sq == make_square(0, home) && queen_side));
+}
+
+bool parse_fen(const char* text, Variant variant, FenPosition& fen) {
+    std::memset(fen.squares, 0, sizeof(fen.squares));
+    fen.side = WHITE;
+    fen.castling[0] = fen.castling[1] = fen.castling[2] = fen.castling[3] = false;
+    fen.en_passant = -1;
+    fen.halfmove = 0;
+    fen.fullmove = 1;
+    fen.ghost = -1;
+    fen.rng_seed = SPOOKY_SEED;
+    fen.rng_counter = 0;
+    fen.operation_count = 0;
+
+    //piece placement, rank 8 first
+    int i = skip_spaces(text, 0);
+    int x = 0, y = 7;
+    int kings[2] = {0, 0};
+    for (; text[i] && text[i] != ' '; i++) {
+        char c = text[i];
+        if (c == '/') {
+            if (x != 8 || y == 0) return false;
+            x = 0;
+            y--;
+        } else if (c >= '1' && c <= '8') {
+            x += c - '0';
+            if (x > 8) return false;
+        } else {
+            const char* p = std::strchr(FEN_LETTERS, c >= 'a' ? c - 'a' + 'A' : c);
+            if (p == nullptr || *p == '\0' || x > 7) return false;
+            fen.squares[make_square(x++, y)] = piece_code((int) (p - FEN_LETTERS), c >= 'a' ? BLACK : WHITE);
+            if (p - FEN_LETTERS == KING_ENUM) kings[c >= 'a']++;
+        }
+    }
+    if (x != 8 || y != 0) return false;
+    if (kings[WHITE] != 1 || kings[BLACK] != 1) return false;
+
+    //side to move
+    i = skip_spaces(text, i);
+    if (text[i] != 'w' && text[i] != 'b') return false;
+    fen.side = text[i++] == 'w' ? WHITE : BLACK;
+
+    //castling rights
+    i = skip_spaces(text, i);
+    if (text[i] == '-') {
+        i++;
+    } else {
+        for (; text[i] && text[i] != ' '; i++) {
+            const char* p = std::strchr(CASTLING_LETTERS, text[i]);
+            if (p == nullptr || *p == '\0') return false;
+            fen.castling[p - CASTLING_LETTERS] = true;
+        }
+    }
+
+    //en passant square
+    i = skip_spaces(text, i);
+    if (text[i] == '-') {
+        i++;
+    } else {
+        fen.en_passant = read_square(text + i);
+        if (fen.en_passant < 0) return false;
+        i += 2;
+    }
+
+    //optional clocks (FEN), then operations (EPD)
+    i = skip_spaces(text, i);
+    uint64_t number;
+    if (read_number(text, i, number)) {
+        fen.halfmove = (int) number;
+        i = skip_spaces(text, i);
+        if (!read_number(text, i, number) || number < 1) return false;
+        fen.fullmove = (int) number;
+    }
+    while (true) {
+        i = skip_spaces(text, i);
+        if (!text[i]) break;
+        if (fen.operation_count == MAX_EPD_OPERATIONS) return false;
+        EpdOperation& op = fen.operations[fen.operation_count++];
+        op.opcode = text + i;
+        while (text[i] && text[i] != ' ' && text[i] != ';') i++;
+        op.opcode_length = (size_t) (text + i - op.opcode);
+        i = skip_spaces(text, i);
+        op.operand = text + i;
+        bool quoted = false;
+        while (text[i] && (quoted || text[i] != ';')) {
+            if (text[i] == '"') quoted = !quoted;
+            i++;
+        }
+        op.operand_length = (size_t) (text + i - op.operand);
+        while (op.operand_length > 0 && op.operand[op.operand_length - 1] == ' ') op.operand_length--;
+        if (text[i] == ';') i++;
+
+        int j = 0;
+        if (opcode_is(op, "hmvc")) {
+            if (!read_number(op.operand, j, number)) return false;
+            fen.halfmove = (int) number;
+        } else if (opcode_is(op, "fmvn")) {
+            if (!read_number(op.operand, j, number) || number < 1) return false;
+            fen.fullmove = (int) number;
+        } else if (opcode_is(op, "ghost")) {
+            if (variant != VARIANT_SPOOKY) return false;
+            fen.ghost = op.operand_length == 2 ? read_square(op.operand) : -1;
+            if (fen.ghost < 0 || fen.squares[fen.ghost] != 0) return false;
+        } else if (opcode_is(op, "rng")) {
+            //"seed counter", or only the counter of the default seed
+            uint64_t first, second;
+            if (!read_number(op.operand, j, first)) return false;
+            while (op.operand[j] == ' ') j++;
+            if ((size_t) j < op.operand_length && read_number(op.operand, j, second)) {
+                fen.rng_seed = first;
+                fen.rng_counter = second;
+            } else {
+                fen.rng_counter = first;
+            }
+        }
+    }
+    return true;
+}
+
+void fen_to_board(const FenPosition& fen, Variant variant, Board& b) {
+    b = Board(variant);
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        if (fen.squares[sq] != 0) {
+            b.put(sq, fen.squares[sq]);
+            b.set_moved(sq, fen.piece_moved(sq));
+        }
+    }
+    if (fen.ghost >= 0) {
+        b.put(fen.ghost, GHOST_CODE);
+    }
+    b.set_side(fen.side);
+    b.set_turn(fen.turn());
+    b.set_rng(Rng(fen.rng_seed, fen.rng_counter));
+    b.refresh();
+}
+
+std::string board_to_fen(const Board& b, int halfmove) {
+    std::string fen;
+    for (int y = 7; y >= 0; y--) {
+        int empty = 0;
+        for (int x = 0; x < 8; x++) {
+            uint8_t c = b.at(make_square(x, y));
+            if (c == 0 || c == GHOST_CODE) {
+                empty++;
+                continue;
+            }
+            if (empty) fen += (char) ('0' + empty);
+            empty = 0;
+            char letter = FEN_LETTERS[code_type(c)];
+            fen += code_owner(c) == BLACK ? (char) (letter - 'A' + 'a') : letter;
+        }
+        if (empty) fen += (char) ('0' + empty);
+        if (y) fen += '/';
+    }
+    fen += b.side() == WHITE ? " w " : " b ";
+    //a right survives while the king and that rook are unmoved at home
+    std::string rights;
+    for (int color = 0; color < 2; color++) {
+        Player p = static_cast<Player>(color);
+        int home = p == WHITE ? 0 : 7;
+        int king = make_square(4, home);
+        if (b.at(king) != piece_code(KING_ENUM, p) || b.has_moved(king)) continue;
+        uint8_t rook = piece_code(ROOK_ENUM, p);
+        if (b.at(make_square(7, home)) == rook && !b.has_moved(make_square(7, home))) {
+            rights += p == WHITE ? 'K' : 'k';
+        }
+        if (b.at(make_square(0, home)) == rook && !b.has_moved(make_square(0, home))) {
+            rights += p == WHITE ? 'Q' : 'q';
+        }
+    }
+    fen += rights.empty() ? "-" : rights;
+    fen += " - " + std::to_string(halfmove) + " " + std::to_string((b.turn() + 1) / 2);
+    if (b.ghost_square() >= 0) {
+        int g = b.ghost_square();
+        fen += " ghost ";
+        fen += (char) ('a' + square_x(g));
+        fen += (char) ('1' + square_y(g));
+        fen += "; rng " + std::to_string(b.rng().seed()) + " " + std::to_string(b.rng().counter()) + ";";
+    }
+    return fen;
+}
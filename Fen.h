@@ -0,0 +1,77 @@
+#ifndef FEN_H
+#define FEN_H
+
+#include <cstddef>
+#include <string>
+#include "Board.h"
+
+/*
+Forsyth-Edwards Notation (FEN) and Extended Position Description (EPD).
+
+parse_fen accepts either form: the four position fields, then optional
+halfmove clock and fullmove number, then EPD operations ("bm Nf3; id x;").
+It never allocates: operations are kept as pointers into the parsed text,
+which must outlive the FenPosition.
+
+Spooky Chess has no place in FEN for the ghost or its random number
+generator, so they travel as the extension operations "ghost a5;" and
+"rng <seed> <counter>;".
+*/
+
+static const int MAX_EPD_OPERATIONS = 16;
+
+// One EPD operation, pointing into the parsed text
+struct EpdOperation {
+    const char* opcode;
+    size_t opcode_length;
+    const char* operand;
+    size_t operand_length;
+
+    std::string operand_string() const { return std::string(operand, operand_length); }
+};
+
+// Indexes of FenPosition::castling
+enum CastlingRight {
+    WHITE_KING_SIDE = 0,
+    WHITE_QUEEN_SIDE,
+    BLACK_KING_SIDE,
+    BLACK_QUEEN_SIDE
+};
+
+struct FenPosition {
+    uint8_t squares[BOARD_SQUARES];   // Board piece codes, never the ghost
+    Player side;
+    bool castling[4];
+    int en_passant;                   // recorded only: these rules have no en passant
+    int halfmove;
+    int fullmove;
+    int ghost;                        // Spooky Chess ghost square, -1 if none
+    uint64_t rng_seed;                // Spooky Chess ghost generator
+    uint64_t rng_counter;
+    EpdOperation operations[MAX_EPD_OPERATIONS];
+    int operation_count;
+
+    // The operation with the given opcode, nullptr if there is none
+    const EpdOperation* operation(const char* opcode) const;
+
+    // Game turn number (Game::turn) of this position
+    int turn() const { return 2 * (fullmove - 1) + 1 + (side == BLACK); }
+
+    // Whether the piece on `sq' should count as moved. Castling rights
+    // are the only history FEN keeps, so a king or rook that still has
+    // one is unmoved and every other king or rook has moved.
+    bool piece_moved(int sq) const;
+};
+
+// Parse FEN or EPD text for a variant. Returns false if the text is
+// malformed, either side hasn't exactly one king, or there is a ghost
+// outside Spooky Chess.
+bool parse_fen(const char* text, Variant variant, FenPosition& fen);
+
+// Set up a Board from a parsed position
+void fen_to_board(const FenPosition& fen, Variant variant, Board& b);
+
+// FEN of a Board, followed by the ghost and rng operations in Spooky Chess
+std::string board_to_fen(const Board& b, int halfmove = 0);
+
+#endif // FEN_H
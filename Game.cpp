@@ -6,12 +6,24 @@
 #include <sstream>
 #include <fstream>
 #include <ctype.h>
+#include <unistd.h>
 
 #include "Game.h"
 #include "Prompts.h"
 #include "Piece.h"
 #include "Terminal.h"
 #include "Enumerations.h"
+#include "Board.h"
+#include "Engine.h"
+#include "Fen.h"
+#include "WinEstimator.h"
+#include "Mcts.h"
+#include "MateSolver.h"
+#include "Book.h"
+#include "Renderer.h"
+#include "Spectator.h"
+#include "SaveFile.h"
+#include "Database.h"
 
 Game::~Game() {
 
@@ -21,6 +33,7 @@ Game::~Game() {
     }
 
     // Delete any other dynamically-allocated resources here
+    close_screen();
 
 
     for (unsigned int i = 0; i < _width * _height; i++) {
@@ -103,13 +116,23 @@ bool Game::process_move(std::string line ) {
     return true;
   }
   //attempt to move
-  int result = make_move(Position(x1, y1), Position(x2, y2));
+  return after_move(make_move(Position(x1, y1), Position(x2, y2)));
+}
+
+bool Game::after_move(int result) {
+  if (result > 0) {
+    publish(result, _moves.empty() ? NO_MOVE : _moves.back().move);
+  }
   if (result < status::MOVE_CHECKMATE) {
     return true;
   }
+  //the final board stays on the normal screen
+  close_screen();
   //if game is flagged to print the board than do so
   if (_print_board) {
-    print_board();
+    _renderer.begin();
+    compose_board();
+    _renderer.flush();
   }
   Prompts::game_over();
   return false;
@@ -128,23 +151,316 @@ bool Game::process_input(std::string line) {
   } else if (input == "board") {
     if (_print_board) {
       _print_board = false;
+      close_screen();
     } else {
       _print_board = true;
     }
     return true;
     //bring prompts for saving game state
   } else if (input == "save") {
-    save_file();
+    save_file(false);
+    return true;
+    //save in the text format
+  } else if (input == "export") {
+    save_file(true);
     return true;
     //forfeit game
   } else if (input == "forfeit") {
+    publish(status::GAME_OVER, NO_MOVE);
     Prompts::win(static_cast<Player>(turn() % 2), turn());
     Prompts::game_over();
     return false;
+    //show the engine's top lines for the player to move
+  } else if (input == "analyze") {
+    analyze(line);
+    return true;
+    //estimate each side's chances from random playouts
+  } else if (input == "odds") {
+    estimate_odds(line);
+    return true;
+    //tree search, reusing the tree of the previous mcts command
+  } else if (input == "mcts") {
+    search_mcts(line);
+    return true;
+    //prove or disprove a forced mate
+  } else if (input == "solve") {
+    solve_mate(line);
+    return true;
+    //list the opening book's moves
+  } else if (input == "book") {
+    show_book();
+    return true;
+    //list the moves database games played from here
+  } else if (input == "games") {
+    show_games();
+    return true;
+    //take back the last move
+  } else if (input == "undo") {
+    if (!undo_move()) {
+      Prompts::nothing_to_undo();
+    } else {
+      publish(status::SUCCESS, NO_MOVE);
+    }
+    return true;
+    //play the last move taken back again
+  } else if (input == "redo") {
+    return after_move(redo_move());
+    //print the position as FEN
+  } else if (input == "fen") {
+    Prompts::fen(fen());
+    return true;
+    //publish the game to spectators
+  } else if (input == "broadcast") {
+    broadcast(line);
+    return true;
   }
   return process_move(line);
 }
 
+//copy the pieces and moved flags out of the game
+bool Game::to_board(Board& board) const {
+  if (_width != 8 || _height != 8) {
+    return false;
+  }
+  std::string type = return_game_type();
+  board = Board(type == "king" ? VARIANT_KOTH : (type == "spooky" ? VARIANT_SPOOKY : VARIANT_CHESS));
+  for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+    Piece* p = get_piece(Position(square_x(sq), square_y(sq)));
+    if (p != nullptr) {
+      board.put(sq, piece_code(p->piece_type(), p->owner()));
+      board.set_moved(sq, p->has_moved());
+    }
+  }
+  board.set_side(player_turn());
+  board.set_turn(_turn);
+  if (rng() != nullptr) {
+    board.set_rng(*rng());
+  }
+  board.refresh();
+  return true;
+}
+
+//analyze [depth] [lines]
+//prints the best `lines' moves (Multi-PV) for the player to move
+void Game::analyze(std::string line) const {
+  std::istringstream is(line);
+  std::string command;
+  SearchLimits limits;
+  limits.depth = 5;
+  limits.multipv = 3;
+  is >> command;
+  if (!(is >> limits.depth)) {
+    limits.depth = 5;
+  } else if (!(is >> limits.multipv)) {
+    limits.multipv = 3;
+  }
+  Board board;
+  if (limits.depth < 1 || limits.multipv < 1 || !to_board(board)) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  Engine engine;
+  std::vector<PVLine> lines = engine.search(board, limits);
+  if (lines.empty()) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  Prompts::analysis_header(player_turn(), lines[0].depth);
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string pv;
+    for (size_t j = 0; j < lines[i].pv.size(); j++) {
+      pv += (j ? " " : "") + move_to_string(lines[i].pv[j]);
+    }
+    Prompts::analysis_line(i + 1, format_score(lines[i].score), pv);
+  }
+}
+
+//odds [playouts]
+//plays random games from here on every core, reporting as the interval narrows
+void Game::estimate_odds(std::string line) const {
+  std::istringstream is(line);
+  std::string command;
+  long playouts = 20000;
+  is >> command;
+  if (!(is >> playouts)) {
+    playouts = 20000;
+  }
+  Board board;
+  if (playouts < 1 || !to_board(board)) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  WinEstimator estimator;
+  estimator.set_listener([](const WinEstimate& e) {
+    Prompts::win_estimate(e.playouts, e.probability(WHITE), e.margin(WHITE),
+                          e.probability(BLACK), e.margin(BLACK), e.probability(NO_ONE));
+  });
+  estimator.estimate(board, (uint64_t) playouts);
+}
+
+//mcts [playouts] [lines]
+//Monte Carlo Tree Search on every core, an alternative to analyze
+void Game::search_mcts(std::string line) {
+  std::istringstream is(line);
+  std::string command;
+  SearchLimits limits;
+  long playouts = 20000;
+  limits.multipv = 3;
+  is >> command;
+  if (!(is >> playouts)) {
+    playouts = 20000;
+  } else if (!(is >> limits.multipv)) {
+    limits.multipv = 3;
+  }
+  Board board;
+  if (playouts < 1 || limits.multipv < 1 || !to_board(board)) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  if (!_mcts) {
+    _mcts = std::make_shared<Mcts>();
+  }
+  limits.nodes = (uint64_t) playouts;
+  std::vector<PVLine> lines = _mcts->search(board, limits);
+  if (lines.empty()) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  Prompts::mcts_header(player_turn(), _mcts->playouts(), _mcts->reused(), _mcts->size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string pv;
+    for (size_t j = 0; j < lines[i].pv.size(); j++) {
+      pv += (j ? " " : "") + move_to_string(lines[i].pv[j]);
+    }
+    Prompts::analysis_line(i + 1, format_score(lines[i].score), pv);
+  }
+}
+
+//prints a mating tree, one step per line indented by its depth
+static void print_mate_tree(const MateTree& tree, int depth) {
+  for (size_t i = 0; i < tree.replies.size(); i++) {
+    const MateTree& step = tree.replies[i];
+    if (step.ghost >= 0) {
+      std::string square(1, (char) ('a' + step.ghost % 8));
+      square += (char) ('1' + step.ghost / 8);
+      Prompts::mate_step(depth, "ghost " + square);
+    } else {
+      Prompts::mate_step(depth, move_to_string(step.move));
+    }
+    print_mate_tree(step, depth + 1);
+  }
+}
+
+//solve [moves]
+//proof-number search for a forced mate in at most `moves' moves (default 3)
+void Game::solve_mate(std::string line) const {
+  std::istringstream is(line);
+  std::string command;
+  int max_moves = 3;
+  is >> command;
+  if (!(is >> max_moves)) {
+    max_moves = 3;
+  }
+  Board board;
+  if (max_moves < 1 || !to_board(board)) {
+    Prompts::analysis_unavailable();
+    return;
+  }
+  MateSolver solver;
+  MateTree tree;
+  int moves;
+  SolveResult result = solver.solve(board, max_moves, tree, moves);
+  if (result == SOLVE_MATE) {
+    Prompts::mate_found(player_turn(), moves, solver.nodes());
+    print_mate_tree(tree, 0);
+  } else if (result == SOLVE_NO_MATE) {
+    Prompts::no_mate(player_turn(), moves, solver.nodes());
+  } else {
+    Prompts::mate_unknown(solver.nodes());
+  }
+}
+
+//book
+//lists the opening book's moves for this position and how often each is chosen
+void Game::show_book() const {
+  Board board;
+  std::vector<BookMove> moves;
+  if (to_board(board)) {
+    OpeningBook::shared().moves(board, moves);
+  }
+  if (moves.empty()) {
+    Prompts::not_in_book();
+    return;
+  }
+  int total = 0;
+  for (size_t i = 0; i < moves.size(); i++) {
+    total += moves[i].weight;
+  }
+  Prompts::book_header(player_turn());
+  for (size_t i = 0; i < moves.size(); i++) {
+    Prompts::book_line(move_to_string(moves[i].move), moves[i].weight, 100.0 * moves[i].weight / total);
+  }
+}
+
+//percentages of white wins, draws and black wins among finished games
+void Game::show_games() const {
+  Board board;
+  std::vector<DatabaseMove> moves;
+  if (to_board(board)) {
+    GameDatabase::shared().moves(board, moves);
+  }
+  if (moves.empty()) {
+    Prompts::not_in_database();
+    return;
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < moves.size(); i++) {
+    total += moves[i].games;
+  }
+  Prompts::database_header(total);
+  for (size_t i = 0; i < moves.size(); i++) {
+    const DatabaseMove& m = moves[i];
+    double finished = std::max(1u, m.white + m.draws + m.black);
+    Prompts::database_line(move_to_string(m.move), m.games, 100.0 * m.white / finished,
+                           100.0 * m.draws / finished, 100.0 * m.black / finished);
+  }
+}
+
+//broadcast [name | off]
+//publishes every position from now on to the spectator feed `name'
+//(default "featured"), taking over the feed of an earlier broadcast
+void Game::broadcast(std::string line) {
+  std::istringstream is(line);
+  std::string command, name;
+  is >> command;
+  if (!(is >> name)) {
+    name = "featured";
+  }
+  if (name == "off") {
+    if (_feed) {
+      _feed.reset();
+      Prompts::broadcast_stopped();
+    }
+    return;
+  }
+  std::shared_ptr<SpectatorFeed> feed = std::make_shared<SpectatorFeed>();
+  Board board;
+  if (!to_board(board) || !feed->open(name)) {
+    Prompts::broadcast_failed(name);
+    return;
+  }
+  _feed = feed;
+  publish(status::SUCCESS, NO_MOVE);
+  Prompts::broadcasting(name, spectator_path(name));
+}
+
+void Game::publish(int result, uint16_t move) {
+  Board board;
+  if (_feed && to_board(board)) {
+    _feed->publish(_turn, result, move, board.variant(), board_to_fen(board, _halfmove_clock));
+  }
+}
+
 // Execute the main gameplay loop.
 void Game::run() {
   std::string line;
@@ -202,193 +518,272 @@ bool Game::add_factory(AbstractPieceFactory* piece_gen) {
 
 }
 
+// Create the pieces of a FEN position. FEN only remembers castling
+// rights, so kings and rooks without one are marked as moved.
+void Game::load_fen(const FenPosition& fen) {
+  for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+    uint8_t code = fen.squares[sq];
+    if (code == 0) {
+      continue;
+    }
+    Position pos(square_x(sq), square_y(sq));
+    if (init_piece(code_type(code), code_owner(code), pos)) {
+      get_piece(pos)->set_moved(fen.piece_moved(sq));
+    }
+  }
+  _turn = fen.turn();
+  _halfmove_clock = fen.halfmove;
+}
+
+//clears the board first; moves made so far can no longer be taken back
+int Game::load(const std::string& filename) {
+  SavedGame saved;
+  if (_width != 8 || _height != 8 || read_saved_game(filename, saved) < 0 ||
+      variant_name(saved.variant) != return_game_type() || saved.turn < 1) {
+    return status::LOAD_FAILURE;
+  }
+  for (unsigned int i = 0; i < _width * _height; i++) {
+    delete _pieces[i];
+    _pieces[i] = nullptr;
+  }
+  for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+    if (saved.squares[sq] != 0) {
+      restore_piece(saved.squares[sq], sq);
+    }
+  }
+  _turn = saved.turn;
+  _halfmove_clock = saved.halfmove_clock;
+  _history = saved.history;
+  count_positions();
+  _moves.clear();
+  _redo.clear();
+  loaded(saved);
+  return status::SUCCESS;
+}
+
+int Game::save(const std::string& filename) const {
+  SavedGame saved;
+  return saved_game(saved) ? write_saved_game(filename, saved) : status::SAVE_FAILURE;
+}
+
+int Game::export_text(const std::string& filename) const {
+  SavedGame saved;
+  return saved_game(saved) ? export_saved_game(filename, saved) : status::SAVE_FAILURE;
+}
+
+//only the positions since the last capture or pawn move can repeat
+bool Game::saved_game(SavedGame& saved) const {
+  if (_width != 8 || _height != 8 || !variant_from_name(return_game_type(), saved.variant)) {
+    return false;
+  }
+  saved.turn = _turn;
+  saved.halfmove_clock = _halfmove_clock;
+  saved.rng_seed = rng() ? rng()->seed() : SPOOKY_SEED;
+  saved.rng_counter = rng() ? rng()->counter() : 0;
+  for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+    saved.squares[sq] = _pieces[sq] ? piece_state(_pieces[sq]) : 0;
+  }
+  size_t keep = std::min(_history.size(), (size_t) _halfmove_clock + 1);
+  saved.history.assign(_history.end() - keep, _history.end());
+  return true;
+}
+
+void Game::save_file(bool text) const {
+  Prompts::save_game();
+  std::string filename;
+  std::getline(std::cin, filename);
+  if ((text ? export_text(filename) : save(filename)) < 0) {
+    Prompts::save_failure();
+  }
+}
+
+std::string Game::fen() const {
+  Board board;
+  if (!to_board(board)) {
+    return "";
+  }
+  return board_to_fen(board, _halfmove_clock);
+}
+
 //print green and red board to terminal with pieces setup on it
+//the whole frame, graveyard included, goes out in one write. On a
+//terminal the board stays put on the alternate screen and only what
+//changed since the last call is redrawn.
 void Game::print_board() {
+  if (!_screen_open && isatty(STDOUT_FILENO)) {
+    open_screen();
+    return;
+  }
+  if (_screen_open) {
+    update_screen();
+    return;
+  }
+  _renderer.begin();
+  compose_board();
+  _renderer.flush();
+}
+
+//the board, its coordinates and both graveyards, from the cursor down
+void Game::compose_board() {
   for (unsigned int i = 0; i < _height; i++) {
-    std::cout << " " << _height - i;
+    _renderer.text(' ');
+    _renderer.number(_height - i);
     if ((_height - i) < 10) {
-      std::cout << " ";
+      _renderer.text(' ');
     }
     for (unsigned int j = 0; j < _width; j++) {
-      if ((i + j) % 2 == 0) {
-        Terminal::color_bg(Terminal::Color::GREEN);
-      } else {
-        Terminal::color_bg(Terminal::Color::RED);
-      }
-      std::cout << " ";
-      print_piece(_pieces[index(Position(j, _height - i - 1))]);
-      std::cout << " ";
+      print_square(i, j);
     }
-    Terminal::set_default();
-    std::cout << std::endl;
+    _renderer.set_default();
+    _renderer.newline();
   }
-  Terminal::set_default();
-  std::cout << "   ";
+  _renderer.set_default();
+  _renderer.text("   ");
   for (unsigned int x = 0; x <_width; x++) {
-    std::cout << "  " << (char) (97 + x) << " ";
+    _renderer.text("  ");
+    _renderer.text((char) (97 + x));
+    _renderer.text(' ');
   }
-  std::cout << std::endl;
-  print_graveyard();
+  _renderer.newline();
+  _renderer.text("White Graveyard: ");
+  print_graveyard(Player::WHITE, 0);
+  _renderer.newline();
+  _renderer.text("Black Graveyard: ");
+  print_graveyard(Player::BLACK, 0);
+  _renderer.newline();
 }
-  
 
-//prints graveyard of all captured pieces for the current game
-void Game::print_graveyard() {
-  int white_pawn = 8, black_pawn = 8;
-  int white_rook = 2, black_rook = 2;
-  int white_bishop = 2, black_bishop = 2;
-  int white_queen = 1, black_queen = 1;
-  int white_knight = 2, black_knight = 2;
-  int type;
+//one square, `row' counting from the top of the display
+void Game::print_square(unsigned int row, unsigned int column) {
+  if ((row + column) % 2 == 0) {
+    _renderer.color_bg(Terminal::Color::GREEN);
+  } else {
+    _renderer.color_bg(Terminal::Color::RED);
+  }
+  _renderer.text(' ');
+  print_piece(_pieces[index(Position(column, _height - row - 1))]);
+  _renderer.text(' ');
+}
 
-  //iterates through all the existing pieces still in play and 
-  //subtracts values from the total pieces defined above so 
-  //we know how many pieces have fallen and need to be put in graveyard
+//the board is drawn once, then the lines below it scroll the prompts
+void Game::open_screen() {
+  _screen_open = true;
+  _renderer.begin();
+  _renderer.alternate_screen(true);
+  _renderer.move_to(1, 1);
+  compose_board();
+  _renderer.scroll_region(_height + 4);
+  _renderer.move_to(_height + 4, 1);
+  _renderer.flush();
+  _shown.resize(_pieces.size());
   for (unsigned int i = 0; i < _pieces.size(); i++) {
-    if (_pieces[i] != nullptr && _pieces[i]->owner() == Player::WHITE) {
-      type = _pieces[i]->piece_type();
-      switch (type) {
-      case PieceEnum::PAWN_ENUM:
-        white_pawn--;
-        break;
-      case PieceEnum::ROOK_ENUM:
-        white_rook--;
-        break;
-      case PieceEnum::KNIGHT_ENUM:
-        white_knight--;
-        break;
-      case PieceEnum::BISHOP_ENUM:
-        white_bishop--;
-        break;
-      case PieceEnum::QUEEN_ENUM:
-        white_queen--;
-	      break;
-      }
-    }
-    else if (_pieces[i] != nullptr && _pieces[i]->owner() == Player::BLACK) {
-      type = _pieces[i]->piece_type();
-      switch (type) {
-      case PieceEnum::PAWN_ENUM:
-        black_pawn--;
-        break;
-      case PieceEnum::ROOK_ENUM:
-        black_rook--;
-        break;
-      case PieceEnum::KNIGHT_ENUM:
-        black_knight--;
-        break;
-      case PieceEnum::BISHOP_ENUM:
-        black_bishop--;
-        break;
-      case PieceEnum::QUEEN_ENUM:
-        black_queen--;
-	break;
-      }
-    }
-  }
-  //print white pieces using unicode values of chess pieces
-  std::cout << "White Graveyard: ";
-  Terminal::color_all(0, Terminal::Color::WHITE, Terminal::Color::RED);
-  for (int i = 0; i < white_pawn; i++) {
-    std::cout << "\u2659 ";
+    _shown[i] = _pieces[i] ? piece_state(_pieces[i]) & ~MOVED_BIT : 0;
   }
-  for (int i = 0; i < white_rook; i++) {
-    std::cout << "\u2656 ";
-  }
-  for (int i = 0; i < white_knight; i++) {
-    std::cout << "\u2658 ";
-  }
-  for (int i = 0; i < white_bishop; i++) {
-    std::cout << "\u2657 ";
+  _shown_graveyard[Player::WHITE] = graveyard(Player::WHITE);
+  _shown_graveyard[Player::BLACK] = graveyard(Player::BLACK);
+}
+
+void Game::close_screen() {
+  if (!_screen_open) {
+    return;
   }
-  for (int i = 0; i < white_queen; i++) {
-    std::cout << "\u2655 ";
+  _screen_open = false;
+  _renderer.begin();
+  _renderer.scroll_region(0);
+  _renderer.alternate_screen(false);
+  _renderer.flush();
+}
+
+//a move changes a handful of squares (four when castling), a capture
+//adds one glyph to a graveyard; nothing else is sent
+void Game::update_screen() {
+  _renderer.begin();
+  _renderer.save_cursor();
+  for (unsigned int i = 0; i < _pieces.size(); i++) {
+    uint8_t code = _pieces[i] ? piece_state(_pieces[i]) & ~MOVED_BIT : 0;
+    if (code == _shown[i]) {
+      continue;
+    }
+    _shown[i] = code;
+    unsigned int row = _height - 1 - i / _width, column = i % _width;
+    _renderer.move_to(row + 1, 4 + 4 * column);
+    print_square(row, column);
   }
-  Terminal::set_default();
-    //print Black pieces using unicode values of chess pieces
-  std::cout << std::endl << "Black Graveyard: ";
-  Terminal::color_all(0, Terminal::Color::BLACK, Terminal::Color::GREEN);
-  for (int i = 0; i < black_pawn; i++) {
-    std::cout << "\u265F ";
+  for (int p = Player::WHITE; p <= Player::BLACK; p++) {
+    std::vector<int> fallen = graveyard(static_cast<Player>(p));
+    std::vector<int>& shown = _shown_graveyard[p];
+    size_t same = 0;
+    while (same < fallen.size() && same < shown.size() && fallen[same] == shown[same]) {
+      same++;
+    }
+    if (same == fallen.size() && same == shown.size()) {
+      continue;
+    }
+    //each glyph and its space take two columns after the title
+    _renderer.move_to(_height + 2 + p, 18 + 2 * same);
+    print_graveyard(static_cast<Player>(p), same);
+    _renderer.clear_line();
+    shown = fallen;
   }
-  for (int i = 0; i < black_rook; i++) {
-    std::cout << "\u265C ";
+  _renderer.set_default();
+  _renderer.restore_cursor();
+  _renderer.flush();
+}
+
+
+//piece types captured from a player: pawns, rooks, knights, bishops, queens
+std::vector<int> Game::graveyard(Player play) const {
+  //a full set less whatever is still on the board has fallen
+  int fallen[5] = {8, 2, 2, 2, 1};
+  for (unsigned int i = 0; i < _pieces.size(); i++) {
+    Piece* p = _pieces[i];
+    if (p != nullptr && p->owner() == play && p->piece_type() <= PieceEnum::QUEEN_ENUM) {
+      fallen[p->piece_type()]--;
+    }
   }
-  for (int i = 0; i < black_knight; i++) {
-    std::cout << "\u265E ";
+  const int order[5] = {PieceEnum::PAWN_ENUM, PieceEnum::ROOK_ENUM, PieceEnum::KNIGHT_ENUM,
+                        PieceEnum::BISHOP_ENUM, PieceEnum::QUEEN_ENUM};
+  std::vector<int> types;
+  for (int k = 0; k < 5; k++) {
+    for (int i = 0; i < fallen[order[k]]; i++) {
+      types.push_back(order[k]);
+    }
   }
-  for (int i = 0; i < black_bishop; i++) {
-    std::cout << "\u265D ";
+  return types;
+}
+
+//adds the glyphs of a graveyard from `first' on to the frame
+void Game::print_graveyard(Player play, size_t first) {
+  if (play == Player::WHITE) {
+    _renderer.color_all(0, Terminal::Color::WHITE, Terminal::Color::RED);
+  } else {
+    _renderer.color_all(0, Terminal::Color::BLACK, Terminal::Color::GREEN);
   }
-  for (int i = 0; i < black_queen; i++) {
-    std::cout << "\u265B ";
+  std::vector<int> fallen = graveyard(play);
+  for (size_t i = first; i < fallen.size(); i++) {
+    _renderer.text(piece_glyph(play, fallen[i]));
+    _renderer.text(' ');
   }
-  Terminal::set_default();
-  std::cout << std::endl;
+  _renderer.set_default();
 }
 
 
-//Print piece onto the chessboard using unicode values for chess pieces
-//could be simplified tremendously with dictionaries
+//adds a piece to the frame using unicode values for chess pieces
 void Game::print_piece(Piece* p) {
   if (p == nullptr) {
-    std::cout << "  ";
+    _renderer.text("  ");
     return;
   }
   int type = p->piece_type();
-  //process white pieces
-  if (p->owner() == Player::WHITE) {
-    Terminal::color_fg(0, Terminal::Color::WHITE);
-    switch (type) {
-      case PieceEnum::PAWN_ENUM:
-        std::cout << "\u2659";
-        break;
-      case PieceEnum::ROOK_ENUM:
-        std::cout << "\u2656";
-        break;
-      case PieceEnum::KNIGHT_ENUM:
-        std::cout << "\u2658";
-        break;
-      case PieceEnum::BISHOP_ENUM:
-        std::cout << "\u2657";
-        break;
-      case PieceEnum::QUEEN_ENUM:
-        std::cout << "\u2655";
-        break;
-      case PieceEnum::KING_ENUM:
-        std::cout << "\u2654";
-        break;
-    }
-    std::cout << " ";
-    //print black pieces
-  } else if (p->owner() == Player::BLACK) {
-    Terminal::color_fg(0, Terminal::Color::BLACK);
-    switch (type) {
-      case PieceEnum::PAWN_ENUM:
-        std::cout << "\u265F";
-        break;
-      case PieceEnum::ROOK_ENUM:
-        std::cout << "\u265C";
-        break;
-      case PieceEnum::KNIGHT_ENUM:
-        std::cout << "\u265E";
-        break;
-      case PieceEnum::BISHOP_ENUM:
-        std::cout << "\u265D";
-        break;
-      case PieceEnum::QUEEN_ENUM:
-        std::cout << "\u265B";
-        break;
-      case PieceEnum::KING_ENUM:
-        std::cout << "\u265A";
-        break;
-    }
-    std::cout << " ";
-  } else if (p->owner() == Player::NO_ONE) {
-    if (type == PieceEnum::GHOST_ENUM) {
-      Terminal::color_fg(0, Terminal::Color::BLACK);
-      std::cout << "\u2603 ";
+  if (p->owner() == Player::WHITE || p->owner() == Player::BLACK) {
+    _renderer.color_fg(0, p->owner() == Player::WHITE ? Terminal::Color::WHITE : Terminal::Color::BLACK);
+    if (type <= PieceEnum::KING_ENUM) {
+      _renderer.text(piece_glyph(p->owner(), type));
     }
+    _renderer.text(' ');
+  } else if (type == PieceEnum::GHOST_ENUM) {
+    _renderer.color_fg(0, Terminal::Color::BLACK);
+    _renderer.text("\u2603 ");
   }
 }
 
@@ -425,8 +820,28 @@ int Game::make_move_helper(Position start, Position end) {
     if (status < 0) {
       return status;
     }
+    //captures and pawn moves can't be reversed, so nothing before them repeats
+    bool irreversible = q != nullptr || p->piece_type() == PieceEnum::PAWN_ENUM;
+    if (_history.empty()) {
+      push_position(position_key());
+    }
+    bool castle = p->piece_type() == PieceEnum::KING_ENUM && abs((int) start.x - (int) end.x) == 2;
+    bool promote = p->piece_type() == PieceEnum::PAWN_ENUM &&
+      ((player_turn() == Player::WHITE && end.y == _height - 1) || (player_turn() == Player::BLACK && end.y == 0));
+    if (_moves.empty()) {
+      _first_turn = _turn;
+    }
+    MoveRecord record;
+    record.move = pack_move(index(start), index(end),
+                            (q ? FLAG_CAPTURE : 0) | (castle ? FLAG_CASTLE : 0) | (promote ? FLAG_PROMOTION : 0));
+    record.mover = piece_state(p);
+    record.captured = q ? piece_state(q) : 0;
+    record.halfmove_clock = (uint8_t) std::min(_halfmove_clock, 255);
+    record.history = (uint32_t) _history.size();
+    _moves.push_back(record);
+    _redo.clear();
     //Handle castling movement
-    if (p->piece_type() == PieceEnum::KING_ENUM && abs((int) start.x - (int) end.x) == 2) {
+    if (castle) {
       _pieces[index(end)] = p;
       _pieces[index(start)] = nullptr;
       if (end.x > start.x) {
@@ -444,15 +859,14 @@ int Game::make_move_helper(Position start, Position end) {
       _pieces[index(start)] = nullptr;
     }
     //pawn turns into queen at end of board
-    if (p->piece_type() == PieceEnum::PAWN_ENUM) {
-      if ((player_turn() == Player::WHITE && end.y == _height -1) || (player_turn() == Player::BLACK && end.y == 0)) {
-        delete p;
-        _pieces[index(end)] = nullptr;
-        init_piece(PieceEnum::QUEEN_ENUM, player_turn(), end);
-        p = _pieces[index(end)];
-      }
+    if (promote) {
+      delete p;
+      _pieces[index(end)] = nullptr;
+      init_piece(PieceEnum::QUEEN_ENUM, player_turn(), end);
+      p = _pieces[index(end)];
     }
     p->set_moved(true);
+    _halfmove_clock = irreversible ? 0 : _halfmove_clock + 1;
     if (q != nullptr) {
       Prompts::capture(player_turn());
       delete q;
@@ -461,6 +875,141 @@ int Game::make_move_helper(Position start, Position end) {
     return status::SUCCESS;
 }
 
+//the board is loaded once, for both the key and the material check
+int Game::next_turn(int result) {
+  _turn++;
+  Board board;
+  bool loaded = to_board(board);
+  push_position(loaded ? board.key() : 0);
+  int draw = draw_by_rule(loaded ? &board : nullptr);
+  if (draw == status::MOVE_DRAW_REPETITION) {
+    Prompts::repetition();
+  } else if (draw == status::MOVE_DRAW_FIFTY_MOVES) {
+    Prompts::fifty_moves();
+  } else if (draw == status::MOVE_DRAW_MATERIAL) {
+    Prompts::insufficient_material();
+  }
+  return draw ? draw : result;
+}
+
+int Game::draw_by_rule() const {
+  Board board;
+  return draw_by_rule(to_board(board) ? &board : nullptr);
+}
+
+//the key includes the side to move, so equal keys are real repetitions
+int Game::draw_by_rule(const Board* board) const {
+  if (!_history.empty()) {
+    std::unordered_map<uint64_t, int>::const_iterator seen = _repetitions.find(_history.back());
+    if (seen != _repetitions.end() && seen->second >= 3) {
+      return status::MOVE_DRAW_REPETITION;
+    }
+  }
+  if (_halfmove_clock >= 100) {
+    return status::MOVE_DRAW_FIFTY_MOVES;
+  }
+  if (board && insufficient_material(*board)) {
+    return status::MOVE_DRAW_MATERIAL;
+  }
+  return 0;
+}
+
+bool Game::insufficient_material(const Board& board) const {
+  return board.insufficient_material();
+}
+
+uint64_t Game::position_key() const {
+  Board board;
+  return to_board(board) ? board.key() : 0;
+}
+
+void Game::push_position(uint64_t key) {
+  _history.push_back(key);
+  _repetitions[key]++;
+}
+
+void Game::pop_positions(size_t length) {
+  while (_history.size() > length) {
+    std::unordered_map<uint64_t, int>::iterator seen = _repetitions.find(_history.back());
+    if (--seen->second == 0) {
+      _repetitions.erase(seen);
+    }
+    _history.pop_back();
+  }
+}
+
+void Game::count_positions() {
+  _repetitions.clear();
+  for (uint64_t key : _history) {
+    _repetitions[key]++;
+  }
+}
+
+bool Game::undo_move() {
+  if (_moves.empty()) {
+    return false;
+  }
+  MoveRecord record = _moves.back();
+  _moves.pop_back();
+  take_back(record);
+  _redo.push_back(record.move);
+  return true;
+}
+
+int Game::redo_move() {
+  if (_redo.empty()) {
+    Prompts::nothing_to_redo();
+    return status::MOVE_ERROR_ILLEGAL;
+  }
+  //make_move forgets the moves taken back, all but this one are kept
+  std::vector<uint16_t> later(_redo.begin(), _redo.end() - 1);
+  int from = move_from(_redo.back()), to = move_to(_redo.back());
+  int result = make_move(Position(from % _width, from / _width), Position(to % _width, to / _width));
+  if (result >= 0) {
+    _redo.swap(later);
+  }
+  return result;
+}
+
+void Game::take_back(const MoveRecord& record) {
+  unsigned int from = move_from(record.move), to = move_to(record.move);
+  Piece* p = _pieces[to];
+  _pieces[to] = nullptr;
+  if (move_flags(record.move) & FLAG_PROMOTION) {
+    delete p;
+    restore_piece(record.mover, from);
+  } else {
+    _pieces[from] = p;
+    p->set_moved(record.mover & MOVED_BIT);
+  }
+  //castling needs an unmoved rook
+  if (move_flags(record.move) & FLAG_CASTLE) {
+    unsigned int corner = to > from ? from + 3 : from - 4;
+    unsigned int beside = to > from ? from + 1 : from - 1;
+    _pieces[corner] = _pieces[beside];
+    _pieces[beside] = nullptr;
+    _pieces[corner]->set_moved(false);
+  }
+  if (record.captured) {
+    restore_piece(record.captured, to);
+  }
+  //undo_move has popped the record, so what's left is the moves before it
+  _turn = _first_turn + (int) _moves.size();
+  _halfmove_clock = record.halfmove_clock;
+  pop_positions(record.history);
+}
+
+void Game::restore_piece(uint8_t piece, unsigned int square) {
+  Position pos(square % _width, square / _width);
+  if (init_piece(code_type(piece & ~MOVED_BIT), code_owner(piece & ~MOVED_BIT), pos)) {
+    _pieces[square]->set_moved(piece & MOVED_BIT);
+  }
+}
+
+uint8_t Game::piece_state(Piece* p) {
+  return piece_code(p->piece_type(), p->owner()) | (p->has_moved() ? MOVED_BIT : 0);
+}
+
 
 
 //many different checks to see if move is allowed
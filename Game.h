@@ -1,12 +1,23 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <memory>
 #include "Enumerations.h"
 #include "Piece.h"
 #include "Terminal.h"
+#include "Renderer.h"
+
+class Board;
+struct FenPosition;
+struct SavedGame;
+class Rng;
+class Mcts;
+class SpectatorFeed;
 
 // Game status code enumeration. Note that any value > 0
 // indicates success, and any value < 0 indicates failure.
@@ -30,9 +41,31 @@ enum status {
   MOVE_STALEMATE,
   MOVE_CAPTURE_HILL,
   GAME_WIN,
-  GAME_OVER
+  GAME_OVER,
+  MOVE_DRAW_REPETITION,
+  MOVE_DRAW_FIFTY_MOVES,
+  MOVE_DRAW_MATERIAL
+};
+
+// True for the statuses that end the game in a draw
+inline bool draw_status(int result) {
+  return result == MOVE_STALEMATE || result >= MOVE_DRAW_REPETITION;
+}
+
+
+// Everything a move changed, so that it can be taken back. Pieces are
+// stored as Board piece codes, with MOVED_BIT set if they had moved. The
+// turn isn't stored: it follows from the record's depth on the stack.
+struct MoveRecord {
+    uint32_t history;         // length of the position key stack before the move
+    uint16_t move;            // the move as a Board Move
+    uint8_t mover;            // the moving piece before it moved
+    uint8_t captured;         // piece taken on the end square, 0 if none
+    uint8_t halfmove_clock;   // never past 100 in a game still being played
 };
 
+static const uint8_t MOVED_BIT = 0x80;
+
 
 
 
@@ -46,7 +79,7 @@ class Game {
 public:
     // Construct a board with the specified dimensions
     Game(int t = 1, unsigned int w = 8, unsigned int h = 8, bool pb = 0) :
-        _width(w), _height(h), _pieces(w * h, nullptr), _turn(t), _print_board(pb) {}
+        _width(w), _height(h), _pieces(w * h, nullptr), _turn(t), _first_turn(t), _halfmove_clock(0), _print_board(pb), _screen_open(false) {}
 
     // Virtual destructor is necessary for a class with virtual methods
     virtual ~Game();
@@ -75,6 +108,23 @@ public:
         return _turn;
     }
 
+    // Half moves since the last capture or pawn move
+    int halfmove_clock() const {
+        return _halfmove_clock;
+    }
+
+    // Take back the last move. Returns false if there is none.
+    bool undo_move();
+
+    // Play the last move taken back again, returning the status of
+    // make_move (MOVE_ERROR_ILLEGAL if nothing was taken back). Any other
+    // move forgets the moves taken back.
+    int redo_move();
+
+    // The draw status (MOVE_DRAW_...) the current position is drawn by,
+    // 0 if none of the draw rules apply
+    int draw_by_rule() const;
+
     // Return true if the position is within bounds
     bool valid_position(Position pos) const {
         return pos.x < _width && pos.y < _height;
@@ -96,6 +146,30 @@ public:
     // Reports whether the game is over.
     virtual bool game_over() const = 0;
 
+    // Name of the game variant as written to save files
+    virtual std::string return_game_type() const = 0;
+
+    // Copy the position into `board' for the engine. Returns false if the
+    // game does not fit on an 8x8 board.
+    bool to_board(Board& board) const;
+
+    // FEN of the current position, empty if it doesn't fit on an 8x8 board
+    std::string fen() const;
+
+    // Random number generator driving the game, nullptr if it has none
+    virtual const Rng* rng() const { return nullptr; }
+
+    // Replace the position with a game saved in `filename' (see
+    // SaveFile.h). Returns SUCCESS, or LOAD_FAILURE if it can't be read or
+    // is a game of another variant.
+    int load(const std::string& filename);
+
+    // Save the game in the binary format, SUCCESS or SAVE_FAILURE
+    int save(const std::string& filename) const;
+
+    // Save the game in the text format, SUCCESS or SAVE_FAILURE
+    int export_text(const std::string& filename) const;
+
 protected:
 
     // Board dimensions
@@ -107,9 +181,36 @@ protected:
     // Current game turn sequence number
     int _turn;
 
+    // Turn of the first move on _moves; each later one is a turn on
+    int _first_turn;
+
+    // Half moves since the last capture or pawn move (fifty-move rule)
+    int _halfmove_clock;
+
+    // Keys of the positions since the first move, the current one last.
+    // Only the last `_halfmove_clock' of them can repeat.
+    std::vector<uint64_t> _history;
+
+    // How often each key of _history occurs. Nothing before a capture or
+    // pawn move can come back, so these are the repetition counts.
+    std::unordered_map<uint64_t, int> _repetitions;
+
+    // Moves made, for undo, and moves taken back, for redo
+    std::vector<MoveRecord> _moves;
+    std::vector<uint16_t> _redo;
+
     //flag player can set that will print a graphically board along with the game
     bool _print_board;
 
+    // Frame buffer print_board composes the board and graveyard in
+    Renderer _renderer;
+
+    // Board kept on the alternate screen of a terminal: the piece code
+    // each square shows and the pieces each graveyard shows
+    bool _screen_open;
+    std::vector<uint8_t> _shown;
+    std::vector<int> _shown_graveyard[2];
+
     // All the factories registered with this Board
     PieceGenMap _registered_factories;
 
@@ -124,19 +225,84 @@ protected:
     // Functionality for adding piece factories (called by constructor)
     bool add_factory(AbstractPieceFactory* f);
 
+    // Place the pieces, moved flags and turn of a parsed FEN position
+    // (factories must already be registered)
+    void load_fen(const FenPosition& fen);
+
     void print_board();
 
-    void print_graveyard();
+    void compose_board();
 
-    //save file
-    virtual void save_file() const = 0;
+    void print_square(unsigned int row, unsigned int column);
 
-    virtual std::string return_game_type() const = 0;
+    // Piece types a player has lost, in the order the graveyard shows them
+    std::vector<int> graveyard(Player play) const;
+
+    void print_graveyard(Player play, size_t first);
+
+    // Draw the board on the alternate screen, prompts scrolling below it
+    void open_screen();
+
+    // Back to the normal screen, if the board was on the alternate one
+    void close_screen();
+
+    // Redraw only the squares and graveyard glyphs that changed
+    void update_screen();
+
+    // Prompt for a file name and save, in the binary or the text format
+    void save_file(bool text) const;
+
+    // The position as saved, false if the board isn't 8x8
+    bool saved_game(SavedGame& saved) const;
+
+    // Set what a variant keeps beyond the pieces after a load
+    virtual void loaded(const SavedGame&) {}
 
     bool process_move(std::string line);
 
     int make_move_helper(Position start, Position end);
 
+    // Pass the turn after a move that didn't end the game, recording the
+    // position reached. Returns `result', or the draw status if one of
+    // the draw rules now ends the game.
+    int next_turn(int result);
+
+    // True if neither side has the pieces left to mate: bare kings, or
+    // bishops and knights amounting to a single minor piece or only
+    // bishops on squares of one colour
+    virtual bool insufficient_material(const Board& board) const;
+
+    // The draw status of the current position, `board' when it could be
+    // loaded and null otherwise
+    int draw_by_rule(const Board* board) const;
+
+    // Zobrist key of the current position, 0 if it isn't an 8x8 board
+    uint64_t position_key() const;
+
+    // Push a position key onto _history, or pop keys off it down to
+    // `length', keeping _repetitions in step
+    void push_position(uint64_t key);
+    void pop_positions(size_t length);
+
+    // Recount _repetitions after _history was replaced
+    void count_positions();
+
+    // Restore the position before the move of `record'
+    virtual void take_back(const MoveRecord& record);
+
+    // Create the piece of a MoveRecord piece code on a square
+    void restore_piece(uint8_t piece, unsigned int square);
+
+    // Board piece code of a piece with MOVED_BIT, for MoveRecord
+    static uint8_t piece_state(Piece* p);
+
+    // Show the board or end the game after a move, as process_move does.
+    // Returns false if the game is over.
+    bool after_move(int result);
+
+    // Send the current position to the spectators, if broadcasting
+    void publish(int result, uint16_t move);
+
     int can_make_move(Position start, Position end, Player play) const;
 
     bool player_can_move(Player play) const;
@@ -157,6 +323,26 @@ private:
 
     bool process_input(std::string line);
 
+    void analyze(std::string line) const;
+
+    void estimate_odds(std::string line) const;
+
+    void search_mcts(std::string line);
+
+    void solve_mate(std::string line) const;
+
+    void show_book() const;
+
+    void show_games() const;
+
+    void broadcast(std::string line);
+
+    // Tree search kept between mcts commands so each reuses the last tree
+    std::shared_ptr<Mcts> _mcts;
+
+    // Spectator feed the positions are published to, null when not broadcasting
+    std::shared_ptr<SpectatorFeed> _feed;
+
 };
 
 
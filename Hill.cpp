@@ -0,0 +1,28 @@
+#include <algorithm>
+#include <vector>
+
+#include "Hill.h"
+
+
+HillTable::HillTable(unsigned int width, unsigned int height) : _distance(width * height) {
+    unsigned int x_low = (width - 1) / 2, x_high = width / 2;
+    unsigned int y_low = (height - 1) / 2, y_high = height / 2;
+    for (unsigned int y = y_low; y <= y_high; y++) {
+        for (unsigned int x = x_low; x <= x_high; x++) {
+            _squares.push_back(y * width + x);
+        }
+    }
+    //a king covers the larger of the file and rank gaps, one step each
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            int dx = x < x_low ? x_low - x : (x > x_high ? x - x_high : 0);
+            int dy = y < y_low ? y_low - y : (y > y_high ? y - y_high : 0);
+            _distance[y * width + x] = std::max(dx, dy);
+        }
+    }
+}
+
+const HillTable& HillTable::standard() {
+    static const HillTable table(8, 8);
+    return table;
+}
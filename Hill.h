@@ -0,0 +1,38 @@
+#ifndef HILL_H
+#define HILL_H
+
+#include <vector>
+
+/*
+The hill of King of the Hill chess: the central squares of a board of any
+size (two files and two ranks on even boards, one on odd ones) and, for
+every square, how many king steps it is from the nearest of them. Built
+once per board size so hill checks are table lookups.
+*/
+
+class HillTable {
+
+public:
+
+    // Creates the table for a `width' x `height' board
+    HillTable(unsigned int width = 8, unsigned int height = 8);
+
+    // The table of the 8x8 board, shared by every user
+    static const HillTable& standard();
+
+    // King steps from square index (y * width + x) to the nearest hill square
+    int distance(unsigned int index) const { return _distance[index]; }
+
+    bool on_hill(unsigned int index) const { return _distance[index] == 0; }
+
+    // Indexes of the hill squares
+    const std::vector<unsigned int>& squares() const { return _squares; }
+
+private:
+
+    std::vector<int> _distance;
+    std::vector<unsigned int> _squares;
+
+};
+
+#endif // HILL_H
@@ -0,0 +1,381 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Journal.h"
+
+namespace {
+
+const size_t RECORD_SIZE = 8;
+
+// Journal files are closed and folded into the checkpoint at this size
+const size_t ROTATE_BYTES = 8 << 20;
+
+const char CHECKPOINT_MAGIC[4] = {'T', 'C', 'C', 'K'};
+
+uint8_t record_check(const uint8_t* bytes) {
+    uint8_t check = 0x5A;
+    for (size_t i = 0; i < RECORD_SIZE - 1; i++) {
+        check = (uint8_t) (((check << 1) | (check >> 7)) ^ bytes[i]);
+    }
+    return check;
+}
+
+//little-endian, like the snapshots
+void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += (char) (value >> (8 * i));
+    }
+}
+
+uint64_t get_le(const std::string& in, size_t& at, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t) (uint8_t) in[at + i] << (8 * i);
+    }
+    at += bytes;
+    return value;
+}
+
+uint32_t fnv1a(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+//false if the file exists but can't be read
+bool read_file(const std::string& path, std::string& contents, bool& exists) {
+    contents.clear();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    exists = fd >= 0;
+    if (!exists) {
+        return errno == ENOENT;
+    }
+    char buffer[65536];
+    for (;;) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            close(fd);
+            return length == 0;
+        }
+        contents.append(buffer, (size_t) length);
+    }
+}
+
+bool sync_directory(const std::string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+std::string encode_record(const JournalRecord& record) {
+    std::string bytes;
+    put_le(bytes, record.game, 4);
+    put_le(bytes, record.value, 2);
+    bytes += (char) record.kind;
+    bytes += (char) record_check((const uint8_t*) bytes.data());
+    return bytes;
+}
+
+//stops at the first record that is torn or damaged
+void decode_records(const std::string& bytes, std::vector<JournalRecord>& records) {
+    for (size_t at = 0; at + RECORD_SIZE <= bytes.size(); at += RECORD_SIZE) {
+        const uint8_t* raw = (const uint8_t*) bytes.data() + at;
+        if (raw[RECORD_SIZE - 1] != record_check(raw) || raw[6] < JOURNAL_NEW || raw[6] > JOURNAL_CLOSE) {
+            return;
+        }
+        size_t field = at;
+        JournalRecord record;
+        record.game = (uint32_t) get_le(bytes, field, 4);
+        record.value = (uint16_t) get_le(bytes, field, 2);
+        record.kind = raw[6];
+        records.push_back(record);
+    }
+}
+
+std::string encode_checkpoint(uint32_t generation, const Checkpoint& checkpoint) {
+    std::string bytes(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put_le(bytes, generation, 4);
+    put_le(bytes, checkpoint.created, 4);
+    put_le(bytes, checkpoint.games.size(), 4);
+    for (size_t i = 0; i < checkpoint.games.size(); i++) {
+        const CheckpointGame& game = checkpoint.games[i];
+        put_le(bytes, game.id, 4);
+        bytes.append((const char*) game.snapshot.bytes, SNAPSHOT_SIZE);
+        put_le(bytes, game.history.size(), 2);
+        for (size_t k = 0; k < game.history.size(); k++) {
+            put_le(bytes, game.history[k], 8);
+        }
+    }
+    put_le(bytes, fnv1a(bytes.data(), bytes.size()), 4);
+    return bytes;
+}
+
+//false if the checkpoint is damaged
+bool decode_checkpoint(const std::string& bytes, uint32_t& generation, Checkpoint& checkpoint) {
+    const size_t header = sizeof(CHECKPOINT_MAGIC) + 12;
+    if (bytes.size() < header + 4 || std::memcmp(bytes.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        return false;
+    }
+    size_t end = bytes.size() - 4;
+    size_t at = end;
+    if (get_le(bytes, at, 4) != fnv1a(bytes.data(), end)) {
+        return false;
+    }
+    at = sizeof(CHECKPOINT_MAGIC);
+    generation = (uint32_t) get_le(bytes, at, 4);
+    checkpoint.created = (uint32_t) get_le(bytes, at, 4);
+    size_t count = (size_t) get_le(bytes, at, 4);
+    checkpoint.games.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (end - at < 4 + SNAPSHOT_SIZE + 2) {
+            return false;
+        }
+        CheckpointGame game;
+        game.id = (uint32_t) get_le(bytes, at, 4);
+        std::memcpy(game.snapshot.bytes, bytes.data() + at, SNAPSHOT_SIZE);
+        at += SNAPSHOT_SIZE;
+        size_t keys = (size_t) get_le(bytes, at, 2);
+        if (end - at < keys * 8) {
+            return false;
+        }
+        for (size_t k = 0; k < keys; k++) {
+            game.history.push_back(get_le(bytes, at, 8));
+        }
+        checkpoint.games.push_back(std::move(game));
+    }
+    return at == end;
+}
+
+}
+
+MoveJournal::MoveJournal() : _open(false), _fd(-1), _generation(0), _written(0), _failed(false), _stopping(false),
+                             _closed(0), _checkpointed(0) {}
+
+MoveJournal::~MoveJournal() {
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    _rotated.notify_all();
+    if (_writer.joinable()) {
+        _writer.join();
+    }
+    if (_compactor.joinable()) {
+        _compactor.join();
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+std::string MoveJournal::file(uint32_t generation) const {
+    return _directory + "/journal-" + std::to_string(generation);
+}
+
+bool MoveJournal::open(const std::string& directory, Replay replay, Checkpoint& recovered) {
+    if (_open || (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)) {
+        return false;
+    }
+    _directory = directory;
+    _replay = replay;
+    std::string contents;
+    bool exists;
+    uint32_t first = 0;
+    Checkpoint checkpoint;
+    if (!read_file(_directory + "/checkpoint", contents, exists) ||
+        (exists && !decode_checkpoint(contents, first, checkpoint))) {
+        return false;
+    }
+    //every file from the checkpoint's generation on holds records to replay
+    uint32_t generation = first;
+    while (access(file(generation).c_str(), F_OK) == 0) {
+        generation++;
+    }
+    //files a crash left behind after the last checkpoint was written
+    for (uint32_t stale = first; stale-- > 0 && unlink(file(stale).c_str()) == 0; ) {}
+    if (!compact(generation, &recovered)) {
+        return false;
+    }
+    _fd = ::open(file(generation).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd >= 0 && !sync_directory(_directory)) {
+        close(_fd);
+        _fd = -1;
+    }
+    if (_fd < 0) {
+        return false;
+    }
+    _generation = generation;
+    _written = 0;
+    _closed = _checkpointed = generation;
+    _open = true;
+    _writer = std::thread(&MoveJournal::write_loop, this);
+    _compactor = std::thread(&MoveJournal::compact_loop, this);
+    return true;
+}
+
+void MoveJournal::append(const JournalRecord& record, Callback committed) {
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (record.kind != 0) {
+            _buffer += encode_record(record);
+        }
+        _waiting.push_back(std::move(committed));
+    }
+    _wake.notify_one();
+}
+
+bool MoveJournal::failed() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _failed;
+}
+
+//whatever was appended during the last write goes out with the next one
+void MoveJournal::write_loop() {
+    std::string bytes;
+    std::vector<Callback> committed;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _wake.wait(lock, [this] { return _stopping || !_waiting.empty(); });
+        if (_waiting.empty()) {
+            return;
+        }
+        bytes.clear();
+        bytes.swap(_buffer);
+        committed.clear();
+        committed.swap(_waiting);
+        bool failed = _failed;
+        int error = 0;
+        lock.unlock();
+        bool durable = !failed;
+        if (!failed && !bytes.empty()) {
+            durable = write_all(_fd, bytes.data(), bytes.size()) && fdatasync(_fd) == 0;
+            failed = !durable;
+            _written += bytes.size();
+            //the records are synced, only the ones after them are lost
+            if (!failed && _written >= ROTATE_BYTES) {
+                failed = !rotate();
+            }
+            error = errno;
+        }
+        for (size_t i = 0; i < committed.size(); i++) {
+            committed[i](durable);
+        }
+        lock.lock();
+        if (failed && !_failed) {
+            _failed = true;
+            std::fprintf(stderr, "Journal in %s failed: %s\n", _directory.c_str(), std::strerror(error));
+        }
+    }
+}
+
+bool MoveJournal::rotate() {
+    int fd = ::open(file(_generation + 1).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0 || !sync_directory(_directory)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    close(_fd);
+    _fd = fd;
+    _generation++;
+    _written = 0;
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _closed = _generation;
+    }
+    _rotated.notify_one();
+    return true;
+}
+
+void MoveJournal::compact_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _rotated.wait(lock, [this] { return _stopping || _closed > _checkpointed; });
+        if (_stopping) {
+            return;
+        }
+        uint32_t closed = _closed;
+        lock.unlock();
+        //files stay until a checkpoint holds them, so a failure loses nothing
+        bool ok = compact(closed, nullptr);
+        lock.lock();
+        if (ok) {
+            _checkpointed = closed;
+        } else {
+            //try again once another file is closed
+            std::fprintf(stderr, "Could not checkpoint the journal in %s\n", _directory.c_str());
+            _rotated.wait(lock, [this, closed] { return _stopping || _closed > closed; });
+        }
+    }
+}
+
+bool MoveJournal::compact(uint32_t generation, Checkpoint* recovered) {
+    std::string contents;
+    bool exists;
+    uint32_t first = 0;
+    Checkpoint checkpoint;
+    checkpoint.created = 0;
+    if (!read_file(_directory + "/checkpoint", contents, exists) ||
+        (exists && !decode_checkpoint(contents, first, checkpoint))) {
+        return false;
+    }
+    std::vector<JournalRecord> records;
+    for (uint32_t g = first; g < generation; g++) {
+        if (!read_file(file(g), contents, exists)) {
+            return false;
+        }
+        decode_records(contents, records);
+    }
+    _replay(checkpoint, records);
+    //written aside and renamed over the old one, so it is always whole
+    std::string path = _directory + "/checkpoint";
+    std::string temporary = path + ".tmp";
+    std::string bytes = encode_checkpoint(generation, checkpoint);
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_all(fd, bytes.data(), bytes.size()) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0 || !sync_directory(_directory)) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    for (uint32_t g = first; g < generation; g++) {
+        unlink(file(g).c_str());
+    }
+    if (recovered != nullptr) {
+        *recovered = std::move(checkpoint);
+    }
+    return true;
+}
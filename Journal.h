@@ -0,0 +1,128 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Snapshot.h"
+
+/*
+Append-only journal of the games a server hosts, kept in a directory:
+
+    checkpoint    every open game as a Snapshot, and the generation of
+                  the first journal file it doesn't include
+    journal-<n>   8-byte records since: a game created, a move, a game closed
+
+Records are appended to one file for all games and written by a thread of
+their own, which syncs whatever has been appended while it was busy with
+the previous write in one go (group commit), so a thousand games moving
+at once cost one fdatasync() rather than a thousand. Whoever appends is
+called back once the record is on disk, or told it never got there.
+
+A journal file is closed once it holds ROTATE_BYTES, and a second thread
+folds closed files into a new checkpoint and deletes them, replaying their
+records with the rules the server supplies. Opening the directory again
+after a crash does the same for everything there, so a torn last record
+is all that can be lost, and its move was never confirmed.
+*/
+
+enum JournalKind {
+    JOURNAL_NEW = 1,        // value is the variant
+    JOURNAL_MOVE = 2,       // value is the move
+    JOURNAL_CLOSE = 3
+};
+
+struct JournalRecord {
+    uint32_t game;
+    uint16_t value;
+    uint8_t kind;           // a JournalKind, 0 for no record
+};
+
+struct CheckpointGame {
+    uint32_t id;
+    Snapshot snapshot;
+    std::vector<uint64_t> history;      // keys before the current position
+};
+
+struct Checkpoint {
+    uint32_t created;                   // games ever created, the last id
+    std::vector<CheckpointGame> games;  // open games in id order
+};
+
+
+class MoveJournal {
+
+public:
+
+    // Called with true once the record is on disk, false if the journal
+    // has failed and it never will be
+    typedef std::function<void(bool)> Callback;
+
+    // Apply records to a checkpoint
+    typedef std::function<void(Checkpoint&, const std::vector<JournalRecord>&)> Replay;
+
+    MoveJournal();
+
+    // Writes what was appended, then stops
+    ~MoveJournal();
+
+    // Recover the games in `directory' (created if missing) into
+    // `recovered', checkpoint them and start appending. False on errors.
+    bool open(const std::string& directory, Replay replay, Checkpoint& recovered);
+
+    bool is_open() const { return _open; }
+
+    // Append a record, or just wait for those before it when its kind is
+    // 0, and call `committed' from the writer thread once it is on disk.
+    // Callbacks run in the order of their records. Thread safe.
+    void append(const JournalRecord& record, Callback committed);
+
+    // True once a write has failed; records are no longer durable then
+    bool failed();
+
+private:
+
+    std::string _directory;
+    Replay _replay;
+    bool _open;
+    int _fd;                        // journal file being appended to
+    uint32_t _generation;           // its number
+    size_t _written;                // bytes in it
+
+    std::mutex _mutex;              // guards everything below
+    std::condition_variable _wake;  // records appended, or stopping
+    std::string _buffer;            // records not written yet
+    std::vector<Callback> _waiting; // their callbacks
+    bool _failed;
+    bool _stopping;
+
+    std::condition_variable _rotated;   // a file was closed, or stopping
+    uint32_t _closed;               // files before this one are closed
+    uint32_t _checkpointed;         // and these are in the checkpoint
+
+    std::thread _writer;
+    std::thread _compactor;
+
+    void write_loop();
+
+    void compact_loop();
+
+    // Close the journal file and start the next one
+    bool rotate();
+
+    std::string file(uint32_t generation) const;
+
+    // Fold the journal files from the checkpoint's generation up to
+    // `generation' into a new checkpoint and delete them
+    bool compact(uint32_t generation, Checkpoint* recovered);
+
+    MoveJournal(const MoveJournal&) = delete;
+    MoveJournal& operator=(const MoveJournal&) = delete;
+
+};
+
+#endif // JOURNAL_H
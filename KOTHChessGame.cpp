@@ -1,17 +1,17 @@
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <string>
 
 #include "Game.h"
 #include "KOTHChessGame.h"
 #include "Prompts.h"
 #include "Piece.h"
+#include "Fen.h"
 
 
 // Set up the chess board with standard initial pieces
-KOTHChessGame::KOTHChessGame(): Game() {
+KOTHChessGame::KOTHChessGame(): Game(), _hill(_width, _height) {
     initialize_factories();
     std::vector<int> pieces {
         ROOK_ENUM, KNIGHT_ENUM, BISHOP_ENUM, QUEEN_ENUM,
@@ -26,63 +26,12 @@ KOTHChessGame::KOTHChessGame(): Game() {
 }
 
 
-// Set up the chess board with game state loaded from file
-KOTHChessGame::KOTHChessGame(const std::string filename) : Game() {
-
+// Set up the chess board in a position given as FEN
+KOTHChessGame::KOTHChessGame(const FenPosition& fen) : Game(), _hill(_width, _height) {
     initialize_factories();
-
-    std::ifstream input_file;
-    input_file.open(filename);
-    if (!input_file.is_open()) {
-      Prompts::load_failure();
-      exit(1);
-    }
-    std::string temp;
-    input_file >> temp;
-    if (temp != "king") {
-      Prompts::load_failure();
-      input_file.close();
-      exit(1);
-    }
-    int turn = 0;
-    input_file >> turn;
-    _turn = turn + 1;
-    int player, piece_type;
-    std::string coordinate;
-    while (input_file >> player) {
-      input_file >> coordinate;
-      input_file >> piece_type;
-      int x = (int) coordinate[0] - 97;
-      int y = coordinate[1] - 49;
-      init_piece(static_cast<PieceEnum>(piece_type), static_cast<Player>(player), Position(x, y));
-    }
-    input_file.close();
+    load_fen(fen);
 }
 
-void KOTHChessGame::save_file() const {
-  Prompts::save_game();
-  std::string filename;
-  std::getline(std::cin, filename);
-  std::ofstream output_file;
-  output_file.open(filename);
-  if (output_file.is_open()) {
-    output_file << return_game_type() << "\n";
-    output_file << turn() - 1  << "\n";
-    for (unsigned int x = 0; x < _height; x++) {
-      for (unsigned int y = 0; y < _width; y++) {
-        Piece * p = _pieces[index(Position(y, x))];
-        if (p != nullptr) {
-          output_file << p->owner() << " ";
-          output_file << (char) (y + 97) << x + 1 << " ";
-          output_file << p->piece_type() << "\n";
-        }
-      }
-    }
-    output_file.close();
-  } else {
-    Prompts::save_failure();
-  }
-}
 
 // Perform a move from the start Position to the end Position
 // The method returns an integer with the status
@@ -109,30 +58,25 @@ int KOTHChessGame::make_move(Position start, Position end) {
   }
   if (checked(opponent, _pieces)) {
     Prompts::check(player_turn());
-    _turn++;
-    return status::MOVE_CHECK;
+    return next_turn(status::MOVE_CHECK);
   }
-  _turn++;
-  return result;
+  return next_turn(result);
 }
 
 // Report whether the chess game is over
 bool KOTHChessGame::game_over() const {
   Player opponent = static_cast<Player>(1 - player_turn());
-  return !player_can_move(opponent) || conquered_hill(player_turn());;
+  return !player_can_move(opponent) || conquered_hill(player_turn()) || draw_by_rule() != 0;
 }
 
 //special game ending condition if player gets king into the middle of the board
+//only the hill squares themselves need looking at
 bool KOTHChessGame::conquered_hill(Player play) const{
-  for (unsigned int i = 0; i < _width * _height; i++) {
-    if (_pieces[i] != nullptr && _pieces[i]->piece_type() == KING_ENUM && _pieces[i]->owner() == play) {
-      unsigned int x = i % _width;
-      unsigned int y = i / _width;
-      if ((x == 3 || x == 4) && (y == 3 || y == 4)) {
-        return true;
-      } else {
-        return false;
-      }
+  const std::vector<unsigned int>& hill = _hill.squares();
+  for (size_t i = 0; i < hill.size(); i++) {
+    Piece* p = _pieces[hill[i]];
+    if (p != nullptr && p->piece_type() == KING_ENUM && p->owner() == play) {
+      return true;
     }
   }
   return false;
@@ -4,6 +4,7 @@
 #include <string>
 #include "Game.h"
 #include "ChessPiece.h"
+#include "Hill.h"
 
 /*
 Chess game with alternate win condition of moving king into the middle of the hill
@@ -16,8 +17,8 @@ public:
     // Creates new game in standard start-of-game state
     KOTHChessGame();
 
-    // Creates game with state indicated in specified file
-    KOTHChessGame(std::string filename);
+    // Creates game in the position described by a parsed FEN
+    KOTHChessGame(const FenPosition& fen);
 
     // Perform a move from the start Position to the end Position
     // The method returns an integer with the status
@@ -33,15 +34,18 @@ protected:
     // used in chess (doesn't make the actual pieces)
     virtual void initialize_factories();
 
-    virtual void save_file() const;
-
     virtual std::string return_game_type() const override { return "king";}
 
+    // Never: a bare king can still walk onto the hill
+    virtual bool insufficient_material(const Board&) const override { return false; }
+
 //private methods
 private:
 
     bool conquered_hill(Player play) const;
 
+    HillTable _hill;
+
 };
 
 #endif // CHESS_GAME_H
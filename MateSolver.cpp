@@ -0,0 +1,326 @@
+#include <algorithm>
+
+#include "MateSolver.h"
+#include "Piece.h"
+
+namespace {
+
+// Proof and disproof numbers saturate here
+const uint32_t INFINITE_PN = 100000000;
+
+// PENDING nodes share the table with the position they were made from
+const uint64_t PENDING_KEY = 0x9E4D1B6A5C3F2E17ULL;
+
+uint32_t add(uint32_t a, uint32_t b) {
+    return std::min(INFINITE_PN, a + b);
+}
+
+}
+
+
+MateSolver::MateSolver(size_t hash_mb) : _attacker(WHITE), _nodes(0), _node_limit(0), _stop(false) {
+    size_t entries = 1;
+    while (entries * 2 * sizeof(Entry) <= std::max(hash_mb, (size_t) 1) << 20) {
+        entries *= 2;
+    }
+    _table.resize(entries);
+    clear();
+}
+
+void MateSolver::clear() {
+    Entry empty = {0, 1, 1, -1};
+    std::fill(_table.begin(), _table.end(), empty);
+}
+
+SolveResult MateSolver::solve(const Board& root, int max_moves, MateTree& tree, int& moves) {
+    _stop = false;
+    _nodes = 0;
+    _attacker = root.side();
+    tree = MateTree();
+    Board b = root;
+    uint64_t key = node_key(b, MOVED);
+    for (moves = 1; moves <= max_moves; moves++) {
+        int remaining = 2 * moves - 1;
+        _path.clear();
+        mid(b, MOVED, remaining, INFINITE_PN, INFINITE_PN);
+        uint32_t pn, dn;
+        lookup(key, remaining, pn, dn);
+        if (pn == 0) {
+            _path.clear();
+            return build(b, MOVED, remaining, tree) ? SOLVE_MATE : SOLVE_UNKNOWN;
+        }
+        if (dn != 0 || out_of_budget()) {
+            return SOLVE_UNKNOWN;
+        }
+    }
+    moves = max_moves;
+    return SOLVE_NO_MATE;
+}
+
+uint64_t MateSolver::node_key(const Board& b, NodeKind kind) {
+    return kind == PENDING ? b.key() ^ PENDING_KEY : b.key();
+}
+
+//a proof with fewer plies left holds with more, a disproof with more holds with fewer
+void MateSolver::lookup(uint64_t key, int remaining, uint32_t& pn, uint32_t& dn) const {
+    const Entry& e = _table[key & (_table.size() - 1)];
+    pn = dn = 1;
+    if (e.key != key) {
+        return;
+    }
+    if (e.pn == 0 && e.remaining <= remaining) {
+        pn = 0;
+        dn = INFINITE_PN;
+    } else if (e.dn == 0 && e.remaining >= remaining) {
+        pn = INFINITE_PN;
+        dn = 0;
+    } else if (e.remaining == remaining) {
+        pn = e.pn;
+        dn = e.dn;
+    }
+}
+
+void MateSolver::store(uint64_t key, int remaining, uint32_t pn, uint32_t dn) {
+    Entry& e = _table[key & (_table.size() - 1)];
+    //keep a finished result that still answers for `remaining' plies
+    if (e.key == key && pn != 0 && dn != 0 &&
+        ((e.pn == 0 && e.remaining <= remaining) || (e.dn == 0 && e.remaining >= remaining))) {
+        return;
+    }
+    e.key = key;
+    e.pn = pn;
+    e.dn = dn;
+    e.remaining = remaining;
+}
+
+//the checks of ChessGame, KOTHChessGame and SpookyChessGame::make_move
+bool MateSolver::terminal(const Board& b, NodeKind kind, int remaining, uint32_t& pn, uint32_t& dn) const {
+    Player side = b.side();
+    Player mover = static_cast<Player>(1 - side);
+    bool over = true;
+    Player winner = NO_ONE;
+    if (kind == LANDED) {
+        bool side_check = b.in_check(side), mover_check = b.in_check(mover);
+        bool side_moves = b.has_legal_move(), mover_moves = b.can_move(mover);
+        if (side_check && !side_moves) {
+            winner = mover;
+        } else if (mover_check && !mover_moves) {
+            winner = side;
+        } else if (!side_moves || !mover_moves) {
+            winner = NO_ONE;
+        } else if (mover_check && !side_check) {
+            winner = side;
+        } else {
+            over = false;
+        }
+    } else if (b.variant() == VARIANT_KOTH && b.on_hill(mover)) {
+        winner = mover;
+    } else if (!b.has_legal_move()) {
+        winner = b.in_check(side) ? mover : NO_ONE;
+    } else {
+        over = false;
+    }
+    if (!over && remaining > 0) {
+        return false;
+    }
+    bool proven = over && winner == _attacker;
+    pn = proven ? 0 : INFINITE_PN;
+    dn = proven ? INFINITE_PN : 0;
+    return true;
+}
+
+void MateSolver::children(Board& b, NodeKind kind, std::vector<Child>& list) const {
+    list.clear();
+    Child c;
+    c.pn = c.dn = 1;
+    if (kind == PENDING) {
+        //the ghost lands on any square but a king's, where it stands included
+        c.move = NO_MOVE;
+        for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+            uint8_t code = b.at(sq);
+            if (code != 0 && code != GHOST_CODE && code_type(code) == KING_ENUM) continue;
+            c.ghost = sq;
+            list.push_back(c);
+        }
+    } else {
+        MoveList moves;
+        b.generate_moves(moves);
+        c.ghost = -1;
+        for (int i = 0; i < moves.size; i++) {
+            c.move = moves.moves[i];
+            list.push_back(c);
+        }
+    }
+    NodeKind child_kind = kind == PENDING ? LANDED : (b.ghost_square() >= 0 ? PENDING : MOVED);
+    int ghost = b.ghost_square();
+    for (size_t i = 0; i < list.size(); i++) {
+        Undo undo;
+        enter(b, kind, list[i], undo);
+        list[i].key = node_key(b, child_kind);
+        leave(b, kind, list[i], undo, ghost);
+    }
+}
+
+void MateSolver::enter(Board& b, NodeKind kind, const Child& c, Undo& undo) const {
+    if (kind == PENDING) {
+        b.jump_ghost(c.ghost, undo);
+    } else {
+        b.make(c.move, undo);
+    }
+}
+
+void MateSolver::leave(Board& b, NodeKind kind, const Child& c, const Undo& undo, int ghost) const {
+    if (kind == PENDING) {
+        b.unjump_ghost(ghost, undo);
+    } else {
+        b.unmake(c.move, undo);
+    }
+}
+
+//multiple iterative deepening: stay below this node until its numbers
+//reach one of the thresholds
+void MateSolver::mid(Board& b, NodeKind kind, int remaining, uint32_t th_pn, uint32_t th_dn) {
+    _nodes++;
+    uint64_t key = node_key(b, kind);
+    uint32_t pn, dn;
+    if (terminal(b, kind, remaining, pn, dn)) {
+        store(key, remaining, pn, dn);
+        return;
+    }
+    bool or_node = kind != PENDING && b.side() == _attacker;
+    NodeKind child_kind = kind == PENDING ? LANDED : (b.ghost_square() >= 0 ? PENDING : MOVED);
+    int child_remaining = kind == PENDING ? remaining : remaining - 1;
+    int ghost = b.ghost_square();
+    std::vector<Child> list;
+    children(b, kind, list);
+    //children already decided by their own position are settled up front
+    for (size_t i = 0; i < list.size(); i++) {
+        Undo undo;
+        enter(b, kind, list[i], undo);
+        uint32_t cpn, cdn;
+        if (terminal(b, child_kind, child_remaining, cpn, cdn)) {
+            store(list[i].key, child_remaining, cpn, cdn);
+        }
+        leave(b, kind, list[i], undo, ghost);
+    }
+    _path.push_back(key);
+    while (true) {
+        pn = or_node ? INFINITE_PN : 0;
+        dn = or_node ? 0 : INFINITE_PN;
+        size_t best = 0;
+        uint32_t second = INFINITE_PN;
+        for (size_t i = 0; i < list.size(); i++) {
+            Child& c = list[i];
+            //repeating a position never forces a win
+            if (std::find(_path.begin(), _path.end(), c.key) != _path.end()) {
+                c.pn = INFINITE_PN;
+                c.dn = 0;
+            } else {
+                lookup(c.key, child_remaining, c.pn, c.dn);
+            }
+            uint32_t value = or_node ? c.pn : c.dn;
+            uint32_t best_value = or_node ? list[best].pn : list[best].dn;
+            if (i == 0 || value < best_value) {
+                if (i != 0) {
+                    second = best_value;
+                }
+                best = i;
+            } else if (value < second) {
+                second = value;
+            }
+            if (or_node) {
+                pn = std::min(pn, c.pn);
+                dn = add(dn, c.dn);
+            } else {
+                pn = add(pn, c.pn);
+                dn = std::min(dn, c.dn);
+            }
+        }
+        if (pn >= th_pn || dn >= th_dn || out_of_budget()) {
+            break;
+        }
+        //the 1 + 1/4 trick keeps the search from bouncing between two children
+        Child& c = list[best];
+        uint32_t child_pn, child_dn;
+        if (or_node) {
+            child_pn = std::min(th_pn, add(second, second / 4 + 1));
+            child_dn = add(th_dn - dn, c.dn);
+        } else {
+            child_pn = add(th_pn - pn, c.pn);
+            child_dn = std::min(th_dn, add(second, second / 4 + 1));
+        }
+        Undo undo;
+        enter(b, kind, c, undo);
+        mid(b, child_kind, child_remaining, child_pn, child_dn);
+        leave(b, kind, c, undo, ghost);
+    }
+    _path.pop_back();
+    store(key, remaining, pn, dn);
+}
+
+bool MateSolver::out_of_budget() const {
+    return _stop || (_node_limit && _nodes >= _node_limit);
+}
+
+bool MateSolver::build(Board& b, NodeKind kind, int remaining, MateTree& tree) {
+    uint64_t key = node_key(b, kind);
+    uint32_t pn, dn;
+    if (terminal(b, kind, remaining, pn, dn)) {
+        return pn == 0;
+    }
+    lookup(key, remaining, pn, dn);
+    if (pn != 0) {
+        //the proof was overwritten in the table, prove it again
+        mid(b, kind, remaining, INFINITE_PN, INFINITE_PN);
+        lookup(key, remaining, pn, dn);
+        if (pn != 0) {
+            return false;
+        }
+    }
+    bool or_node = kind != PENDING && b.side() == _attacker;
+    NodeKind child_kind = kind == PENDING ? LANDED : (b.ghost_square() >= 0 ? PENDING : MOVED);
+    int child_remaining = kind == PENDING ? remaining : remaining - 1;
+    int ghost = b.ghost_square();
+    std::vector<Child> list;
+    children(b, kind, list);
+    //attacker: the proven move that was proven with the fewest plies
+    if (or_node) {
+        int chosen = -1, fewest = remaining;
+        for (size_t i = 0; i < list.size(); i++) {
+            const Entry& e = _table[list[i].key & (_table.size() - 1)];
+            if (e.key == list[i].key && e.pn == 0 && e.remaining <= child_remaining && e.remaining < fewest) {
+                chosen = (int) i;
+                fewest = e.remaining;
+            }
+        }
+        for (size_t i = 0; chosen < 0 && i < list.size(); i++) {
+            Undo undo;
+            enter(b, kind, list[i], undo);
+            mid(b, child_kind, child_remaining, INFINITE_PN, INFINITE_PN);
+            leave(b, kind, list[i], undo, ghost);
+            lookup(list[i].key, child_remaining, pn, dn);
+            if (pn == 0) {
+                chosen = (int) i;
+            }
+        }
+        if (chosen < 0) {
+            return false;
+        }
+        list[0] = list[chosen];
+        list.resize(1);
+    }
+    _path.push_back(key);
+    bool proven = true;
+    for (size_t i = 0; proven && i < list.size(); i++) {
+        MateTree child;
+        child.move = list[i].move;
+        child.ghost = list[i].ghost;
+        Undo undo;
+        enter(b, kind, list[i], undo);
+        proven = build(b, child_kind, child_remaining, child);
+        leave(b, kind, list[i], undo, ghost);
+        tree.replies.push_back(child);
+    }
+    _path.pop_back();
+    return proven;
+}
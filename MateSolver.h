@@ -0,0 +1,121 @@
+#ifndef MATE_SOLVER_H
+#define MATE_SOLVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "Board.h"
+
+/*
+Depth-first proof-number (df-pn) search for forced wins: proves or
+disproves that the side to move can force mate within N of its moves.
+In King of the Hill a king reaching the hill ends the game just like mate.
+
+Positions are judged as the games judge them after a move: the player who
+cannot move is mated if in check and stalemated otherwise. In Spooky Chess
+the ghost jump after each move is one more AND node, so a proof holds
+wherever the ghost lands.
+
+Proof and disproof numbers are cached in the solver's own transposition
+table, keyed by position and the plies left, and the proof is read back
+from it as a mating tree.
+*/
+
+// What MateSolver::solve established
+enum SolveResult {
+    SOLVE_MATE,       // a forced win was proven
+    SOLVE_NO_MATE,    // no forced win within the move limit
+    SOLVE_UNKNOWN     // the node limit ran out first
+};
+
+// A proof: the attacker's move, or a ghost landing square, followed by
+// every defence (one move per attacker node, all replies per defender node)
+struct MateTree {
+    Move move;
+    int ghost;      // landing square when this step is a ghost jump, -1 otherwise
+    std::vector<MateTree> replies;
+
+    MateTree() : move(NO_MOVE), ghost(-1) {}
+};
+
+
+class MateSolver {
+
+public:
+
+    // Creates a solver with a table of `hash_mb' megabytes
+    MateSolver(size_t hash_mb = 16);
+
+    // Look for the shortest forced win of the side to move, trying one,
+    // two, ... up to `max_moves' moves. On SOLVE_MATE `moves' is the mate
+    // length and `tree' the mating tree.
+    SolveResult solve(const Board& root, int max_moves, MateTree& tree, int& moves);
+
+    // Give up after this many nodes per solve (0 for no limit)
+    void set_node_limit(uint64_t nodes) { _node_limit = nodes; }
+
+    // Ask a running solve to return SOLVE_UNKNOWN (thread safe)
+    void stop() { _stop = true; }
+
+    // Nodes expanded by the last solve
+    uint64_t nodes() const { return _nodes; }
+
+    // Forget every stored proof
+    void clear();
+
+private:
+
+    enum NodeKind {
+        MOVED,      // a move was just made (or the root)
+        PENDING,    // Spooky Chess: a move was made and the ghost is about to jump
+        LANDED      // Spooky Chess: the ghost just landed
+    };
+
+    // One child of a node: a move, or a square the ghost can land on
+    struct Child {
+        Move move;
+        int ghost;
+        uint64_t key;
+        uint32_t pn, dn;
+    };
+
+    struct Entry {
+        uint64_t key;
+        uint32_t pn, dn;
+        int32_t remaining;
+    };
+
+    std::vector<Entry> _table;
+    Player _attacker;
+    uint64_t _nodes;
+    uint64_t _node_limit;
+    std::atomic<bool> _stop;
+    std::vector<uint64_t> _path;
+
+    // Key of a node, PENDING nodes kept apart from the position itself
+    static uint64_t node_key(const Board& b, NodeKind kind);
+
+    void lookup(uint64_t key, int remaining, uint32_t& pn, uint32_t& dn) const;
+
+    void store(uint64_t key, int remaining, uint32_t pn, uint32_t dn);
+
+    // Proof numbers of a finished game or a node out of plies, false if the
+    // node still has to be searched
+    bool terminal(const Board& b, NodeKind kind, int remaining, uint32_t& pn, uint32_t& dn) const;
+
+    void children(Board& b, NodeKind kind, std::vector<Child>& list) const;
+
+    void enter(Board& b, NodeKind kind, const Child& c, Undo& undo) const;
+
+    void leave(Board& b, NodeKind kind, const Child& c, const Undo& undo, int ghost) const;
+
+    void mid(Board& b, NodeKind kind, int remaining, uint32_t th_pn, uint32_t th_dn);
+
+    bool out_of_budget() const;
+
+    // Read the proof below a proven node back out of the table
+    bool build(Board& b, NodeKind kind, int remaining, MateTree& tree);
+
+};
+
+#endif // MATE_SOLVER_H
@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "Mcts.h"
+#include "WinEstimator.h"
+
+namespace {
+
+// Node scores count a win as this much, a draw as half
+const int64_t VALUE_SCALE = 1000;
+
+// Visits a thread pretends to have lost on every node of its path
+const int32_t VIRTUAL_LOSS = 3;
+
+// UCT exploration constant
+const double EXPLORATION = 0.7;
+
+// Light moves played from a new leaf before it is evaluated
+const int ROLLOUT_PLIES = 2;
+
+// Deepest path a descent follows
+const int MAX_DEPTH = 128;
+
+// Centipawns at which the evaluation counts as a 3:1 favourite
+const double EVAL_SCALE = 200;
+
+// Playouts per search when the limits give neither playouts nor time
+const uint64_t DEFAULT_PLAYOUTS = 10000;
+
+double white_value(Player winner) {
+    return winner == NO_ONE ? 0.5 : (winner == WHITE ? 1 : 0);
+}
+
+//win rate to centipawns, the inverse of the evaluation scale in rollout()
+int win_rate_score(double q) {
+    q = std::min(0.999, std::max(0.001, q));
+    return (int) (EVAL_SCALE * std::log10(q / (1 - q)) / std::log10(3.0));
+}
+
+}
+
+
+void Mcts::Node::reset(Move m) {
+    visits = 0;
+    virtual_loss = 0;
+    score = 0;
+    state = LEAF;
+    first_child = 0;
+    child_count = 0;
+    move = m;
+}
+
+
+Mcts::Mcts(uint32_t capacity) : _capacity(std::max(capacity, 1u)), _current(0), _used(0),
+    _has_tree(false), _threads(1), _stop(false), _playouts(0), _reused(0), _budget(0), _movetime(0) {
+    _arena[0].reset(new Node[_capacity]);
+    _arena[1].reset(new Node[_capacity]);
+    set_threads(0);
+}
+
+void Mcts::set_threads(int threads) {
+    if (threads <= 0) {
+        threads = std::max(1, (int) std::thread::hardware_concurrency());
+    }
+    _threads = threads;
+}
+
+void Mcts::clear() {
+    _has_tree = false;
+    _used = 0;
+}
+
+std::vector<PVLine> Mcts::search(const Board& root, const SearchLimits& limits) {
+    _start = std::chrono::steady_clock::now();
+    _stop = false;
+    _playouts = 0;
+    _reused = 0;
+    if (!_has_tree || !reuse(root)) {
+        _used = 1;
+        nodes()[0].reset(NO_MOVE);
+    }
+    _reused = nodes()[0].visits;
+    _root = root;
+    _has_tree = true;
+    _movetime = limits.movetime;
+    _budget = limits.nodes;
+    if (_budget == 0 && _movetime == 0) {
+        _budget = DEFAULT_PLAYOUTS;
+    }
+
+    std::vector<std::thread> helpers;
+    for (int id = 1; id < _threads; id++) {
+        helpers.push_back(std::thread(&Mcts::work, this, id, std::cref(root)));
+    }
+    work(0, root);
+    for (size_t i = 0; i < helpers.size(); i++) {
+        helpers[i].join();
+    }
+    if (_budget && _playouts > _budget) {
+        _playouts = _budget;
+    }
+
+    std::vector<PVLine> lines;
+    const Node& top = nodes()[0];
+    if (top.state != EXPANDED) {
+        return lines;
+    }
+    std::vector<uint32_t> children;
+    for (uint32_t i = 0; i < top.child_count; i++) {
+        children.push_back(top.first_child + i);
+    }
+    std::stable_sort(children.begin(), children.end(), [this](uint32_t a, uint32_t b) {
+        return nodes()[a].visits > nodes()[b].visits;
+    });
+    size_t count = std::min(children.size(), (size_t) std::max(1, limits.multipv));
+    for (size_t i = 0; i < count; i++) {
+        const Node& n = nodes()[children[i]];
+        PVLine line;
+        line.pv = principal_variation(children[i]);
+        line.depth = (int) line.pv.size();
+        if (n.visits > 0) {
+            line.score = win_rate_score((double) n.score / VALUE_SCALE / n.visits);
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool Mcts::reuse(const Board& root) {
+    if (root.variant() != _root.variant()) {
+        return false;
+    }
+    const Node& top = nodes()[0];
+    if (top.state != EXPANDED) {
+        return false;
+    }
+    //the ghost may have jumped since, so only the pieces have to match
+    MoveList legal;
+    for (uint32_t i = 0; i < top.child_count; i++) {
+        uint32_t c = top.first_child + i;
+        Board after = _root;
+        Undo undo;
+        after.make(nodes()[c].move, undo);
+        if (after.side() == root.side() && after.placement_key() == root.placement_key()) {
+            reroot(c);
+            return true;
+        }
+        const Node& child = nodes()[c];
+        if (child.state != EXPANDED) {
+            continue;
+        }
+        legal.size = 0;
+        after.generate_moves(legal);
+        for (uint32_t j = 0; j < child.child_count; j++) {
+            uint32_t g = child.first_child + j;
+            if (!legal.contains(nodes()[g].move)) continue;
+            Board reply = after;
+            reply.make(nodes()[g].move, undo);
+            if (reply.side() == root.side() && reply.placement_key() == root.placement_key()) {
+                reroot(g);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//breadth first, so every block of children stays contiguous
+void Mcts::reroot(uint32_t from) {
+    Node* src = nodes();
+    Node* dst = _arena[1 - _current].get();
+    std::vector<std::pair<uint32_t, uint32_t> > queue(1, std::make_pair(from, 0u));
+    uint32_t used = 1;
+    dst[0].reset(NO_MOVE);
+    dst[0].visits = src[from].visits.load();
+    dst[0].score = src[from].score.load();
+    for (size_t q = 0; q < queue.size(); q++) {
+        const Node& s = src[queue[q].first];
+        Node& d = dst[queue[q].second];
+        if (s.state != EXPANDED) continue;
+        d.state = EXPANDED;
+        d.first_child = used;
+        d.child_count = s.child_count;
+        for (uint32_t i = 0; i < s.child_count; i++) {
+            const Node& sc = src[s.first_child + i];
+            Node& dc = dst[used + i];
+            dc.reset(sc.move);
+            dc.visits = sc.visits.load();
+            dc.score = sc.score.load();
+            queue.push_back(std::make_pair(s.first_child + i, used + i));
+        }
+        used += s.child_count;
+    }
+    _current = 1 - _current;
+    _used = used;
+}
+
+void Mcts::work(int id, const Board& root) {
+    Rng rng(Rng(root.key()).at(id));
+    for (uint64_t k = 0; !_stop; k++) {
+        if (_budget && _playouts.fetch_add(1) >= _budget) {
+            break;
+        }
+        if (_movetime && (k & 63) == 0) {
+            int elapsed = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - _start).count();
+            if (elapsed >= _movetime) {
+                _stop = true;
+                break;
+            }
+        }
+        if (!_budget) {
+            _playouts++;
+        }
+        descend(root, rng);
+    }
+}
+
+void Mcts::descend(const Board& root, Rng& rng) {
+    Board b = root;
+    uint32_t path[MAX_DEPTH];
+    Player movers[MAX_DEPTH];
+    int length = 0;
+    double value = -1;
+    Node* arena = nodes();
+    uint32_t node = 0;
+    arena[0].virtual_loss += VIRTUAL_LOSS;
+    path[length++] = 0;
+    while (length < MAX_DEPTH) {
+        Node& n = arena[node];
+        //a leaf gets children once it has been scored
+        if (n.state.load(std::memory_order_acquire) != EXPANDED && (n.visits == 0 || !expand(n, b))) {
+            break;
+        }
+        int child = select(n, b);
+        if (child < 0) {
+            break;
+        }
+        Node& c = arena[child];
+        c.virtual_loss += VIRTUAL_LOSS;
+        movers[length] = b.side();
+        path[length++] = child;
+        node = child;
+        Player winner;
+        if (b.play(c.move, rng, winner)) {
+            value = white_value(winner);
+            break;
+        }
+    }
+    if (value < 0) {
+        value = rollout(b, rng);
+    }
+    arena[0].visits++;
+    arena[0].virtual_loss -= VIRTUAL_LOSS;
+    for (int i = 1; i < length; i++) {
+        Node& n = arena[path[i]];
+        double v = movers[i] == WHITE ? value : 1 - value;
+        n.score += (int64_t) (v * VALUE_SCALE + 0.5);
+        n.visits++;
+        n.virtual_loss -= VIRTUAL_LOSS;
+    }
+}
+
+bool Mcts::expand(Node& n, const Board& b) {
+    uint8_t expected = LEAF;
+    if (!n.state.compare_exchange_strong(expected, EXPANDING)) {
+        return false;
+    }
+    MoveList list;
+    b.generate_moves(list);
+    //claim the children's slots without ever counting past the capacity,
+    //so a full arena stays full however many playouts follow
+    uint32_t first = _used.load();
+    while (list.size != 0 && (uint64_t) first + list.size <= _capacity &&
+           !_used.compare_exchange_weak(first, first + list.size)) {
+    }
+    if (list.size == 0 || (uint64_t) first + list.size > _capacity) {
+        //out of room: the tree stops growing but playouts go on
+        n.state.store(LEAF, std::memory_order_release);
+        return false;
+    }
+    Node* arena = nodes();
+    for (int i = 0; i < list.size; i++) {
+        arena[first + i].reset(list.moves[i]);
+    }
+    n.first_child = first;
+    n.child_count = (uint16_t) list.size;
+    n.state.store(EXPANDED, std::memory_order_release);
+    return true;
+}
+
+int Mcts::select(const Node& n, const Board& b) const {
+    //in Spooky Chess the ghost may block moves that were legal at expansion
+    MoveList legal;
+    bool filter = b.ghost_square() >= 0;
+    if (filter) {
+        b.generate_moves(legal);
+    }
+    const Node* arena = nodes();
+    int32_t parent = n.visits + n.virtual_loss;
+    double log_parent = std::log((double) std::max(parent, 1));
+    int best = -1;
+    double best_uct = -1;
+    for (uint32_t i = 0; i < n.child_count; i++) {
+        uint32_t c = n.first_child + i;
+        const Node& child = arena[c];
+        if (filter && !legal.contains(child.move)) continue;
+        int32_t visits = child.visits + child.virtual_loss;
+        if (visits == 0) {
+            return (int) c;
+        }
+        //virtual losses add visits but no score
+        double uct = (double) child.score / VALUE_SCALE / visits
+            + EXPLORATION * std::sqrt(log_parent / visits);
+        if (uct > best_uct) {
+            best = (int) c;
+            best_uct = uct;
+        }
+    }
+    return best;
+}
+
+double Mcts::rollout(Board& b, Rng& rng) const {
+    for (int ply = 0; ply < ROLLOUT_PLIES; ply++) {
+        MoveList list;
+        b.generate_moves(list);
+        if (list.size == 0) {
+            return white_value(b.in_check(b.side()) ? static_cast<Player>(1 - b.side()) : NO_ONE);
+        }
+        Player winner;
+        if (b.play(WinEstimator::pick(b, list, rng), rng, winner)) {
+            return white_value(winner);
+        }
+    }
+    int eval = Engine::evaluate(b);
+    if (b.side() == BLACK) {
+        eval = -eval;
+    }
+    return 1 / (1 + std::pow(3.0, -eval / EVAL_SCALE));
+}
+
+std::vector<Move> Mcts::principal_variation(uint32_t child) const {
+    const Node* arena = nodes();
+    std::vector<Move> pv(1, arena[child].move);
+    uint32_t node = child;
+    while (arena[node].state == EXPANDED && pv.size() < (size_t) MAX_PLY) {
+        const Node& n = arena[node];
+        int best = -1;
+        int32_t best_visits = 0;
+        for (uint32_t i = 0; i < n.child_count; i++) {
+            if (arena[n.first_child + i].visits > best_visits) {
+                best = (int) (n.first_child + i);
+                best_visits = arena[n.first_child + i].visits;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        node = (uint32_t) best;
+        pv.push_back(arena[node].move);
+    }
+    return pv;
+}
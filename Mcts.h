@@ -0,0 +1,118 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Board.h"
+#include "Engine.h"
+#include "Rng.h"
+
+/*
+Monte Carlo Tree Search over a Board, an alternative to the alpha-beta
+Engine. Threads descend one shared tree with UCT, each adding a virtual
+loss to the nodes on its path so the others spread out, then score the new
+leaf with a short light playout and back the result up.
+
+Nodes live in a preallocated arena and the children of a node are one
+contiguous block of it, so the tree never allocates while searching. The
+tree is open loop: a node stands for a sequence of moves, not a position.
+Every descent replays the moves with Board::play, which draws a fresh
+ghost jump in Spooky Chess, so the statistics average over the ghost and
+children that the current draw makes illegal are skipped.
+
+After a search the tree is kept. The next search looks for its root among
+the positions one and two moves below the old root and carries that
+subtree over into the spare arena.
+*/
+
+class Mcts {
+
+public:
+
+    // Creates a searcher with room for `capacity' tree nodes
+    Mcts(uint32_t capacity = 1 << 20);
+
+    // Search the position and return the best `limits.multipv' root moves,
+    // most visited first. `limits.nodes' counts playouts (10000 if zero),
+    // the depth limit is ignored.
+    std::vector<PVLine> search(const Board& root, const SearchLimits& limits);
+
+    // Ask a running search to return as soon as possible (thread safe)
+    void stop() { _stop = true; }
+
+    // Number of threads descending the tree together
+    void set_threads(int threads);
+
+    int threads() const { return _threads; }
+
+    // Drop the tree, so the next search starts from scratch
+    void clear();
+
+    // Playouts made by the last search
+    uint64_t playouts() const { return _playouts; }
+
+    // Nodes in the tree, including those carried over
+    uint32_t size() const { return _used; }
+
+    // Playouts that the last search carried over from the previous tree
+    uint64_t reused() const { return _reused; }
+
+private:
+
+    enum NodeState { LEAF, EXPANDING, EXPANDED };
+
+    struct Node {
+        std::atomic<int32_t> visits;
+        std::atomic<int32_t> virtual_loss;
+        std::atomic<int64_t> score;   // VALUE_SCALE per win of the player who made `move'
+        std::atomic<uint8_t> state;
+        uint32_t first_child;
+        uint16_t child_count;
+        Move move;
+
+        void reset(Move m);
+    };
+
+    uint32_t _capacity;
+    std::unique_ptr<Node[]> _arena[2];
+    int _current;
+    std::atomic<uint32_t> _used;
+    Board _root;
+    bool _has_tree;
+    int _threads;
+    std::atomic<bool> _stop;
+    std::atomic<uint64_t> _playouts;
+    uint64_t _reused;
+    uint64_t _budget;
+    int _movetime;
+    std::chrono::steady_clock::time_point _start;
+
+    Node* nodes() const { return _arena[_current].get(); }
+
+    // Keep the subtree whose moves lead from the old root to `root',
+    // returning false if there is none
+    bool reuse(const Board& root);
+
+    // Copy the subtree below `from' into the spare arena and make it the tree
+    void reroot(uint32_t from);
+
+    void work(int id, const Board& root);
+
+    void descend(const Board& root, Rng& rng);
+
+    bool expand(Node& n, const Board& b);
+
+    // Most promising child of `n' that is legal in `b', -1 if none is
+    int select(const Node& n, const Board& b) const;
+
+    // Value of the position for white after a short playout
+    double rollout(Board& b, Rng& rng) const;
+
+    std::vector<Move> principal_variation(uint32_t child) const;
+
+};
+
+#endif // MCTS_H
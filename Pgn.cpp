@@ -0,0 +1,400 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Pgn.h"
+#include "Board.h"
+#include "Fen.h"
+#include "Game.h"
+#include "ChessGame.h"
+#include "KOTHChessGame.h"
+#include "Prompts.h"
+
+namespace {
+
+// SAN letter of each PieceEnum
+const char PIECE_LETTERS[] = "PRNBQK";
+
+int letter_type(char c) {
+    const char* p = std::strchr(PIECE_LETTERS, c);
+    return c != '\0' && p != nullptr ? (int) (p - PIECE_LETTERS) : -1;
+}
+
+bool is_result(const char* token) {
+    return !std::strcmp(token, "1-0") || !std::strcmp(token, "0-1") ||
+        !std::strcmp(token, "1/2-1/2") || !std::strcmp(token, "*");
+}
+
+//a tag value in quotes, with its quotes and backslashes escaped
+std::string quote_tag(const std::string& value) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"' || value[i] == '\\') {
+            quoted += '\\';
+        }
+        quoted += value[i];
+    }
+    return quoted + '"';
+}
+
+Move find_castle(const Board& b, bool king_side) {
+    MoveList list;
+    b.generate_moves(list);
+    for (int i = 0; i < list.size; i++) {
+        Move m = list.moves[i];
+        if ((move_flags(m) & FLAG_CASTLE) && (move_to(m) > move_from(m)) == king_side) {
+            return m;
+        }
+    }
+    return NO_MOVE;
+}
+
+}
+
+
+Move parse_san(const Board& b, const char* san) {
+    if (!std::strncmp(san, "O-O-O", 5) || !std::strncmp(san, "0-0-0", 5)) {
+        return find_castle(b, false);
+    }
+    if (!std::strncmp(san, "O-O", 3) || !std::strncmp(san, "0-0", 3)) {
+        return find_castle(b, true);
+    }
+    int piece = PAWN_ENUM;
+    if (letter_type(*san) > PAWN_ENUM) {
+        piece = letter_type(*san);
+        san++;
+    }
+    //keep squares and the promotion letter, drop capture and annotation marks
+    char s[8];
+    int n = 0;
+    for (; *san && n < 7; san++) {
+        if (std::strchr("x+#!?=:", *san) == nullptr) {
+            s[n++] = *san;
+        }
+    }
+    char promotion = 0;
+    if (n > 0 && letter_type(s[n - 1]) > PAWN_ENUM) {
+        promotion = s[--n];
+    }
+    if (n < 2 || s[n - 2] < 'a' || s[n - 2] > 'h' || s[n - 1] < '1' || s[n - 1] > '8') {
+        return NO_MOVE;
+    }
+    //pawns only ever promote to a queen under these rules
+    if (promotion && (promotion != 'Q' || piece != PAWN_ENUM)) {
+        return NO_MOVE;
+    }
+    int to = make_square(s[n - 2] - 'a', s[n - 1] - '1');
+    int from_x = -1, from_y = -1;
+    for (int i = 0; i < n - 2; i++) {
+        if (s[i] >= 'a' && s[i] <= 'h') {
+            from_x = s[i] - 'a';
+        } else if (s[i] >= '1' && s[i] <= '8') {
+            from_y = s[i] - '1';
+        } else {
+            return NO_MOVE;
+        }
+    }
+    MoveList list;
+    b.generate_moves_to(to, list);
+    Move found = NO_MOVE;
+    for (int i = 0; i < list.size; i++) {
+        Move m = list.moves[i];
+        int from = move_from(m);
+        if (move_to(m) != to || code_type(b.at(from)) != piece || (move_flags(m) & FLAG_CASTLE)) continue;
+        if (from_x >= 0 && square_x(from) != from_x) continue;
+        if (from_y >= 0 && square_y(from) != from_y) continue;
+        if (found != NO_MOVE) {
+            return NO_MOVE;
+        }
+        found = m;
+    }
+    return found;
+}
+
+std::string move_to_san(const Board& b, Move m) {
+    int from = move_from(m), to = move_to(m), flags = move_flags(m);
+    int piece = code_type(b.at(from));
+    std::string san;
+    if (flags & FLAG_CASTLE) {
+        san = to > from ? "O-O" : "O-O-O";
+    } else {
+        if (piece == PAWN_ENUM) {
+            if (flags & FLAG_CAPTURE) {
+                san += (char) ('a' + square_x(from));
+            }
+        } else {
+            san += PIECE_LETTERS[piece];
+            //name the file, rank or both when another piece could go there too
+            MoveList list;
+            b.generate_moves_to(to, list);
+            bool clash = false, same_file = false, same_rank = false;
+            for (int i = 0; i < list.size; i++) {
+                int other = move_from(list.moves[i]);
+                if (move_to(list.moves[i]) != to || other == from || code_type(b.at(other)) != piece) continue;
+                clash = true;
+                same_file |= square_x(other) == square_x(from);
+                same_rank |= square_y(other) == square_y(from);
+            }
+            if (clash && (!same_file || same_rank)) {
+                san += (char) ('a' + square_x(from));
+            }
+            if (clash && same_file) {
+                san += (char) ('1' + square_y(from));
+            }
+        }
+        if (flags & FLAG_CAPTURE) {
+            san += 'x';
+        }
+        san += (char) ('a' + square_x(to));
+        san += (char) ('1' + square_y(to));
+        if (flags & FLAG_PROMOTION) {
+            san += "=Q";
+        }
+    }
+    Board after = b;
+    Undo undo;
+    after.make(m, undo);
+    if (after.in_check(after.side())) {
+        san += after.has_legal_move() ? '+' : '#';
+    }
+    return san;
+}
+
+
+void PgnGame::clear() {
+    _tags.clear();
+    _text.clear();
+    _offsets.clear();
+    _result.clear();
+}
+
+std::string PgnGame::tag(const std::string& name) const {
+    for (size_t i = 0; i < _tags.size(); i++) {
+        if (_tags[i].first == name) return _tags[i].second;
+    }
+    return "";
+}
+
+void PgnGame::add_tag(const std::string& name, const std::string& value) {
+    _tags.push_back(Tag(name, value));
+}
+
+void PgnGame::add_san(const char* san, size_t length) {
+    _offsets.push_back((uint32_t) _text.size());
+    _text.insert(_text.end(), san, san + length);
+    _text.push_back('\0');
+}
+
+
+int PgnReader::peek() {
+    if (_pos == _length) {
+        _in.read(_buffer, BUFFER_SIZE);
+        _length = (size_t) _in.gcount();
+        _pos = 0;
+        if (_length == 0) {
+            return EOF;
+        }
+    }
+    return (unsigned char) _buffer[_pos];
+}
+
+int PgnReader::get() {
+    int c = peek();
+    if (c != EOF) {
+        _pos++;
+    }
+    return c;
+}
+
+void PgnReader::skip_until(char end) {
+    int c;
+    while ((c = get()) != EOF && c != end) {
+    }
+}
+
+//[Name "Value"]
+bool PgnReader::read_tag(PgnGame& game) {
+    get();
+    std::string name, value;
+    int c;
+    while ((c = get()) != EOF && !std::isspace(c) && c != ']') {
+        name += (char) c;
+    }
+    while (c != EOF && c != '"' && c != ']') {
+        c = get();
+    }
+    if (c == '"') {
+        while ((c = get()) != EOF && c != '"') {
+            if (c == '\\') {
+                c = get();
+            }
+            value += (char) c;
+        }
+        skip_until(']');
+    }
+    game.add_tag(name, value);
+    return c != EOF;
+}
+
+//reads up to the next space or delimiter, returns the token length
+size_t PgnReader::read_token(char* token, size_t capacity) {
+    size_t n = 0;
+    int c;
+    while ((c = peek()) != EOF && !std::isspace(c) && std::strchr("{}()[];$", c) == nullptr) {
+        if (n + 1 < capacity) {
+            token[n++] = (char) c;
+        }
+        get();
+    }
+    token[n] = '\0';
+    return n;
+}
+
+bool PgnReader::next_game(PgnGame& game) {
+    game.clear();
+    bool found = false;
+    char token[64];
+    int c;
+    while ((c = peek()) != EOF) {
+        if (std::isspace(c)) {
+            get();
+        } else if (c == '[') {
+            //a tag after movetext starts the next game
+            if (game.size() > 0) break;
+            read_tag(game);
+            found = true;
+        } else if (c == '{') {
+            skip_until('}');
+        } else if (c == ';' || c == '%') {
+            skip_until('\n');
+        } else if (c == '(') {
+            //variations are skipped, nested ones included
+            int depth = 0;
+            while ((c = get()) != EOF) {
+                if (c == '(') depth++;
+                else if (c == '{') skip_until('}');
+                else if (c == ')' && --depth == 0) break;
+            }
+        } else if (c == '$' || c == ')' || c == ']' || c == '}') {
+            get();
+            read_token(token, sizeof(token));
+        } else {
+            size_t n = read_token(token, sizeof(token));
+            found = true;
+            if (is_result(token)) {
+                game.set_result(token);
+                break;
+            }
+            //drop a move number ("12." or "12...") glued to the move
+            size_t start = 0;
+            while (start < n && std::isdigit((unsigned char) token[start])) start++;
+            if (start < n && token[start] == '.') {
+                while (start < n && token[start] == '.') start++;
+            } else {
+                start = 0;
+            }
+            if (start < n) {
+                game.add_san(token + start, n - start);
+            }
+        }
+    }
+    return found;
+}
+
+
+bool replay_pgn(const PgnGame& game, Board& start, std::vector<Move>& moves, bool through_game) {
+    Variant variant = game.tag("Variant") == "King of the Hill" ? VARIANT_KOTH : VARIANT_CHESS;
+    std::string text = game.tag("FEN");
+    bool set_up = !text.empty() && game.tag("SetUp") != "0";
+    FenPosition fen;
+    moves.clear();
+    if (set_up && !parse_fen(text.c_str(), variant, fen)) {
+        return false;
+    }
+    if (set_up) {
+        fen_to_board(fen, variant, start);
+    } else {
+        start = Board::start_position(variant);
+    }
+    Board b = start;
+    Game* g = nullptr;
+    if (through_game && set_up) {
+        g = variant == VARIANT_KOTH ? static_cast<Game*>(new KOTHChessGame(fen)) : new ChessGame(fen);
+    } else if (through_game) {
+        g = variant == VARIANT_KOTH ? static_cast<Game*>(new KOTHChessGame()) : new ChessGame();
+    }
+    QuietPrompts quiet;
+    bool ok = true;
+    for (size_t i = 0; i < game.size() && ok; i++) {
+        Move m = parse_san(b, game.san(i));
+        if (m == NO_MOVE) {
+            ok = false;
+        } else if (g != nullptr) {
+            int from = move_from(m), to = move_to(m);
+            int result = g->make_move(Position(square_x(from), square_y(from)), Position(square_x(to), square_y(to)));
+            ok = result >= 0;
+        }
+        if (ok) {
+            Undo undo;
+            b.make(m, undo);
+            moves.push_back(m);
+        }
+    }
+    delete g;
+    return ok;
+}
+
+void write_pgn(std::ostream& os, const std::vector<PgnGame::Tag>& tags,
+               const Board& start, const std::vector<Move>& moves, const std::string& result) {
+    const char* roster[7] = {"Event", "Site", "Date", "Round", "White", "Black", "Result"};
+    const char* defaults[7] = {"?", "?", "????.??.??", "?", "?", "?", "*"};
+    for (int r = 0; r < 7; r++) {
+        std::string value = r == 6 ? result : defaults[r];
+        for (size_t i = 0; i < tags.size() && r < 6; i++) {
+            if (tags[i].first == roster[r]) value = tags[i].second;
+        }
+        os << '[' << roster[r] << ' ' << quote_tag(value) << "]\n";
+    }
+    for (size_t i = 0; i < tags.size(); i++) {
+        bool in_roster = false;
+        for (int r = 0; r < 7; r++) {
+            in_roster |= tags[i].first == roster[r];
+        }
+        if (!in_roster) {
+            os << '[' << tags[i].first << ' ' << quote_tag(tags[i].second) << "]\n";
+        }
+    }
+    os << '\n';
+    Board b = start;
+    size_t column = 0;
+    int move_number = (b.turn() + 1) / 2;
+    for (size_t i = 0; i <= moves.size(); i++) {
+        std::string word;
+        if (i == moves.size()) {
+            word = result;
+        } else {
+            if (b.side() == WHITE) {
+                word = std::to_string(move_number) + ". ";
+            } else if (i == 0) {
+                word = std::to_string(move_number) + "... ";
+            }
+            word += move_to_san(b, moves[i]);
+            Undo undo;
+            b.make(moves[i], undo);
+            if (b.side() == WHITE) move_number++;
+        }
+        if (column > 0 && column + 1 + word.size() > 80) {
+            os << '\n';
+            column = 0;
+        } else if (column > 0) {
+            os << ' ';
+            column++;
+        }
+        os << word;
+        column += word.size();
+    }
+    os << "\n\n";
+}
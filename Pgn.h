@@ -0,0 +1,109 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Board.h"
+
+/*
+Portable Game Notation support: a streaming reader that only ever holds one
+game in memory, standard algebraic notation (SAN) resolved against the
+legal move generator, and a writer for finished games.
+*/
+
+// Find the legal move written in SAN ("Nbd7", "exd8=Q+", "O-O-O"),
+// NO_MOVE if it is malformed, ambiguous or illegal
+Move parse_san(const Board& b, const char* san);
+
+// SAN for a legal move, including check and mate suffixes
+std::string move_to_san(const Board& b, Move m);
+
+
+// One game as read from a PGN file. The buffers are reused from game to
+// game, so reading a whole archive allocates only for the longest game.
+class PgnGame {
+
+public:
+
+    typedef std::pair<std::string, std::string> Tag;
+
+    // Forget the previous game but keep the buffers
+    void clear();
+
+    // Value of a tag, empty if the game doesn't have it
+    std::string tag(const std::string& name) const;
+
+    const std::vector<Tag>& tags() const { return _tags; }
+
+    size_t size() const { return _offsets.size(); }
+
+    // SAN text of the i-th half move
+    const char* san(size_t i) const { return &_text[_offsets[i]]; }
+
+    const std::string& result() const { return _result; }
+
+    void add_tag(const std::string& name, const std::string& value);
+
+    void add_san(const char* san, size_t length);
+
+    void set_result(const std::string& result) { _result = result; }
+
+private:
+
+    std::vector<Tag> _tags;
+    std::vector<char> _text;
+    std::vector<uint32_t> _offsets;
+    std::string _result;
+
+};
+
+
+// Reads games one at a time from a stream through a fixed size buffer
+class PgnReader {
+
+public:
+
+    PgnReader(std::istream& in) : _in(in), _pos(0), _length(0) {}
+
+    // Read the next game. Returns false when the input is exhausted.
+    bool next_game(PgnGame& game);
+
+private:
+
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    std::istream& _in;
+    char _buffer[BUFFER_SIZE];
+    size_t _pos, _length;
+
+    int peek();
+
+    int get();
+
+    void skip_until(char end);
+
+    bool read_tag(PgnGame& game);
+
+    size_t read_token(char* token, size_t capacity);
+
+};
+
+
+// Resolve every SAN move of a game from its start position, left in
+// `start': the FEN tag's position unless SetUp is "0", the standard one
+// otherwise ("King of the Hill" in the Variant tag selects that variant).
+// With `through_game' each move is also pushed through the variant's
+// make_move so the rules layer validates it. Returns false if the FEN
+// doesn't parse or at the first move that fails.
+bool replay_pgn(const PgnGame& game, Board& start, std::vector<Move>& moves, bool through_game);
+
+// Write one game in export format: the seven tag roster first,
+// then any other tags, then the movetext wrapped at 80 columns
+void write_pgn(std::ostream& os, const std::vector<PgnGame::Tag>& tags,
+               const Board& start, const std::vector<Move>& moves, const std::string& result);
+
+#endif // PGN_H
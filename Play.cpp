@@ -1,9 +1,28 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 #include "Prompts.h"
 #include "Game.h"
 #include "ChessGame.h"
 #include "KOTHChessGame.h"
 #include "SpookyChessGame.h"
+#include "Batch.h"
+#include "Pgn.h"
+#include "Fen.h"
+#include "MateSolver.h"
+#include "Book.h"
+#include "Renderer.h"
+#include "Spectator.h"
+#include "SaveFile.h"
+#include "Database.h"
+#include "Suite.h"
 
 using std::cin;
 using std::string;
@@ -37,8 +56,521 @@ string collect_filename() {
 }
 
 
+// Ask user for a position in FEN, false if it can't be parsed
+bool collect_fen(Variant variant, FenPosition& fen) {
+    Prompts::load_fen();
+    string text;
+    cin >> std::ws;
+    //leave the newline for Game::run, as the other prompts do
+    while (cin.peek() != '\n' && cin.peek() != EOF) {
+        text += (char) cin.get();
+    }
+    return parse_fen(text.c_str(), variant, fen);
+}
+
+
+// Variant named on the command line: chess, king or spooky
+bool parse_variant(const string& name, Variant& variant) {
+    if (name == "chess") {
+        variant = VARIANT_CHESS;
+    } else if (name == "king") {
+        variant = VARIANT_KOTH;
+    } else if (name == "spooky") {
+        variant = VARIANT_SPOOKY;
+    } else {
+        std::cerr << "Unknown variant " << name << "\n";
+        return false;
+    }
+    return true;
+}
+
+
+// Headless mode: play --batch [--variant chess|king|spooky] [script ...]
+// Replays move scripts (stdin when none are given) without prompts
+// and prints a throughput and results report.
+int run_batch(int argc, char* argv[]) {
+    Variant variant = VARIANT_CHESS;
+    std::vector<string> scripts;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--variant" && i + 1 < argc) {
+            if (!parse_variant(argv[++i], variant)) {
+                return 1;
+            }
+        } else {
+            scripts.push_back(arg);
+        }
+    }
+    BatchRunner runner(variant);
+    int failures = 0;
+    if (scripts.empty()) {
+        runner.run(cin);
+    }
+    for (size_t i = 0; i < scripts.size(); i++) {
+        if (scripts[i] == "-") {
+            runner.run(cin);
+        } else if (!runner.run_file(scripts[i])) {
+            std::cerr << "Could not open " << scripts[i] << "\n";
+            failures++;
+        }
+    }
+    runner.print_report(std::cout);
+    return failures ? 1 : 0;
+}
+
+
+// PGN import: play --pgn archive.pgn [--validate] [--export out.pgn]
+// Streams the archive resolving every SAN move. --validate also pushes the
+// moves through make_move, --export writes the accepted games back out.
+int run_pgn(int argc, char* argv[]) {
+    string input, output;
+    bool validate = false;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--validate") {
+            validate = true;
+        } else if (arg == "--export" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            input = arg;
+        }
+    }
+    std::ifstream in(input.c_str(), std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Could not open " << input << "\n";
+        return 1;
+    }
+    std::ofstream out;
+    if (!output.empty()) {
+        out.open(output.c_str());
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PgnReader reader(in);
+    PgnGame game;
+    Board board;
+    std::vector<Move> moves;
+    unsigned long games = 0, plies = 0, rejected = 0;
+    while (reader.next_game(game)) {
+        games++;
+        if (!replay_pgn(game, board, moves, validate)) {
+            rejected++;
+            continue;
+        }
+        plies += moves.size();
+        if (out.is_open()) {
+            write_pgn(out, game.tags(), board, moves,
+                      game.result().empty() ? "*" : game.result());
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games:        " << games << "\n"
+              << "plies:        " << plies << "\n"
+              << "rejected:     " << rejected << "\n"
+              << "seconds:      " << seconds << "\n"
+              << "games/minute: " << (seconds > 0 ? (unsigned long) (games * 60 / seconds) : 0) << "\n";
+    return 0;
+}
+
+
+// Opening book: play --make-book archive.pgn [--out book.bin] [--plies N] [--min N]
+// Books the first N plies (default 20) of every standard chess game,
+// keeping moves played in at least --min games (default 1).
+int run_make_book(int argc, char* argv[]) {
+    string input, output = "book.bin";
+    int plies = 20, min_games = 1;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--plies" && i + 1 < argc) {
+            plies = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--min" && i + 1 < argc) {
+            min_games = std::max(1, atoi(argv[++i]));
+        } else {
+            input = arg;
+        }
+    }
+    std::ifstream in(input.c_str(), std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Could not open " << input << "\n";
+        return 1;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PgnReader reader(in);
+    PgnGame game;
+    Board board;
+    std::vector<Move> moves;
+    BookBuilder builder(plies, min_games);
+    unsigned long games = 0, booked = 0;
+    while (reader.next_game(game)) {
+        games++;
+        //other variants have no place in the book
+        if (game.tag("Variant") == "King of the Hill" || !replay_pgn(game, board, moves, false)) {
+            continue;
+        }
+        builder.add_game(board, moves, game.result());
+        booked++;
+    }
+    size_t entries = 0;
+    if (!builder.write(output, entries)) {
+        std::cerr << "Could not write " << output << "\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games:        " << games << "\n"
+              << "booked:       " << booked << "\n"
+              << "entries:      " << entries << "\n"
+              << "seconds:      " << seconds << "\n";
+    return 0;
+}
+
+
+// Game database: play --make-db [--out games.db] archive.pgn saved.bin ...
+// Imports every game of the PGN archives and every saved game (binary or
+// text format), which is a game of no moves from its position.
+int run_make_db(int argc, char* argv[]) {
+    string output = "games.db";
+    std::vector<string> inputs;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    DatabaseBuilder builder;
+    PgnGame game;
+    std::vector<Move> moves;
+    unsigned long imported = 0, rejected = 0;
+    for (size_t f = 0; f < inputs.size(); f++) {
+        SavedGame saved;
+        if (read_saved_game(inputs[f], saved) == status::SUCCESS) {
+            Board board;
+            saved_game_board(saved, board);
+            moves.clear();
+            builder.add_game(board, moves, RESULT_UNKNOWN) ? imported++ : rejected++;
+            continue;
+        }
+        std::ifstream in(inputs[f].c_str(), std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Could not open " << inputs[f] << "\n";
+            return 1;
+        }
+        PgnReader reader(in);
+        while (reader.next_game(game)) {
+            Board start;
+            if (!replay_pgn(game, start, moves, false)) {
+                rejected++;
+                continue;
+            }
+            builder.add_game(start, moves, parse_result(game.result())) ? imported++ : rejected++;
+        }
+    }
+    size_t entries = 0;
+    if (!builder.write(output, entries)) {
+        std::cerr << "Could not write " << output << "\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games:        " << imported << "\n"
+              << "rejected:     " << rejected << "\n"
+              << "positions:    " << entries << "\n"
+              << "seconds:      " << seconds << "\n";
+    return 0;
+}
+
+
+// Database query: play --query-db [--db games.db] [--variant chess|king|spooky] [--list N] [FEN]
+// Prints the moves played from a position (the start position without a
+// FEN) with their results, and the first N games (10) that reached it.
+int run_query_db(int argc, char* argv[]) {
+    string path = "games.db", text;
+    Variant variant = VARIANT_CHESS;
+    size_t list = 10;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--db" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (arg == "--variant" && i + 1 < argc) {
+            if (!parse_variant(argv[++i], variant)) {
+                return 1;
+            }
+        } else if (arg == "--list" && i + 1 < argc) {
+            list = (size_t) std::max(0, atoi(argv[++i]));
+        } else {
+            text += (text.empty() ? "" : " ") + arg;
+        }
+    }
+    Board board = Board::start_position(variant);
+    FenPosition fen;
+    if (!text.empty()) {
+        if (!parse_fen(text.c_str(), variant, fen)) {
+            std::cerr << "Not a FEN position: " << text << "\n";
+            return 1;
+        }
+        fen_to_board(fen, variant, board);
+    }
+    GameDatabase database;
+    if (!database.open(path)) {
+        std::cerr << "Could not open " << path << "\n";
+        return 1;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t reached = database.count(board.key());
+    std::vector<DatabaseMove> moves;
+    database.moves(board, moves);
+    std::vector<DatabaseHit> hits;
+    database.find(board.key(), hits, list);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "games:        " << database.games() << "\n"
+              << "reached:      " << reached << "\n"
+              << "milliseconds: " << seconds * 1000 << "\n";
+    for (size_t i = 0; i < moves.size(); i++) {
+        const DatabaseMove& m = moves[i];
+        std::cout << move_to_san(board, m.move) << "  " << m.games << " games  +" << m.white
+                  << " =" << m.draws << " -" << m.black << "\n";
+    }
+    for (size_t i = 0; i < hits.size(); i++) {
+        std::cout << "game " << hits[i].game + 1 << " ply " << hits[i].ply << "\n";
+    }
+    return 0;
+}
+
+
+// Puzzle solving: play --solve [--moves N] [--nodes N] [--variant chess|king|spooky] [file]
+// Proves or disproves a forced mate for every FEN/EPD line of the file
+// (stdin when none is given). An EPD "dm" operation is checked against
+// the mate length found.
+int run_solve(int argc, char* argv[]) {
+    Variant variant = VARIANT_CHESS;
+    int max_moves = 3;
+    uint64_t node_limit = 0;
+    string input;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--variant" && i + 1 < argc) {
+            if (!parse_variant(argv[++i], variant)) {
+                return 1;
+            }
+        } else if (arg == "--moves" && i + 1 < argc) {
+            max_moves = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            node_limit = strtoull(argv[++i], nullptr, 10);
+        } else {
+            input = arg;
+        }
+    }
+    std::ifstream file;
+    if (!input.empty()) {
+        file.open(input.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Could not open " << input << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = input.empty() ? cin : file;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MateSolver solver;
+    solver.set_node_limit(node_limit);
+    unsigned long positions = 0, mates = 0, unknown = 0, wrong = 0, nodes = 0;
+    string line;
+    for (unsigned long number = 1; std::getline(in, line); number++) {
+        FenPosition fen;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (!parse_fen(line.c_str(), variant, fen)) {
+            std::cerr << "line " << number << ": not a FEN or EPD position\n";
+            continue;
+        }
+        Board board;
+        fen_to_board(fen, variant, board);
+        MateTree tree;
+        int moves;
+        SolveResult result = solver.solve(board, max_moves, tree, moves);
+        positions++;
+        nodes += solver.nodes();
+        const EpdOperation* id = fen.operation("id");
+        std::cout << (id ? id->operand_string() : "line " + std::to_string(number)) << ": ";
+        if (result == SOLVE_MATE) {
+            mates++;
+            std::cout << "mate in " << moves << " " << move_to_string(tree.replies[0].move);
+        } else if (result == SOLVE_NO_MATE) {
+            std::cout << "no mate in " << moves;
+        } else {
+            unknown++;
+            std::cout << "unknown";
+        }
+        const EpdOperation* dm = fen.operation("dm");
+        if (dm && result != SOLVE_UNKNOWN && (result != SOLVE_MATE || atoi(dm->operand_string().c_str()) != moves)) {
+            wrong++;
+            std::cout << " (expected mate in " << dm->operand_string() << ")";
+        }
+        std::cout << " [" << solver.nodes() << " nodes]\n";
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "positions:    " << positions << "\n"
+              << "mates:        " << mates << "\n"
+              << "unknown:      " << unknown << "\n"
+              << "wrong:        " << wrong << "\n"
+              << "nodes:        " << nodes << "\n"
+              << "seconds:      " << seconds << "\n"
+              << "nodes/second: " << (seconds > 0 ? (unsigned long) (nodes / seconds) : 0) << "\n";
+    return wrong ? 1 : 0;
+}
+
+
+// Test suite: play --suite [--time ms] [--nodes N] [--depth N] [--threads N] [--hash MB] [--variant v] suite.epd
+// Searches every EPD position with "bm" or "am" moves on a worker of its
+// own, one second each unless given limits, and reports how many the
+// engine solved. Positions are printed as they finish.
+int run_suite(int argc, char* argv[]) {
+    Variant variant = VARIANT_CHESS;
+    SearchLimits limits;
+    int threads = 0, hash_mb = 16;
+    string input;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--variant" && i + 1 < argc) {
+            if (!parse_variant(argv[++i], variant)) {
+                return 1;
+            }
+        } else if (arg == "--time" && i + 1 < argc) {
+            limits.movetime = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--nodes" && i + 1 < argc) {
+            limits.nodes = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            limits.depth = std::max(1, std::min(MAX_PLY - 1, atoi(argv[++i])));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--hash" && i + 1 < argc) {
+            hash_mb = std::max(1, atoi(argv[++i]));
+        } else {
+            input = arg;
+        }
+    }
+    if (limits.movetime == 0 && limits.nodes == 0 && limits.depth == MAX_PLY - 1) {
+        limits.movetime = 1000;
+    }
+    std::ifstream in(input.c_str());
+    if (!in.is_open()) {
+        std::cerr << "Could not open " << input << "\n";
+        return 1;
+    }
+    std::vector<SuitePosition> positions;
+    string line, error;
+    for (unsigned long number = 1; std::getline(in, line); number++) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        SuitePosition position;
+        position.id = "line " + std::to_string(number);
+        if (!parse_suite_position(line, variant, position, error)) {
+            std::cerr << "line " << number << ": " << error << "\n";
+            continue;
+        }
+        positions.push_back(position);
+    }
+    SuiteRunner runner(limits, threads, (size_t) hash_mb);
+    runner.set_listener([](const SuitePosition& position, const SuiteResult& result) {
+        std::cout << position.id << ": " << (result.move != NO_MOVE ? move_to_san(position.board, result.move) : "none")
+                  << " " << format_score(result.score) << " depth " << result.depth << " "
+                  << (result.solved ? "solved in " + std::to_string(result.solved_milliseconds) + " ms" : "not solved")
+                  << " [" << result.nodes << " nodes]\n";
+    });
+    std::vector<SuiteResult> results;
+    runner.run(positions, results);
+    runner.print_report(std::cout);
+    return 0;
+}
+
 
-int main() {
+// Set by Ctrl-C, so the viewer can leave the alternate screen first
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void interrupt(int) {
+    interrupted = 1;
+}
+
+
+// Spectator: play --watch [name]
+// Follows the game broadcasting as `name' (default "featured") until it
+// ends or stops broadcasting. Only ever reads the shared feed, so any
+// number of viewers cost the game nothing.
+int run_watch(int argc, char* argv[]) {
+    string name = argc > 2 ? argv[2] : "featured";
+    SpectatorView view;
+    if (!view.open(name)) {
+        std::cerr << "No broadcast named " << name << "\n";
+        return 1;
+    }
+    std::signal(SIGINT, interrupt);
+    bool screen = isatty(STDOUT_FILENO);
+    Renderer renderer;
+    SpectatorFrame frame;
+    uint64_t shown = 0;
+    bool over = false;
+    while (!over && !interrupted) {
+        //checked before reading, so the last frame of a closed feed is still shown
+        bool closed = view.closed();
+        if (view.latest(frame) && frame.number != shown) {
+            renderer.begin();
+            if (shown == 0 && screen) {
+                renderer.alternate_screen(true);
+            }
+            if (screen) {
+                renderer.move_to(1, 1);
+            }
+            compose_spectator(renderer, frame);
+            renderer.flush();
+            shown = frame.number;
+            over = frame.status >= MOVE_CHECKMATE;
+        }
+        if (closed && !over) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    //the final position stays on the normal screen
+    if (shown != 0 && screen) {
+        renderer.begin();
+        renderer.alternate_screen(false);
+        compose_spectator(renderer, frame);
+        renderer.flush();
+    }
+    std::cout << (over ? "The game is over.\n" : "The broadcast has ended.\n");
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc > 1 && string(argv[1]) == "--batch") {
+        return run_batch(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "--pgn") {
+        return run_pgn(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "--solve") {
+        return run_solve(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "--suite") {
+        return run_suite(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "--make-book") {
+        return run_make_book(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "--make-db") {
+        return run_make_db(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "--query-db") {
+        return run_query_db(argc, argv);
+    }
+    if (argc > 1 && string(argv[1]) == "--watch") {
+        return run_watch(argc, argv);
+    }
 
     // Determine which game to play, and how to begin it
     int game_choice = collect_game_choice();
@@ -46,21 +578,29 @@ int main() {
 
     // Set up the desired game
     Game *g = nullptr;
+    string filename;
+    FenPosition fen;
     if (game_choice == STANDARD_CHESS && new_or_load_choice == 1) {  //new standard chess
         g = new ChessGame();
     } else if (game_choice == STANDARD_CHESS && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-        g = new ChessGame(filename);
+        g = new ChessGame();
+        filename = collect_filename();
+    } else if (game_choice == STANDARD_CHESS && new_or_load_choice == 3) { //standard chess from FEN
+        g = collect_fen(VARIANT_CHESS, fen) ? new ChessGame(fen) : nullptr;
     } else if (game_choice == KING_OF_THE_HILL && new_or_load_choice == 1) {  //new standard chess
         g = new KOTHChessGame();
     } else if (game_choice == KING_OF_THE_HILL && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-        g = new KOTHChessGame(filename);
+        g = new KOTHChessGame();
+        filename = collect_filename();
+    } else if (game_choice == KING_OF_THE_HILL && new_or_load_choice == 3) { //king of the hill from FEN
+        g = collect_fen(VARIANT_KOTH, fen) ? new KOTHChessGame(fen) : nullptr;
     } else if (game_choice == SPOOKY_CHESS && new_or_load_choice == 1) {  //new standard chess
         g = new SpookyChessGame();
     } else if (game_choice == SPOOKY_CHESS && new_or_load_choice == 2) { //load standard chess
-        string filename = collect_filename();
-        g = new SpookyChessGame(filename);
+        g = new SpookyChessGame();
+        filename = collect_filename();
+    } else if (game_choice == SPOOKY_CHESS && new_or_load_choice == 3) { //spooky chess from FEN
+        g = collect_fen(VARIANT_SPOOKY, fen) ? new SpookyChessGame(fen) : nullptr;
     }
 
 
@@ -72,6 +612,17 @@ int main() {
       return 1;
     }
 
+    if (new_or_load_choice == 3 && g == nullptr) {
+        Prompts::load_failure();
+        return 1;
+    }
+
+    if (!filename.empty() && g->load(filename) < 0) {
+        Prompts::load_failure();
+        delete g;
+        return 1;
+    }
+
     // Begin play of the selected game!
     g->run();
 
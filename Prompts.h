@@ -1,7 +1,9 @@
 #ifndef PROMPTS_H
 #define PROMPTS_H
 
+#include <iomanip>
 #include <iostream>
+#include <streambuf>
 #include <string>
 
 #include "Enumerations.h"
@@ -32,7 +34,8 @@ public:
     static void new_or_load_choice() {
         std::cout
             << "1. Start a new game\n"
-            << "2. Load a saved game\n";
+            << "2. Load a saved game\n"
+            << "3. Load a FEN position\n";
     }
 
     static void load_game() {
@@ -75,6 +78,18 @@ public:
         std::cout << "Stalemate!\n";
     }
 
+    static void repetition() {
+        std::cout << "Draw! The same position has occurred three times.\n";
+    }
+
+    static void fifty_moves() {
+        std::cout << "Draw! Fifty moves without a capture or a pawn move.\n";
+    }
+
+    static void insufficient_material() {
+        std::cout << "Draw! Neither player can win from this position.\n";
+    }
+
     static void parse_error() {
         std::cout << "Error: couldn't parse your move.\n";
     }
@@ -119,6 +134,129 @@ public:
         std::cout << get_player_name(pl) << "'s king has reached the hill!!!\n";
     }
 
+    static void analysis_header(Player pl, int depth) {
+        std::cout << "Best moves for " << get_player_name(pl) << " (depth " << depth << "):\n";
+    }
+
+    static void mcts_header(Player pl, unsigned long playouts, unsigned long reused, unsigned long nodes) {
+        std::cout << "Best moves for " << get_player_name(pl) << " (" << playouts << " playouts, "
+            << reused << " reused, " << nodes << " nodes):\n";
+    }
+
+    static void mate_found(Player pl, int moves, unsigned long nodes) {
+        std::cout << get_player_name(pl) << " mates in " << moves << " (" << nodes << " nodes):\n";
+    }
+
+    static void mate_step(int depth, const std::string& step) {
+        std::cout << std::string(2 * depth, ' ') << step << "\n";
+    }
+
+    static void no_mate(Player pl, int moves, unsigned long nodes) {
+        std::cout << get_player_name(pl) << " has no forced mate in " << moves << " (" << nodes << " nodes).\n";
+    }
+
+    static void mate_unknown(unsigned long nodes) {
+        std::cout << "Could not decide the position within " << nodes << " nodes.\n";
+    }
+
+    static void nothing_to_undo() {
+        std::cout << "Error: there is no move to undo.\n";
+    }
+
+    static void nothing_to_redo() {
+        std::cout << "Error: there is no move to redo.\n";
+    }
+
+    static void book_header(Player pl) {
+        std::cout << "Book moves for " << get_player_name(pl) << ":\n";
+    }
+
+    static void book_line(const std::string& move, int weight, double percent) {
+        std::streamsize precision = std::cout.precision(1);
+        std::cout << std::fixed << move << "  " << percent << "% (weight " << weight << ")\n";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout.precision(precision);
+    }
+
+    static void not_in_book() {
+        std::cout << "This position is not in the opening book.\n";
+    }
+
+    static void database_header(size_t games) {
+        std::cout << "Moves played here in " << games << " database games:\n";
+    }
+
+    static void database_line(const std::string& move, unsigned int games, double white, double draw, double black) {
+        std::streamsize precision = std::cout.precision(1);
+        std::cout << std::fixed << move << "  " << games << " games  +" << white << "% =" << draw
+                  << "% -" << black << "%\n";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout.precision(precision);
+    }
+
+    static void not_in_database() {
+        std::cout << "No database game continued from this position.\n";
+    }
+
+    static void analysis_line(int rank, const std::string& score, const std::string& pv) {
+        std::cout << rank << ". " << score << "  " << pv << "\n";
+    }
+
+    static void analysis_unavailable() {
+        std::cout << "Error: this position cannot be analysed.\n";
+    }
+
+    static void win_estimate(unsigned long playouts, double white, double white_margin,
+                             double black, double black_margin, double draw) {
+        std::streamsize precision = std::cout.precision(1);
+        std::cout << std::fixed << playouts << " playouts: White "
+            << white * 100 << "% +-" << white_margin * 100 << "%, Black "
+            << black * 100 << "% +-" << black_margin * 100 << "%, draw " << draw * 100 << "%\n";
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout.precision(precision);
+    }
+
+    static void load_fen() {
+        std::cout << "Enter FEN of the position to load:\n";
+    }
+
+    static void fen(const std::string& fen) {
+        std::cout << fen << "\n";
+    }
+
+    static void broadcasting(const std::string& name, const std::string& path) {
+        std::cout << "Broadcasting to " << path << ", watch with: play --watch " << name << "\n";
+    }
+
+    static void broadcast_failed(const std::string& name) {
+        std::cout << "Error: cannot broadcast as \"" << name << "\".\n";
+    }
+
+    static void broadcast_stopped() {
+        std::cout << "Broadcast stopped.\n";
+    }
+
+};
+
+
+// Silences std::cout, and so every Prompts message, while in scope.
+// Used when games are replayed without a player at the terminal.
+class QuietPrompts {
+
+public:
+    QuietPrompts() : _saved(std::cout.rdbuf(&_null)) {}
+    ~QuietPrompts() { std::cout.rdbuf(_saved); }
+
+private:
+    // Stream buffer that throws away everything written to it
+    class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    NullBuffer _null;
+    std::streambuf* _saved;
 };
 
 #endif // PROMPTS_H
@@ -0,0 +1,124 @@
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+#include "Renderer.h"
+
+// Unicode chess symbols indexed by PieceEnum, for white and black
+static const char* const PIECE_GLYPHS[2][6] = {
+    {"\u2659", "\u2656", "\u2658", "\u2657", "\u2655", "\u2654"},
+    {"\u265F", "\u265C", "\u265E", "\u265D", "\u265B", "\u265A"}
+};
+
+const char* piece_glyph(int owner, int type) {
+    return PIECE_GLYPHS[owner][type];
+}
+
+Renderer::Renderer(size_t capacity) : _fg(-1), _bg(-1), _bright(-1) {
+    _buffer.reserve(capacity);
+}
+
+void Renderer::begin() {
+    _buffer.clear();
+    _fg = _bg = _bright = -1;
+}
+
+void Renderer::number(int n) {
+    char digits[16];
+    int length = std::snprintf(digits, sizeof(digits), "%d", n);
+    _buffer.append(digits, (size_t) length);
+}
+
+//one SGR sequence carrying only the attributes that differ, -1 leaving
+//an attribute as it is
+void Renderer::sgr(int bright, int fore, int back) {
+    bool first = true;
+    auto parameter = [this, &first](int value) {
+        _buffer.append(first ? CSI : ";");
+        first = false;
+        number(value);
+    };
+    if (bright > 0 && _bright != 1) {
+        parameter(1);
+        _bright = 1;
+    }
+    if (fore >= 0 && _fg != fore) {
+        parameter(30 + fore);
+        _fg = fore;
+    }
+    if (back >= 0 && _bg != back) {
+        parameter(40 + back);
+        _bg = back;
+    }
+    if (!first) {
+        _buffer.push_back('m');
+    }
+}
+
+//like Terminal, bright only ever turns bold on; set_default turns it off
+void Renderer::color_fg(bool bright, Terminal::Color color) {
+    sgr(bright ? 1 : -1, color, -1);
+}
+
+void Renderer::color_bg(Terminal::Color color) {
+    sgr(-1, -1, color);
+}
+
+void Renderer::color_all(bool bright, Terminal::Color fore, Terminal::Color back) {
+    sgr(bright ? 1 : -1, fore, back);
+}
+
+void Renderer::set_default() {
+    if (_fg != Terminal::DEFAULT_COLOR || _bg != Terminal::DEFAULT_COLOR || _bright != 0) {
+        _buffer.append(CSI);
+        _buffer.append("0m");
+        _fg = _bg = Terminal::DEFAULT_COLOR;
+        _bright = 0;
+    }
+}
+
+void Renderer::move_to(int row, int column) {
+    _buffer.append(CSI);
+    number(row);
+    _buffer.push_back(';');
+    number(column);
+    _buffer.push_back('H');
+}
+
+//the screens keep separate contents, so nothing is lost by switching
+void Renderer::alternate_screen(bool on) {
+    _buffer.append(CSI);
+    _buffer.append(on ? "?1049h" : "?1049l");
+    if (on) {
+        _buffer.append(CSI);
+        _buffer.append("2J");
+    }
+}
+
+void Renderer::scroll_region(int top) {
+    _buffer.append(CSI);
+    if (top > 0) {
+        number(top);
+    }
+    _buffer.push_back('r');
+}
+
+bool Renderer::flush(int fd) {
+    //prompts written before the frame must reach the terminal first
+    std::cout.flush();
+    std::fflush(stdout);
+    const char* data = _buffer.data();
+    size_t left = _buffer.size();
+    while (left > 0) {
+        ssize_t written = write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        left -= (size_t) written;
+    }
+    _buffer.clear();
+    return true;
+}
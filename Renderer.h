@@ -0,0 +1,85 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstddef>
+#include <string>
+#include "Terminal.h"
+
+/*
+Composes a whole frame of terminal output in one buffer and sends it with
+a single write(), instead of one stream insertion per square. Frames can
+also address the cursor, to rewrite parts of a screen drawn earlier. Colours are
+tracked as the terminal will see them, so a colour that is already set is
+not sent again. The buffer keeps its capacity from frame to frame and is
+only ever reallocated if a frame outgrows it.
+*/
+
+class Renderer {
+
+public:
+
+    // Reserve room for frames of up to `capacity' bytes
+    Renderer(size_t capacity = 8192);
+
+    // Start a new frame. The terminal's colours are unknown until the
+    // first colour of the frame is set.
+    void begin();
+
+    void text(const char* s) { _buffer.append(s); }
+
+    void text(const std::string& s) { _buffer.append(s); }
+
+    void text(char c) { _buffer.push_back(c); }
+
+    void number(int n);
+
+    void newline() { _buffer.push_back('\n'); }
+
+    // Same meaning as the Terminal functions, but only what changes is sent
+    void color_fg(bool bright, Terminal::Color color);
+
+    void color_bg(Terminal::Color color);
+
+    void color_all(bool bright, Terminal::Color fore, Terminal::Color back);
+
+    void set_default();
+
+    // Move the cursor to a 1-based row and column
+    void move_to(int row, int column);
+
+    // Erase from the cursor to the end of the line
+    void clear_line() { _buffer.append(CSI); _buffer.append("K"); }
+
+    // Remember and return to the cursor position and colours (DECSC/DECRC)
+    void save_cursor() { _buffer.append("\x1b" "7"); }
+
+    void restore_cursor() { _buffer.append("\x1b" "8"); }
+
+    // Switch to the alternate screen and clear it, or back to the normal one
+    void alternate_screen(bool on);
+
+    // Scroll only the lines from `top' down (0 scrolls the whole screen)
+    void scroll_region(int top);
+
+    // Write the frame to a file descriptor in one call (more only if the
+    // kernel takes it in parts), after whatever std::cout still holds.
+    // Returns false on write errors.
+    bool flush(int fd = 1);
+
+    // Bytes in the current frame
+    size_t size() const { return _buffer.size(); }
+
+private:
+
+    std::string _buffer;
+    int _fg, _bg;       // colours the terminal is set to, -1 if unknown
+    int _bright;        // bold attribute, -1 if unknown
+
+    void sgr(int bright, int fore, int back);
+
+};
+
+// Unicode chess symbol of a piece type (PieceEnum, king at most) of WHITE or BLACK
+const char* piece_glyph(int owner, int type);
+
+#endif // RENDERER_H
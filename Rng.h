@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+/*
+Counter-based random number generator (SplitMix64). The n-th number is a
+pure function of the seed and n, so a generator can be saved as two
+integers and resumed, or jumped to any point of its stream, in constant
+time. Every game owns its own generator, unlike the global rand() state.
+*/
+
+// Seed of every new Spooky Chess game
+static const uint64_t SPOOKY_SEED = 322;
+
+class Rng {
+
+public:
+
+    Rng(uint64_t seed = SPOOKY_SEED, uint64_t counter = 0) : _seed(seed), _counter(counter) {}
+
+    // Draw the next number of the stream
+    uint64_t next() { return at(_counter++); }
+
+    // Draw a number uniformly distributed in [0, n)
+    unsigned int below(unsigned int n) {
+        return static_cast<unsigned int>(((next() >> 32) * n) >> 32);
+    }
+
+    // The number drawn at position `counter' of the stream
+    uint64_t at(uint64_t counter) const {
+        uint64_t z = _seed + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Jump to any position of the stream
+    void seek(uint64_t counter) { _counter = counter; }
+
+    uint64_t seed() const { return _seed; }
+
+    // Numbers drawn so far
+    uint64_t counter() const { return _counter; }
+
+private:
+
+    uint64_t _seed;
+    uint64_t _counter;
+
+};
+
+#endif // RNG_H
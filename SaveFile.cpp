@@ -0,0 +1,257 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SaveFile.h"
+#include "Game.h"
+
+namespace {
+
+const char SAVE_MAGIC[4] = {'T', 'C', 'S', 'V'};
+
+const uint16_t SAVE_VERSION = 1;
+
+// Bytes before the position keys, and the checksum after them
+const size_t HEADER_SIZE = 100;
+const size_t CHECKSUM_SIZE = 4;
+
+uint64_t read_le(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+void write_le(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t) value;
+        value >>= 8;
+    }
+}
+
+uint32_t fnv1a(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+//`map' holds `length' bytes starting with the magic
+int decode_binary(const uint8_t* map, size_t length, SavedGame& game) {
+    if (length < HEADER_SIZE + CHECKSUM_SIZE || read_le(map + 4, 2) != SAVE_VERSION || map[6] > VARIANT_SPOOKY) {
+        return status::LOAD_FAILURE;
+    }
+    size_t keys = (size_t) read_le(map + 96, 4);
+    if ((length - HEADER_SIZE - CHECKSUM_SIZE) / 8 < keys ||
+        length != HEADER_SIZE + keys * 8 + CHECKSUM_SIZE ||
+        read_le(map + length - CHECKSUM_SIZE, 4) != fnv1a(map, length - CHECKSUM_SIZE)) {
+        return status::LOAD_FAILURE;
+    }
+    game.variant = static_cast<Variant>(map[6]);
+    game.turn = (int) read_le(map + 8, 4);
+    game.halfmove_clock = (int) read_le(map + 12, 4);
+    game.rng_seed = read_le(map + 16, 8);
+    game.rng_counter = read_le(map + 24, 8);
+    std::memcpy(game.squares, map + 32, BOARD_SQUARES);
+    game.history.resize(keys);
+    for (size_t i = 0; i < keys; i++) {
+        game.history[i] = read_le(map + HEADER_SIZE + 8 * i, 8);
+    }
+    return status::SUCCESS;
+}
+
+//the checks parse_fen makes of a position: known pieces, one king a side
+//and a ghost only in Spooky Chess
+bool valid_position(const SavedGame& game) {
+    int kings[2] = {0, 0};
+    int ghosts = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t code = game.squares[sq] & ~MOVED_BIT;
+        if (code == 0) {
+            continue;
+        }
+        if (code == GHOST_CODE) {
+            ghosts++;
+            continue;
+        }
+        int type = code_type(code);
+        Player owner = code_owner(code);
+        if (type < PAWN_ENUM || type > KING_ENUM || (owner != WHITE && owner != BLACK)) {
+            return false;
+        }
+        if (type == KING_ENUM) {
+            kings[owner]++;
+        }
+    }
+    return kings[WHITE] == 1 && kings[BLACK] == 1 && ghosts <= (game.variant == VARIANT_SPOOKY ? 1 : 0);
+}
+
+//"spooky" saves have "seed counter", or just the counter in older ones,
+//after the turn. Pieces haven't moved as far as this format knows.
+int read_text(const std::string& path, SavedGame& game) {
+    std::ifstream input_file(path);
+    std::string type;
+    int turn = 0;
+    if (!(input_file >> type >> turn) || !variant_from_name(type, game.variant)) {
+        return status::LOAD_FAILURE;
+    }
+    game.turn = turn + 1;
+    game.halfmove_clock = 0;
+    game.rng_seed = SPOOKY_SEED;
+    game.rng_counter = 0;
+    game.history.clear();
+    if (game.variant == VARIANT_SPOOKY) {
+        std::string rng_line;
+        std::getline(input_file >> std::ws, rng_line);
+        std::istringstream rng_is(rng_line);
+        unsigned long long first = 0, second = 0;
+        rng_is >> first;
+        if (rng_is >> second) {
+            game.rng_seed = first;
+            game.rng_counter = second;
+        } else {
+            game.rng_counter = first;
+        }
+    }
+    std::memset(game.squares, 0, BOARD_SQUARES);
+    int player, piece_type;
+    std::string coordinate;
+    while (input_file >> player >> coordinate >> piece_type) {
+        int x = coordinate.size() == 2 ? coordinate[0] - 'a' : -1;
+        int y = coordinate.size() == 2 ? coordinate[1] - '1' : -1;
+        if (x < 0 || x > 7 || y < 0 || y > 7 || player < WHITE || player > NO_ONE ||
+            piece_type < 0 || piece_type > GHOST_ENUM) {
+            return status::LOAD_FAILURE;
+        }
+        game.squares[make_square(x, y)] = piece_code(piece_type, static_cast<Player>(player));
+    }
+    return input_file.eof() ? status::SUCCESS : status::LOAD_FAILURE;
+}
+
+}
+
+const char* variant_name(Variant variant) {
+    switch (variant) {
+    case VARIANT_KOTH:
+        return "king";
+    case VARIANT_SPOOKY:
+        return "spooky";
+    default:
+        return "chess";
+    }
+}
+
+bool variant_from_name(const std::string& name, Variant& variant) {
+    for (int v = VARIANT_CHESS; v <= VARIANT_SPOOKY; v++) {
+        if (name == variant_name(static_cast<Variant>(v))) {
+            variant = static_cast<Variant>(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+//written aside and renamed, so a failed save leaves the old file whole
+int write_saved_game(const std::string& path, const SavedGame& game) {
+    size_t keys = game.history.size();
+    std::vector<uint8_t> bytes(HEADER_SIZE + keys * 8 + CHECKSUM_SIZE, 0);
+    uint8_t* p = bytes.data();
+    std::memcpy(p, SAVE_MAGIC, sizeof(SAVE_MAGIC));
+    write_le(p + 4, SAVE_VERSION, 2);
+    p[6] = (uint8_t) game.variant;
+    write_le(p + 8, (uint32_t) game.turn, 4);
+    write_le(p + 12, (uint32_t) game.halfmove_clock, 4);
+    write_le(p + 16, game.rng_seed, 8);
+    write_le(p + 24, game.rng_counter, 8);
+    std::memcpy(p + 32, game.squares, BOARD_SQUARES);
+    write_le(p + 96, (uint32_t) keys, 4);
+    for (size_t i = 0; i < keys; i++) {
+        write_le(p + HEADER_SIZE + 8 * i, game.history[i], 8);
+    }
+    size_t end = bytes.size() - CHECKSUM_SIZE;
+    write_le(p + end, fnv1a(p, end), 4);
+    std::string temporary = path + ".tmp";
+    FILE* f = std::fopen(temporary.c_str(), "wb");
+    if (f == nullptr) {
+        return status::SAVE_FAILURE;
+    }
+    bool ok = std::fwrite(p, bytes.size(), 1, f) == 1;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return status::SAVE_FAILURE;
+    }
+    return status::SUCCESS;
+}
+
+//rows from the first rank, as the text format always was
+int export_saved_game(const std::string& path, const SavedGame& game) {
+    std::ofstream output_file(path);
+    if (!output_file.is_open()) {
+        return status::SAVE_FAILURE;
+    }
+    output_file << variant_name(game.variant) << "\n";
+    output_file << game.turn - 1 << "\n";
+    if (game.variant == VARIANT_SPOOKY) {
+        output_file << game.rng_seed << " " << game.rng_counter << "\n";
+    }
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t code = game.squares[sq] & ~MOVED_BIT;
+        if (code != 0) {
+            output_file << code_owner(code) << " ";
+            output_file << (char) ('a' + square_x(sq)) << square_y(sq) + 1 << " ";
+            output_file << code_type(code) << "\n";
+        }
+    }
+    output_file.close();
+    return output_file.fail() ? status::SAVE_FAILURE : status::SUCCESS;
+}
+
+void saved_game_board(const SavedGame& game, Board& b) {
+    b = Board(game.variant);
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t code = game.squares[sq] & ~MOVED_BIT;
+        if (code != 0) {
+            b.put(sq, code);
+            b.set_moved(sq, (game.squares[sq] & MOVED_BIT) != 0);
+        }
+    }
+    b.set_turn(game.turn);
+    b.set_side(game.turn % 2 ? WHITE : BLACK);
+    b.set_rng(Rng(game.rng_seed, game.rng_counter));
+    b.refresh();
+}
+
+int read_saved_game(const std::string& path, SavedGame& game) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return status::LOAD_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return status::LOAD_FAILURE;
+    }
+    size_t length = (size_t) st.st_size;
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return status::LOAD_FAILURE;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(map);
+    bool binary = length >= sizeof(SAVE_MAGIC) && std::memcmp(bytes, SAVE_MAGIC, sizeof(SAVE_MAGIC)) == 0;
+    int result = binary ? decode_binary(bytes, length, game) : status::LOAD_FAILURE;
+    munmap(map, length);
+    if (!binary) {
+        result = read_text(path, game);
+    }
+    //a checksum only shows the file is whole, not that a build of this game wrote it
+    return result == status::SUCCESS && !valid_position(game) ? status::LOAD_FAILURE : result;
+}
@@ -0,0 +1,57 @@
+#ifndef SAVE_FILE_H
+#define SAVE_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Board.h"
+
+/*
+Saved games. The binary format is what "save" writes, little-endian:
+
+    0     "TCSV"
+    4     version (16 bits)
+    6     variant, then a reserved byte
+    8     turn number, halfmove clock (32 bits each)
+    16    ghost generator seed and counter (64 bits each)
+    32    the 64 squares as Board piece codes, MOVED_BIT set on moved pieces
+    96    number of position keys that may still repeat (32 bits), the keys
+    end   FNV-1a checksum of everything before (32 bits)
+
+It is read straight out of a mapping of the file, without parsing. The
+older text format ("chess", the turn, "owner square type" lines) is still
+read and can be exported. Either is refused unless its pieces are ones
+this game knows, with one king a side and a ghost only in Spooky Chess.
+Functions return SUCCESS or LOAD_FAILURE /
+SAVE_FAILURE from the status codes in Game.h.
+*/
+
+struct SavedGame {
+    Variant variant;
+    int turn;                       // Game::turn()
+    int halfmove_clock;
+    uint64_t rng_seed;
+    uint64_t rng_counter;
+    uint8_t squares[BOARD_SQUARES]; // a1 to h8, 0 for empty
+    std::vector<uint64_t> history;  // keys since the last capture or pawn move, current last
+};
+
+// Name of a variant as in save files and return_game_type()
+const char* variant_name(Variant variant);
+
+// The variant of a name, false if there is none
+bool variant_from_name(const std::string& name, Variant& variant);
+
+// Write `game' in the binary format
+int write_saved_game(const std::string& path, const SavedGame& game);
+
+// Write `game' in the text format
+int export_saved_game(const std::string& path, const SavedGame& game);
+
+// Read a game saved in either format
+int read_saved_game(const std::string& path, SavedGame& game);
+
+// The position of a saved game
+void saved_game_board(const SavedGame& game, Board& b);
+
+#endif // SAVE_FILE_H
@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Server.h"
+#include "Fen.h"
+#include "Tablebase.h"
+
+namespace {
+
+// Clients sending longer lines than this are disconnected
+const size_t MAX_LINE = 4096;
+
+const int MAX_EVENTS = 64;
+
+// How often idle games are looked for
+const int SWEEP_MILLISECONDS = 1000;
+
+// Record of a table entry that isn't hibernating
+const uint32_t NO_RECORD = 0xFFFFFFFF;
+
+// Pieces on the board, the ghost not counted
+int piece_count(const Board& b) {
+    int count = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        count += b.at(sq) != 0 && b.at(sq) != GHOST_CODE;
+    }
+    return count;
+}
+
+}
+
+// A client socket. Output may be queued by any worker; the socket
+// itself is only closed by the thread in run().
+struct GameServer::Connection {
+    int fd;
+    std::mutex lock;        // guards everything below
+    bool closed;
+    std::string output;     // sent as the socket accepts it
+    std::string input;      // partial line, only used by run()
+
+    Connection(int socket) : fd(socket), closed(false) {}
+};
+
+
+GameServer::GameServer(int threads) : _pool(threads), _games(0), _resident(0), _idle(0),
+                                      _last_sweep(std::chrono::steady_clock::now()),
+                                      _listen_fd(-1), _epoll_fd(-1), _wake_fd(-1) {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = _wake_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event);
+}
+
+GameServer::~GameServer() {
+    for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+        std::lock_guard<std::mutex> guard(it->second->lock);
+        it->second->closed = true;
+        close(it->first);
+    }
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+        unlink(_path.c_str());
+    }
+    close(_wake_fd);
+    close(_epoll_fd);
+}
+
+bool GameServer::listen(const std::string& path) {
+    struct sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        close(fd);
+        return false;
+    }
+    _listen_fd = fd;
+    _path = path;
+    return true;
+}
+
+void GameServer::stop() {
+    uint64_t one = 1;
+    ssize_t written = write(_wake_fd, &one, sizeof(one));
+    (void) written;
+}
+
+size_t GameServer::games() {
+    std::lock_guard<std::mutex> guard(_table_lock);
+    return _games;
+}
+
+size_t GameServer::resident() {
+    std::lock_guard<std::mutex> guard(_table_lock);
+    return _resident;
+}
+
+void GameServer::run() {
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        //wake up once a second to look for idle games
+        bool hibernate = _idle.count() > 0;
+        int count = epoll_wait(_epoll_fd, events, MAX_EVENTS, hibernate ? SWEEP_MILLISECONDS : -1);
+        if (count < 0 && errno != EINTR) {
+            return;
+        }
+        if (hibernate && std::chrono::steady_clock::now() - _last_sweep >=
+                         std::chrono::milliseconds(SWEEP_MILLISECONDS)) {
+            hibernate_idle();
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _wake_fd) {
+                return;
+            }
+            if (fd == _listen_fd) {
+                accept_clients();
+                continue;
+            }
+            auto it = _clients.find(fd);
+            if (it == _clients.end()) {
+                continue;
+            }
+            std::shared_ptr<Connection> client = it->second;
+            if (events[i].events & EPOLLOUT) {
+                std::lock_guard<std::mutex> guard(client->lock);
+                if (flush(*client)) {
+                    watch_output(*client, false);
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read_client(client);
+            }
+        }
+    }
+}
+
+void GameServer::accept_clients() {
+    for (;;) {
+        int fd = accept4(_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        _clients[fd] = std::make_shared<Connection>(fd);
+    }
+}
+
+//reads everything available, handling each complete line
+void GameServer::read_client(const std::shared_ptr<Connection>& client) {
+    char buffer[4096];
+    for (;;) {
+        ssize_t length = read(client->fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (length <= 0) {
+            drop_client(client);
+            return;
+        }
+        size_t start = 0;
+        for (ssize_t i = 0; i < length; i++) {
+            if (buffer[i] == '\n') {
+                client->input.append(buffer + start, (size_t) i - start);
+                std::string line;
+                line.swap(client->input);
+                if (!line.empty() && line[line.size() - 1] == '\r') {
+                    line.erase(line.size() - 1);
+                }
+                handle_line(client, line);
+                start = (size_t) i + 1;
+                if (client->closed) {
+                    return;
+                }
+            }
+        }
+        client->input.append(buffer + start, (size_t) length - start);
+        if (client->input.size() > MAX_LINE) {
+            drop_client(client);
+            return;
+        }
+    }
+}
+
+void GameServer::drop_client(const std::shared_ptr<Connection>& client) {
+    {
+        std::lock_guard<std::mutex> guard(client->lock);
+        client->closed = true;
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, client->fd, nullptr);
+        close(client->fd);
+    }
+    _clients.erase(client->fd);
+}
+
+//commands without a game are answered here, the rest go to their game
+void GameServer::handle_line(const std::shared_ptr<Connection>& client, const std::string& line) {
+    std::istringstream is(line);
+    std::string command;
+    if (!(is >> command)) {
+        return;
+    }
+    if (command == "quit") {
+        drop_client(client);
+        return;
+    }
+    if (command == "stats") {
+        std::ostringstream os;
+        os << "stats games " << games() << " resident " << resident() << " threads " << _pool.threads();
+        if (_journal.is_open() && _journal.failed()) {
+            os << " journal failed";
+        }
+        send(client, os.str());
+        return;
+    }
+    if (command == "new") {
+        std::string name;
+        is >> name;
+        Variant variant;
+        if (name == "chess") {
+            variant = VARIANT_CHESS;
+        } else if (name == "king") {
+            variant = VARIANT_KOTH;
+        } else if (name == "spooky") {
+            variant = VARIANT_SPOOKY;
+        } else {
+            send(client, "error new unknown variant");
+            return;
+        }
+        std::shared_ptr<HostedGame> game = start_game(variant);
+        game->active = std::chrono::steady_clock::now();
+        //journaled before the id is known, so before any move of the game
+        std::lock_guard<std::mutex> guard(_table_lock);
+        TableEntry entry = {game, NO_RECORD};
+        _table.push_back(entry);
+        game->id = (uint32_t) _table.size();
+        _games++;
+        _resident++;
+        JournalRecord record = {game->id, (uint16_t) variant, JOURNAL_NEW};
+        reply(client, "game " + std::to_string(game->id), record);
+        return;
+    }
+    if (command != "move" && command != "fen" && command != "legal" && command != "close") {
+        send(client, "error " + command + " unknown command");
+        return;
+    }
+    std::string id;
+    Request request;
+    request.client = client;
+    request.command = command;
+    is >> id >> request.argument;
+    std::shared_ptr<HostedGame> game = find_game((uint32_t) std::strtoul(id.c_str(), nullptr, 10));
+    if (!game) {
+        send(client, "error " + (id.empty() ? command : id) + " no such game");
+        return;
+    }
+    dispatch(game, request);
+}
+
+std::shared_ptr<GameServer::HostedGame> GameServer::find_game(uint32_t id) {
+    std::lock_guard<std::mutex> guard(_table_lock);
+    if (id == 0 || id > _table.size()) {
+        return nullptr;
+    }
+    TableEntry& entry = _table[id - 1];
+    if (entry.game || entry.record == NO_RECORD) {
+        return entry.game;
+    }
+    Snapshot snapshot;
+    std::vector<uint64_t> earlier;
+    _store.take(entry.record, snapshot, earlier);
+    std::shared_ptr<HostedGame> game = unpack_game(id, snapshot, earlier);
+    entry.game = game;
+    entry.record = NO_RECORD;
+    _resident++;
+    return game;
+}
+
+//games with a task running or commands waiting are busy, not idle. The
+//task of a game whose inbox is empty is about to finish, and only run()
+//adds commands, so a game found idle here stays idle while it is packed.
+void GameServer::hibernate_idle() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    _last_sweep = now;
+    std::lock_guard<std::mutex> guard(_table_lock);
+    size_t packed = 0;
+    for (size_t i = 0; i < _table.size(); i++) {
+        TableEntry& entry = _table[i];
+        if (!entry.game) {
+            continue;
+        }
+        HostedGame& game = *entry.game;
+        {
+            std::lock_guard<std::mutex> game_guard(game.lock);
+            if (game.scheduled || !game.inbox.empty() || now - game.active < _idle) {
+                continue;
+            }
+        }
+        Snapshot snapshot;
+        std::vector<uint64_t> earlier;
+        uint32_t record;
+        if (!pack_game(game, snapshot, earlier) || !_store.put(snapshot, earlier, record)) {
+            continue;
+        }
+        entry.record = record;
+        entry.game.reset();
+        _resident--;
+        packed++;
+    }
+#ifdef __GLIBC__
+    //give the memory of the games just packed back to the system
+    if (packed > 0) {
+        malloc_trim(0);
+    }
+#endif
+}
+
+std::shared_ptr<GameServer::HostedGame> GameServer::start_game(Variant variant) {
+    std::shared_ptr<HostedGame> game = std::make_shared<HostedGame>();
+    game->board = Board::start_position(variant);
+    game->id = 0;
+    game->halfmove_clock = 0;
+    game->over = false;
+    game->scheduled = false;
+    game->history.push_back(game->board.key());
+    return game;
+}
+
+//the current position is always last in the history, and put back on unpacking
+bool GameServer::pack_game(const HostedGame& game, Snapshot& snapshot, std::vector<uint64_t>& earlier) {
+    earlier.assign(game.history.begin(), game.history.end() - 1);
+    return pack_snapshot(game.board, game.halfmove_clock, game.over, snapshot);
+}
+
+std::shared_ptr<GameServer::HostedGame> GameServer::unpack_game(uint32_t id, const Snapshot& snapshot,
+                                                                std::vector<uint64_t>& earlier) {
+    std::shared_ptr<HostedGame> game = std::make_shared<HostedGame>();
+    unpack_snapshot(snapshot, game->board, game->halfmove_clock, game->over);
+    game->history.swap(earlier);
+    game->history.push_back(game->board.key());
+    game->id = id;
+    game->scheduled = false;
+    return game;
+}
+
+bool GameServer::open_journal(const std::string& directory) {
+    Checkpoint recovered;
+    auto rules = [this](Checkpoint& checkpoint, const std::vector<JournalRecord>& records) {
+        replay(checkpoint, records);
+    };
+    if (!_journal.open(directory, rules, recovered)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(_table_lock);
+    TableEntry closed = {nullptr, NO_RECORD};
+    _table.assign(recovered.created, closed);
+    for (size_t i = 0; i < recovered.games.size(); i++) {
+        CheckpointGame& game = recovered.games[i];
+        TableEntry& entry = _table[game.id - 1];
+        if (!_store.put(game.snapshot, game.history, entry.record)) {
+            return false;
+        }
+        _games++;
+    }
+    return true;
+}
+
+//games the records touch are unpacked once and packed again at the end
+void GameServer::replay(Checkpoint& checkpoint, const std::vector<JournalRecord>& records) {
+    std::map<uint32_t, size_t> stored;
+    for (size_t i = 0; i < checkpoint.games.size(); i++) {
+        stored[checkpoint.games[i].id] = i;
+    }
+    std::map<uint32_t, std::shared_ptr<HostedGame> > live;
+    for (size_t i = 0; i < records.size(); i++) {
+        const JournalRecord& record = records[i];
+        if (record.kind == JOURNAL_NEW && record.game > 0 && record.value <= VARIANT_SPOOKY) {
+            live[record.game] = start_game(static_cast<Variant>(record.value));
+            live[record.game]->id = record.game;
+            checkpoint.created = std::max(checkpoint.created, record.game);
+            continue;
+        }
+        auto found = live.find(record.game);
+        if (found == live.end()) {
+            auto packed = stored.find(record.game);
+            if (packed == stored.end()) {
+                continue;
+            }
+            CheckpointGame& game = checkpoint.games[packed->second];
+            found = live.insert(std::make_pair(game.id, unpack_game(game.id, game.snapshot, game.history))).first;
+            game.id = 0;
+            stored.erase(packed);
+        }
+        if (record.kind == JOURNAL_MOVE) {
+            JournalRecord ignored;
+            play_move(*found->second, move_to_string(record.value), ignored);
+        } else if (record.kind == JOURNAL_CLOSE) {
+            live.erase(found);
+        }
+    }
+    std::vector<CheckpointGame> games;
+    for (size_t i = 0; i < checkpoint.games.size(); i++) {
+        if (checkpoint.games[i].id != 0) {
+            games.push_back(std::move(checkpoint.games[i]));
+        }
+    }
+    for (auto it = live.begin(); it != live.end(); ++it) {
+        CheckpointGame game;
+        game.id = it->first;
+        if (pack_game(*it->second, game.snapshot, game.history)) {
+            games.push_back(std::move(game));
+        }
+    }
+    std::sort(games.begin(), games.end(), [](const CheckpointGame& a, const CheckpointGame& b) {
+        return a.id < b.id;
+    });
+    checkpoint.games.swap(games);
+}
+
+void GameServer::dispatch(const std::shared_ptr<HostedGame>& game, Request request) {
+    {
+        std::lock_guard<std::mutex> guard(game->lock);
+        game->active = std::chrono::steady_clock::now();
+        game->inbox.push_back(std::move(request));
+        if (game->scheduled) {
+            return;
+        }
+        game->scheduled = true;
+    }
+    _pool.submit([this, game] { drain(game); });
+}
+
+//the inbox is swapped out so new requests can queue while these are
+//served; an empty inbox gives up its memory with the swap
+void GameServer::drain(const std::shared_ptr<HostedGame>& game) {
+    std::vector<Request> batch;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(game->lock);
+            batch.clear();
+            batch.swap(game->inbox);
+            if (batch.empty()) {
+                game->scheduled = false;
+                return;
+            }
+        }
+        for (size_t i = 0; i < batch.size(); i++) {
+            JournalRecord record = {game->id, 0, 0};
+            std::string line = serve(*game, batch[i], record);
+            reply(batch[i].client, line, record);
+        }
+    }
+}
+
+std::string GameServer::serve(HostedGame& game, const Request& request, JournalRecord& record) {
+    std::string id = std::to_string(game.id);
+    if (request.command == "move") {
+        return play_move(game, request.argument, record);
+    } else if (request.command == "fen") {
+        return id + " fen " + board_to_fen(game.board, game.halfmove_clock);
+    } else if (request.command == "legal") {
+        std::string reply = id + " legal";
+        MoveList list;
+        if (!game.over) {
+            game.board.generate_moves(list);
+        }
+        for (int i = 0; i < list.size; i++) {
+            reply += " " + move_to_string(list.moves[i]);
+        }
+        return reply;
+    } else if (request.command == "close") {
+        //requests already queued behind this one find the game over
+        game.over = true;
+        std::lock_guard<std::mutex> guard(_table_lock);
+        TableEntry& entry = _table[game.id - 1];
+        if (entry.game.get() == &game) {
+            entry.game.reset();
+            _games--;
+            _resident--;
+            record.kind = JOURNAL_CLOSE;
+        }
+        return id + " closed";
+    }
+    return "error " + id + " unknown command";
+}
+
+std::string GameServer::play_move(HostedGame& game, const std::string& text, JournalRecord& record) {
+    std::string id = std::to_string(game.id);
+    if (game.over) {
+        return "error " + id + " game over";
+    }
+    Board& b = game.board;
+    Move m = b.parse_move(text);
+    if (m == NO_MOVE) {
+        return "error " + id + " illegal move " + text;
+    }
+    Player us = b.side();
+    bool capture = (move_flags(m) & FLAG_CAPTURE) != 0;
+    bool reversible = !capture && code_type(b.at(move_from(m))) != PAWN_ENUM;
+    int pieces = piece_count(b);
+    record.kind = JOURNAL_MOVE;
+    record.value = m;
+    Rng rng = b.rng();
+    Player winner;
+    game.over = b.play(m, rng, winner);
+    b.set_rng(rng);
+    //a piece the ghost landed on is a capture too, as in SpookyChessGame::make_move
+    if (piece_count(b) < pieces - (capture ? 1 : 0)) {
+        reversible = false;
+    }
+    game.halfmove_clock = reversible ? game.halfmove_clock + 1 : 0;
+    if (!reversible) {
+        std::vector<uint64_t>().swap(game.history);
+    }
+    game.history.push_back(b.key());
+    std::string move = move_to_string(m);
+    const char* reason = nullptr;
+    if (game.over) {
+        if (winner == NO_ONE) {
+            reason = "stalemate";
+        } else {
+            reason = b.variant() == VARIANT_KOTH && b.on_hill(us) ? "hill" : "checkmate";
+        }
+    } else if ((reason = draw_reason(game)) != nullptr) {
+        game.over = true;
+        winner = NO_ONE;
+    }
+    if (!game.over) {
+        return id + " ok " + move + (b.in_check(b.side()) ? " check" : "");
+    }
+    const char* result = winner == WHITE ? "1-0" : (winner == BLACK ? "0-1" : "1/2-1/2");
+    return id + " over " + move + " " + result + " " + reason;
+}
+
+const char* GameServer::draw_reason(const HostedGame& game) const {
+    const std::vector<uint64_t>& history = game.history;
+    size_t n = history.size();
+    int seen = 0;
+    for (size_t back = 0; back < n; back += 2) {
+        if (history[n - 1 - back] == history[n - 1]) {
+            seen++;
+        }
+    }
+    if (seen >= 3) {
+        return "repetition";
+    }
+    if (game.halfmove_clock >= 100) {
+        return "fifty";
+    }
+    const Board& b = game.board;
+    if (b.variant() != VARIANT_KOTH &&
+        (b.insufficient_material() || (b.variant() == VARIANT_CHESS && Tablebases::shared().dead_draw(b)))) {
+        return "material";
+    }
+    return nullptr;
+}
+
+void GameServer::reply(const std::shared_ptr<Connection>& client, const std::string& line,
+                       const JournalRecord& record) {
+    if (!_journal.is_open()) {
+        send(client, line);
+        return;
+    }
+    //a change the journal lost must not be confirmed; answers that
+    //changed nothing still go out
+    bool change = record.kind != 0;
+    std::string failure = "error " + std::to_string(record.game) + " journal failed";
+    _journal.append(record, [this, client, line, change, failure](bool durable) {
+        send(client, durable || !change ? line : failure);
+    });
+}
+
+void GameServer::send(const std::shared_ptr<Connection>& client, const std::string& line) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (client->closed) {
+        return;
+    }
+    bool idle = client->output.empty();
+    client->output += line;
+    client->output += '\n';
+    //a slow reader gets the rest when its socket has room again
+    if (idle && !flush(*client)) {
+        watch_output(*client, true);
+    }
+}
+
+bool GameServer::flush(Connection& client) {
+    while (!client.closed && !client.output.empty()) {
+        ssize_t sent = ::send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0) {
+            //a broken socket is noticed, and dropped, by the next read
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client.output.clear();
+            }
+            break;
+        }
+        client.output.erase(0, (size_t) sent);
+    }
+    return client.output.empty();
+}
+
+void GameServer::watch_output(Connection& client, bool output) {
+    struct epoll_event event;
+    event.events = output ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.fd = client.fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, client.fd, &event);
+}
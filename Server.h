@@ -0,0 +1,199 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Board.h"
+#include "Journal.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+/*
+Hosts any number of games of every variant in one process, for clients
+of a Unix domain socket speaking a line protocol:
+
+    new chess|king|spooky      -> game <id>
+    move <id> <move>           -> <id> ok <move> [check]
+                                  <id> over <move> <result> <reason>
+    fen <id>                   -> <id> fen <FEN>
+    legal <id>                 -> <id> legal <move> ...
+    close <id>                 -> <id> closed
+    stats                      -> stats games <n> resident <n> threads <n>
+    quit
+
+Moves are in coordinate notation ("e2e4", "e7e8q"), results as in PGN
+and the reasons are checkmate, hill, stalemate, repetition, fifty and
+material. Failures answer "error <id> <message>".
+
+One thread multiplexes the sockets with epoll; game commands run on a
+work-stealing ThreadPool. Each game is served by at most one task at a
+time, which works through the game's inbox in arrival order, so a game
+needs no lock while its moves are made and different games never wait
+for each other. A game is a Board with the clocks of the draw rules, a
+few hundred bytes, and stays until closed whoever created it.
+
+Games left alone for a while hibernate: they are packed into a 40-byte
+Snapshot in a SnapshotStore and woken up again by their next command, so
+memory grows with the games being played rather than all games hosted.
+
+With a journal every game created, move made and game closed is written
+to a MoveJournal before it is answered, and the games it holds are back
+after a restart, hibernating until their next command.
+*/
+
+class GameServer {
+
+public:
+
+    // Serve game commands on `threads' workers, one per core when zero
+    GameServer(int threads = 0);
+
+    ~GameServer();
+
+    // Create the socket at `path', replacing a stale one. False on errors.
+    bool listen(const std::string& path);
+
+    // Serve clients until stop() is called
+    void run();
+
+    // Make run() return (thread and async-signal safe)
+    void stop();
+
+    // Hibernate games idle for `seconds' (never when zero, the default)
+    void set_idle(int seconds) { _idle = std::chrono::seconds(seconds); }
+
+    // Keep hibernated games in a file instead of anonymous memory.
+    // False if it can't be created.
+    bool open_store(const std::string& path) { return _store.open(path); }
+
+    // Recover the games journaled in `directory' and journal everything
+    // from now on. False if the directory can't be used. Call before run(),
+    // and after open_store().
+    bool open_journal(const std::string& directory);
+
+    // Number of games being hosted
+    size_t games();
+
+    // Number of games not hibernating
+    size_t resident();
+
+private:
+
+    struct Connection;
+
+    // A game command waiting for its game
+    struct Request {
+        std::shared_ptr<Connection> client;
+        std::string command;
+        std::string argument;
+    };
+
+    struct HostedGame {
+        Board board;
+        uint32_t id;
+        int halfmove_clock;
+        bool over;
+        bool scheduled;                     // a task is working through the inbox
+        std::chrono::steady_clock::time_point active;   // last command, set by run()
+        std::vector<uint64_t> history;      // keys since the last capture or pawn move
+        std::vector<Request> inbox;
+        std::mutex lock;                    // guards `scheduled' and `inbox'
+    };
+
+    // A game id: resident, hibernating in a record of the store, or
+    // closed (neither)
+    struct TableEntry {
+        std::shared_ptr<HostedGame> game;
+        uint32_t record;
+    };
+
+    // Before the pool, so that replies of the tasks it finishes on
+    // destruction are still written
+    MoveJournal _journal;
+    ThreadPool _pool;
+    std::mutex _table_lock;
+
+    // Indexed by id - 1, as ids are handed out in order and never reused.
+    // No entry is allocated on its own, so the pages games are allocated
+    // from hold nothing else and go back to the system when they hibernate.
+    std::vector<TableEntry> _table;
+    size_t _games;
+    size_t _resident;
+
+    // Only touched by the thread in run(), under _table_lock
+    SnapshotStore _store;
+    std::chrono::steady_clock::duration _idle;
+    std::chrono::steady_clock::time_point _last_sweep;
+
+    int _listen_fd;
+    int _epoll_fd;
+    int _wake_fd;
+    std::string _path;
+
+    // Connections by socket, only touched by the thread in run()
+    std::map<int, std::shared_ptr<Connection> > _clients;
+
+    void accept_clients();
+
+    void read_client(const std::shared_ptr<Connection>& client);
+
+    void drop_client(const std::shared_ptr<Connection>& client);
+
+    void handle_line(const std::shared_ptr<Connection>& client, const std::string& line);
+
+    // Queue a request for its game, starting a task if none is running
+    void dispatch(const std::shared_ptr<HostedGame>& game, Request request);
+
+    // Work through a game's inbox until it is empty
+    void drain(const std::shared_ptr<HostedGame>& game);
+
+    // Answer one request, filling in the record to journal for it if any
+    std::string serve(HostedGame& game, const Request& request, JournalRecord& record);
+
+    std::string play_move(HostedGame& game, const std::string& text, JournalRecord& record);
+
+    // Send a reply once its record, and every one before it, is journaled,
+    // or an error instead if the journal failed to write it
+    void reply(const std::shared_ptr<Connection>& client, const std::string& line,
+               const JournalRecord& record);
+
+    // Apply journal records to a checkpoint, as the games did
+    void replay(Checkpoint& checkpoint, const std::vector<JournalRecord>& records);
+
+    // Draw by repetition, fifty moves or material, as Game::draw_by_rule
+    const char* draw_reason(const HostedGame& game) const;
+
+    // The game with an id, woken up if it was hibernating
+    std::shared_ptr<HostedGame> find_game(uint32_t id);
+
+    // Pack every game idle for longer than _idle into the store
+    void hibernate_idle();
+
+    // A game in the start position, not in the table yet
+    static std::shared_ptr<HostedGame> start_game(Variant variant);
+
+    // Snapshot and earlier position keys of a game. False if it doesn't fit.
+    static bool pack_game(const HostedGame& game, Snapshot& snapshot, std::vector<uint64_t>& earlier);
+
+    static std::shared_ptr<HostedGame> unpack_game(uint32_t id, const Snapshot& snapshot,
+                                                   std::vector<uint64_t>& earlier);
+
+    // Queue a line for a client and send what the socket takes now
+    void send(const std::shared_ptr<Connection>& client, const std::string& line);
+
+    // Send queued output, true once all of it is gone
+    bool flush(Connection& client);
+
+    void watch_output(Connection& client, bool output);
+
+    GameServer(const GameServer&) = delete;
+    GameServer& operator=(const GameServer&) = delete;
+
+};
+
+#endif // SERVER_H
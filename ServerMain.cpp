@@ -0,0 +1,77 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "Server.h"
+
+/*
+Game server: server [--socket chess.sock] [--threads N] [--idle 60] [--store file]
+                    [--journal directory]
+Hosts games for clients of a Unix domain socket (see Server.h for the
+protocol) until interrupted. Games idle for --idle seconds hibernate (0
+never), in anonymous memory or the --store file. With --journal the games
+are kept in the directory and come back when the server is restarted.
+*/
+
+namespace {
+
+GameServer* running = nullptr;
+
+void shut_down(int) {
+    if (running != nullptr) {
+        running->stop();
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = "chess.sock";
+    std::string store, journal;
+    int threads = 0, idle = 60;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--idle" && i + 1 < argc) {
+            idle = atoi(argv[++i]);
+        } else if (arg == "--store" && i + 1 < argc) {
+            store = argv[++i];
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journal = argv[++i];
+        } else {
+            std::cerr << "Usage: server [--socket chess.sock] [--threads N] [--idle 60] [--store file]"
+                         " [--journal directory]\n";
+            return 1;
+        }
+    }
+    GameServer server(threads);
+    server.set_idle(idle);
+    if (!store.empty() && !server.open_store(store)) {
+        std::cerr << "Could not create " << store << "\n";
+        return 1;
+    }
+    if (!journal.empty() && !server.open_journal(journal)) {
+        std::cerr << "Could not recover the games in " << journal << "\n";
+        return 1;
+    }
+    if (!journal.empty()) {
+        std::cout << "Recovered " << server.games() << " games from " << journal << std::endl;
+    }
+    if (!server.listen(path)) {
+        std::cerr << "Could not listen on " << path << "\n";
+        return 1;
+    }
+    running = &server;
+    std::signal(SIGINT, shut_down);
+    std::signal(SIGTERM, shut_down);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout << "Listening on " << path << std::endl;
+    server.run();
+    running = nullptr;
+    std::cout << "Stopped with " << server.games() << " games" << std::endl;
+    return 0;
+}
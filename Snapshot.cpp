@@ -0,0 +1,146 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Snapshot.h"
+
+namespace {
+
+// Squares of the kings and rooks that may still castle, in bit order
+const int CASTLING_SQUARES[6] = {4, 0, 7, 60, 56, 63};
+
+const uint8_t GHOST_NIBBLE = GHOST_CODE & 15;
+
+const uint8_t OVER_BIT = 0x80;
+
+// Records the store starts with, doubled whenever it runs out
+const size_t FIRST_CAPACITY = 1024;
+
+}
+
+bool pack_snapshot(const Board& b, int halfmove_clock, bool over, Snapshot& s) {
+    if (b.turn() < 0 || b.turn() > 0xFFFF || b.rng().counter() > 0xFFFFFFFFULL ||
+        (b.variant() == VARIANT_SPOOKY && b.rng().seed() != SPOOKY_SEED)) {
+        return false;
+    }
+    std::memset(s.bytes, 0, SNAPSHOT_SIZE);
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        s.bytes[sq / 2] |= (uint8_t) ((b.at(sq) & 15) << (4 * (sq % 2)));
+    }
+    s.bytes[32] = (uint8_t) b.turn();
+    s.bytes[33] = (uint8_t) (b.turn() >> 8);
+    s.bytes[34] = (uint8_t) (halfmove_clock < 127 ? halfmove_clock : 127) | (over ? OVER_BIT : 0);
+    uint8_t flags = (uint8_t) (b.variant() << 6);
+    for (int i = 0; i < 6; i++) {
+        int sq = CASTLING_SQUARES[i];
+        int type = code_type(b.at(sq));
+        if (b.at(sq) != 0 && (type == KING_ENUM || type == ROOK_ENUM) && !b.has_moved(sq)) {
+            flags |= (uint8_t) (1 << i);
+        }
+    }
+    s.bytes[35] = flags;
+    uint32_t counter = (uint32_t) b.rng().counter();
+    for (int i = 0; i < 4; i++) {
+        s.bytes[36 + i] = (uint8_t) (counter >> (8 * i));
+    }
+    return true;
+}
+
+void unpack_snapshot(const Snapshot& s, Board& b, int& halfmove_clock, bool& over) {
+    uint8_t flags = s.bytes[35];
+    b = Board(static_cast<Variant>(flags >> 6));
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t nibble = (s.bytes[sq / 2] >> (4 * (sq % 2))) & 15;
+        if (nibble == 0) {
+            continue;
+        }
+        uint8_t code = nibble == GHOST_NIBBLE ? GHOST_CODE : nibble;
+        int type = code_type(code);
+        b.put(sq, code);
+        b.set_moved(sq, code != GHOST_CODE && (type == KING_ENUM || type == ROOK_ENUM));
+    }
+    for (int i = 0; i < 6; i++) {
+        if (flags & (1 << i)) {
+            b.set_moved(CASTLING_SQUARES[i], false);
+        }
+    }
+    int turn = s.bytes[32] | (s.bytes[33] << 8);
+    b.set_turn(turn);
+    b.set_side(turn % 2 ? WHITE : BLACK);
+    uint32_t counter = 0;
+    for (int i = 0; i < 4; i++) {
+        counter |= (uint32_t) s.bytes[36 + i] << (8 * i);
+    }
+    b.set_rng(Rng(SPOOKY_SEED, counter));
+    b.refresh();
+    halfmove_clock = s.bytes[34] & ~OVER_BIT;
+    over = (s.bytes[34] & OVER_BIT) != 0;
+}
+
+
+SnapshotStore::~SnapshotStore() {
+    if (_records != nullptr) {
+        munmap(_records, _capacity * SNAPSHOT_SIZE);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+bool SnapshotStore::open(const std::string& path) {
+    if (_records != nullptr) {
+        return false;
+    }
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    return _fd >= 0;
+}
+
+bool SnapshotStore::grow() {
+    size_t capacity = _capacity ? _capacity * 2 : FIRST_CAPACITY;
+    size_t length = capacity * SNAPSHOT_SIZE;
+    if (_fd >= 0 && ftruncate(_fd, (off_t) length) != 0) {
+        return false;
+    }
+    void* map;
+    if (_records == nullptr) {
+        map = _fd >= 0 ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0)
+                       : mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        map = mremap(_records, _capacity * SNAPSHOT_SIZE, length, MREMAP_MAYMOVE);
+    }
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    _records = static_cast<uint8_t*>(map);
+    _capacity = capacity;
+    return true;
+}
+
+bool SnapshotStore::put(const Snapshot& s, const std::vector<uint64_t>& history, uint32_t& record) {
+    if (!_free.empty()) {
+        record = _free.back();
+        _free.pop_back();
+    } else {
+        if (_used == _capacity && !grow()) {
+            return false;
+        }
+        record = (uint32_t) _used++;
+    }
+    std::memcpy(_records + (size_t) record * SNAPSHOT_SIZE, s.bytes, SNAPSHOT_SIZE);
+    if (!history.empty()) {
+        _histories[record] = history;
+    }
+    return true;
+}
+
+void SnapshotStore::take(uint32_t record, Snapshot& s, std::vector<uint64_t>& history) {
+    std::memcpy(s.bytes, _records + (size_t) record * SNAPSHOT_SIZE, SNAPSHOT_SIZE);
+    history.clear();
+    auto it = _histories.find(record);
+    if (it != _histories.end()) {
+        history.swap(it->second);
+        _histories.erase(it);
+    }
+    _free.push_back(record);
+}
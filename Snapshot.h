@@ -0,0 +1,83 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Board.h"
+
+/*
+Compact image of a game for hibernation, 40 bytes:
+
+    0-31   the squares, a nibble each (piece code & 15, the ghost as 7)
+    32-33  turn number
+    34     halfmove clock, the top bit set once the game is over
+    35     unmoved kings and rooks on e1 a1 h1 e8 a8 h8 (bits 0-5), variant (6-7)
+    36-39  Spooky Chess generator counter (the seed is always SPOOKY_SEED)
+
+Kings and rooks are the only pieces whose moved flag the rules look at,
+and an unmoved one can only stand on its starting square, so six bits keep
+castling and the position key exactly as they were. Multi-byte fields are
+little-endian.
+*/
+
+static const size_t SNAPSHOT_SIZE = 40;
+
+struct Snapshot {
+    uint8_t bytes[SNAPSHOT_SIZE];
+};
+
+// Pack a position. False if it doesn't fit: a turn beyond 65535, or a
+// ghost generator not seeded with SPOOKY_SEED or past 2^32 numbers.
+bool pack_snapshot(const Board& b, int halfmove_clock, bool over, Snapshot& s);
+
+// Restore what pack_snapshot packed
+void unpack_snapshot(const Snapshot& s, Board& b, int& halfmove_clock, bool& over);
+
+
+// Snapshots in one growing array of 40-byte records, anonymous memory or
+// a file mapped shared, so that the kernel can write idle records out
+// instead of keeping them resident. Freed records are reused. The few
+// position keys a game may still repeat are kept beside its record.
+// Not thread safe.
+class SnapshotStore {
+
+public:
+
+    SnapshotStore() : _records(nullptr), _capacity(0), _used(0), _fd(-1) {}
+
+    ~SnapshotStore();
+
+    // Keep the records in a file from now on, false if it can't be
+    // created. Must be called before the first put().
+    bool open(const std::string& path);
+
+    // Store a snapshot and the keys of the positions since the last capture
+    // or pawn move in `record'. False if the store can't grow.
+    bool put(const Snapshot& s, const std::vector<uint64_t>& history, uint32_t& record);
+
+    // Copy a record out and free it
+    void take(uint32_t record, Snapshot& s, std::vector<uint64_t>& history);
+
+    // Snapshots held
+    size_t size() const { return _used - _free.size(); }
+
+private:
+
+    uint8_t* _records;
+    size_t _capacity;                   // records mapped
+    size_t _used;                       // records ever handed out
+    int _fd;
+    std::vector<uint32_t> _free;
+    std::unordered_map<uint32_t, std::vector<uint64_t> > _histories;
+
+    bool grow();
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,287 @@
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Spectator.h"
+#include "Fen.h"
+#include "Game.h"
+#include "Renderer.h"
+
+//the counters are shared between processes, which only works for
+//atomics that are lock free (and so address free)
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the spectator feed needs lock-free 64-bit atomics");
+
+namespace {
+
+const char MAGIC[8] = {'T', 'C', 'F', 'E', 'E', 'D', '1', 0};
+
+// A reader gives up on a slot rewritten this many times while copying
+const int READ_ATTEMPTS = 100;
+
+}
+
+struct SpectatorFeed::Header {
+    char magic[8];
+    uint32_t slots;
+    uint32_t frame_size;
+    std::atomic<uint64_t> published;
+    std::atomic<uint32_t> closed;
+};
+
+//slots start on a cache line of their own, as does the header in slot 0's place
+struct alignas(64) SpectatorFeed::Slot {
+    std::atomic<uint64_t> sequence;     // odd while the writer is copying
+    SpectatorFrame frame;
+};
+
+static size_t feed_length() {
+    return sizeof(SpectatorFeed::Slot) * (SPECTATOR_SLOTS + 1);
+}
+
+
+std::string spectator_path(const std::string& name) {
+    if (name.empty()) {
+        return "";
+    }
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if (!isalnum((unsigned char) c) && c != '-' && c != '_') {
+            return "";
+        }
+    }
+    return "/dev/shm/terminalchess-" + name;
+}
+
+
+SpectatorFeed::~SpectatorFeed() {
+    close_feed();
+}
+
+void SpectatorFeed::close_feed() {
+    if (_header == nullptr) {
+        return;
+    }
+    _header->closed.store(1, std::memory_order_release);
+    munmap(_header, _length);
+    _header = nullptr;
+    //leave the file alone if another game has taken over the name
+    struct stat st;
+    if (stat(_path.c_str(), &st) == 0 && (uint64_t) st.st_ino == _inode) {
+        unlink(_path.c_str());
+    }
+}
+
+//a new file each time: viewers still mapping an earlier game of the same
+//name keep the old one, which that game marked closed
+bool SpectatorFeed::open(const std::string& name) {
+    std::string path = spectator_path(name);
+    if (path.empty()) {
+        return false;
+    }
+    unlink(path.c_str());
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t length = feed_length();
+    struct stat st;
+    if (ftruncate(fd, (off_t) length) != 0 || fstat(fd, &st) != 0) {
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    void* map = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path.c_str());
+        return false;
+    }
+    close_feed();
+    _path = path;
+    _inode = (uint64_t) st.st_ino;
+    //the header takes the place of slot 0
+    _header = new (map) Header();
+    _header->slots = SPECTATOR_SLOTS;
+    _header->frame_size = sizeof(SpectatorFrame);
+    _slots = reinterpret_cast<Slot*>(static_cast<char*>(map) + sizeof(Slot));
+    for (uint32_t i = 0; i < SPECTATOR_SLOTS; i++) {
+        new (&_slots[i]) Slot();
+    }
+    _length = length;
+    std::memcpy(_header->magic, MAGIC, sizeof(MAGIC));
+    return true;
+}
+
+void SpectatorFeed::publish(int turn, int status, Move move, Variant variant, const std::string& fen) {
+    if (_header == nullptr) {
+        return;
+    }
+    SpectatorFrame frame;
+    std::memset(&frame, 0, sizeof(frame));
+    uint64_t number = _header->published.load(std::memory_order_relaxed) + 1;
+    frame.number = number;
+    frame.turn = turn;
+    frame.status = status;
+    frame.move = move;
+    frame.variant = (uint8_t) variant;
+    std::strncpy(frame.fen, fen.c_str(), sizeof(frame.fen) - 1);
+    Slot& slot = _slots[(number - 1) % SPECTATOR_SLOTS];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.frame, &frame, sizeof(frame));
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    _header->published.store(number, std::memory_order_release);
+}
+
+uint64_t SpectatorFeed::published() const {
+    return _header ? _header->published.load(std::memory_order_relaxed) : 0;
+}
+
+
+SpectatorView::~SpectatorView() {
+    if (_header != nullptr) {
+        munmap(const_cast<SpectatorFeed::Header*>(_header), _length);
+    }
+}
+
+bool SpectatorView::open(const std::string& name) {
+    std::string path = spectator_path(name);
+    int fd = path.empty() ? -1 : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    size_t length = feed_length();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size != length) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    const SpectatorFeed::Header* header = static_cast<const SpectatorFeed::Header*>(map);
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->slots != SPECTATOR_SLOTS ||
+        header->frame_size != sizeof(SpectatorFrame)) {
+        munmap(map, length);
+        return false;
+    }
+    if (_header != nullptr) {
+        munmap(const_cast<SpectatorFeed::Header*>(_header), _length);
+    }
+    _header = header;
+    _slots = reinterpret_cast<const SpectatorFeed::Slot*>(static_cast<const char*>(map) + sizeof(SpectatorFeed::Slot));
+    _length = length;
+    return true;
+}
+
+uint64_t SpectatorView::published() const {
+    return _header ? _header->published.load(std::memory_order_acquire) : 0;
+}
+
+bool SpectatorView::closed() const {
+    return _header && _header->closed.load(std::memory_order_acquire);
+}
+
+//the copy may race with the writer; it is only kept if the sequence shows
+//the writer stayed away from the slot throughout
+bool SpectatorView::latest(SpectatorFrame& frame) const {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+        uint64_t number = published();
+        if (number == 0) {
+            return false;
+        }
+        const SpectatorFeed::Slot& slot = _slots[(number - 1) % SPECTATOR_SLOTS];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        std::memcpy(&frame, &slot.frame, sizeof(frame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before && frame.number == number) {
+            frame.fen[sizeof(frame.fen) - 1] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+//what the last move did, as the game announced it
+static const char* status_text(int status) {
+    switch (status) {
+    case MOVE_CHECK: return "check";
+    case MOVE_CAPTURE: return "capture";
+    case MOVE_CHECKMATE: return "checkmate";
+    case MOVE_STALEMATE: return "stalemate";
+    case MOVE_CAPTURE_HILL: return "king of the hill";
+    case MOVE_DRAW_REPETITION: return "draw by repetition";
+    case MOVE_DRAW_FIFTY_MOVES: return "draw by the fifty-move rule";
+    case MOVE_DRAW_MATERIAL: return "draw by insufficient material";
+    default: return status >= MOVE_CHECKMATE ? "game over" : "";
+    }
+}
+
+//same colours and layout as Game::compose_board, without the graveyards
+void compose_spectator(Renderer& renderer, const SpectatorFrame& frame) {
+    FenPosition fen;
+    Board board;
+    Variant variant = static_cast<Variant>(frame.variant);
+    if (parse_fen(frame.fen, variant, fen)) {
+        fen_to_board(fen, variant, board);
+    }
+    for (int row = 7; row >= 0; row--) {
+        renderer.text(' ');
+        renderer.number(row + 1);
+        renderer.text(' ');
+        for (int column = 0; column < 8; column++) {
+            renderer.color_bg((row + column) % 2 == 1 ? Terminal::Color::GREEN : Terminal::Color::RED);
+            renderer.text(' ');
+            uint8_t code = board.at(make_square(column, row));
+            if (code == GHOST_CODE) {
+                renderer.color_fg(0, Terminal::Color::BLACK);
+                renderer.text("\u2603 ");
+            } else if (code != 0) {
+                Player owner = code_owner(code);
+                renderer.color_fg(0, owner == WHITE ? Terminal::Color::WHITE : Terminal::Color::BLACK);
+                renderer.text(piece_glyph(owner, code_type(code)));
+                renderer.text(' ');
+            } else {
+                renderer.text("  ");
+            }
+            renderer.text(' ');
+        }
+        renderer.set_default();
+        renderer.newline();
+    }
+    renderer.text("   ");
+    for (int column = 0; column < 8; column++) {
+        renderer.text("  ");
+        renderer.text((char) ('a' + column));
+        renderer.text(' ');
+    }
+    renderer.newline();
+    renderer.text("Turn ");
+    renderer.number(frame.turn);
+    renderer.text(frame.turn % 2 ? ", White to move" : ", Black to move");
+    if (frame.move != NO_MOVE) {
+        renderer.text(". Last move ");
+        renderer.text(move_to_string(frame.move));
+    }
+    const char* status = status_text(frame.status);
+    if (*status) {
+        renderer.text(", ");
+        renderer.text(status);
+    }
+    renderer.text('.');
+    renderer.clear_line();
+    renderer.newline();
+}
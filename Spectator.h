@@ -0,0 +1,121 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Board.h"
+
+class Renderer;
+
+/*
+Spectator feed: a game publishes every position it commits into a ring of
+frames in a shared memory file (/dev/shm/terminalchess-<name>), and any
+number of viewer processes map the same file read-only and follow along.
+
+Each slot of the ring is guarded by a sequence lock. The single writer
+makes the slot's sequence odd, copies the frame in and makes it even
+again; a reader copies the frame out and keeps it only if the sequence
+was even and unchanged around the copy. Readers never write to the
+mapping, so however many there are the game never waits for them, and a
+reader that falls a whole ring behind simply skips to the newest frame.
+*/
+
+// Frames kept in the ring
+static const uint32_t SPECTATOR_SLOTS = 64;
+
+// One committed position: FEN (with the Spooky Chess operations), the
+// move that led to it and the game status it ended with
+struct SpectatorFrame {
+    uint64_t number;        // frames published before this one, plus one
+    int32_t turn;
+    int32_t status;         // Game status of the move, SUCCESS if no move
+    uint16_t move;          // NO_MOVE for the first frame and after an undo
+    uint8_t variant;
+    char fen[229];          // nul terminated
+};
+
+// Path of the shared memory file of a feed name, empty if the name
+// has characters other than letters, digits, '-' and '_'
+std::string spectator_path(const std::string& name);
+
+
+// Writing side, owned by the game being watched
+class SpectatorFeed {
+
+public:
+
+    SpectatorFeed() : _header(nullptr), _slots(nullptr), _length(0), _inode(0) {}
+
+    // Marks the feed closed, so viewers know the game has left, and
+    // removes its file. Viewers already following keep their mapping.
+    ~SpectatorFeed();
+
+    // Create (or take over) the file of feed `name'. False on errors.
+    bool open(const std::string& name);
+
+    // Copy a frame into the next slot. Never blocks.
+    void publish(int turn, int status, Move move, Variant variant, const std::string& fen);
+
+    // Frames published so far
+    uint64_t published() const;
+
+    // Layout of the shared file (see Spectator.cpp)
+    struct Header;
+    struct Slot;
+
+private:
+
+    Header* _header;
+    Slot* _slots;
+    size_t _length;
+    std::string _path;
+    uint64_t _inode;        // of the file, which a later feed may replace
+
+    void close_feed();
+
+    //owns its mapping
+    SpectatorFeed(const SpectatorFeed&) = delete;
+    SpectatorFeed& operator=(const SpectatorFeed&) = delete;
+
+};
+
+
+// Reading side, any number per feed
+class SpectatorView {
+
+public:
+
+    SpectatorView() : _header(nullptr), _slots(nullptr), _length(0) {}
+
+    ~SpectatorView();
+
+    // Map the file of feed `name' read-only. False if there is no such feed.
+    bool open(const std::string& name);
+
+    // Frames published so far
+    uint64_t published() const;
+
+    // True once the game has stopped broadcasting
+    bool closed() const;
+
+    // Copy out the newest frame. False if nothing was published yet, or
+    // the writer kept overwriting the slot during every attempt.
+    bool latest(SpectatorFrame& frame) const;
+
+private:
+
+    const SpectatorFeed::Header* _header;
+    const SpectatorFeed::Slot* _slots;
+    size_t _length;
+
+    //owns its mapping
+    SpectatorView(const SpectatorView&) = delete;
+    SpectatorView& operator=(const SpectatorView&) = delete;
+
+};
+
+// Add a frame to a Renderer frame: the board, the move and the status
+void compose_spectator(Renderer& renderer, const SpectatorFrame& frame);
+
+#endif // SPECTATOR_H
@@ -1,18 +1,17 @@
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <string>
 
 #include "Game.h"
 #include "SpookyChessGame.h"
 #include "Prompts.h"
 #include "Piece.h"
-
-#define SEED 322
+#include "Fen.h"
+#include "SaveFile.h"
 
 // Set up the chess board with standard initial pieces
-SpookyChessGame::SpookyChessGame(): Game(), _random_calls(0), _ghost_location(32) {
+SpookyChessGame::SpookyChessGame(): Game(), _rng(SPOOKY_SEED), _ghost_location(32) {
     initialize_factories();
     std::vector<int> pieces {
         ROOK_ENUM, KNIGHT_ENUM, BISHOP_ENUM, QUEEN_ENUM,
@@ -25,82 +24,39 @@ SpookyChessGame::SpookyChessGame(): Game(), _random_calls(0), _ghost_location(32
         init_piece(PAWN_ENUM, BLACK, Position(i, 6));
     }
     init_piece(GHOST_ENUM, NO_ONE, Position(0, 4));
-    srand(SEED);
 }
 
 
-// Set up the chess board with game state loaded from file
-SpookyChessGame::SpookyChessGame(const std::string filename) : Game() {
-
+// Set up the chess board in a position given as FEN. The ghost and the
+// random number generator come from the "ghost" and "rng" operations;
+// without a ghost square it starts on the first empty square from a5.
+SpookyChessGame::SpookyChessGame(const FenPosition& fen) : Game(), _rng(fen.rng_seed, fen.rng_counter) {
     initialize_factories();
-
-    std::ifstream input_file;
-    input_file.open(filename);
-    if (!input_file.is_open()) {
-      Prompts::load_failure();
-      exit(1);
-    }
-    std::string temp;
-    input_file >> temp;
-    if (temp != "spooky") {
-      Prompts::load_failure();
-      input_file.close();
-      exit(1);
+    load_fen(fen);
+    _ghost_location = index(Position(0, 4));
+    if (fen.ghost >= 0) {
+      _ghost_location = index(Position(square_x(fen.ghost), square_y(fen.ghost)));
     }
-    int turn = 0;
-    input_file >> turn;
-    _turn = turn + 1;
-    unsigned int calls = 0;
-    input_file >> calls;
-    _random_calls = calls;
-    srand(SEED);
-    for (unsigned int i = 0; i < calls; i++) {
-      //I don't know if this in an issue with c++ but in Data structures,
-      // they told us that if you call a function in java but don't actually assign
-      // it to anything, Java will be tricky and stop actually executing it
-      turn = rand();
+    while (_pieces[_ghost_location] != nullptr) {
+      _ghost_location = (_ghost_location + 1) % (_width * _height);
     }
-    int player, piece_type;
-    std::string coordinate;
-    while (input_file >> player) {
-      input_file >> coordinate;
-      input_file >> piece_type;
-      int x = (int) coordinate[0] - 97;
-      int y = coordinate[1] - 49;
-      if (piece_type == PieceEnum::GHOST_ENUM) {
-        _ghost_location = index(Position(x, y));
-      }
-      init_piece(static_cast<PieceEnum>(piece_type), static_cast<Player>(player), Position(x, y));
-    }
-    input_file.close();
+    init_piece(GHOST_ENUM, NO_ONE, Position(_ghost_location % _width, _ghost_location / _width));
 }
 
-void SpookyChessGame::save_file() const {
-  Prompts::save_game();
-  std::string filename;
-  std::getline(std::cin, filename);
-  std::ofstream output_file;
-  output_file.open(filename);
-  if (output_file.is_open()) {
-    output_file << return_game_type() << "\n";
-    output_file << turn() - 1  << "\n";
-    output_file << _random_calls << "\n";
-    for (unsigned int x = 0; x < _height; x++) {
-      for (unsigned int y = 0; y < _width; y++) {
-        Piece * p = _pieces[index(Position(y, x))];
-        if (p != nullptr) {
-          output_file << p->owner() << " ";
-          output_file << (char) (y + 97) << x + 1 << " ";
-          output_file << p->piece_type() << "\n";
-        }
+
+// Take the generator and the ghost's square from a loaded game; the ghost
+// stays where it was if the save has none
+void SpookyChessGame::loaded(const SavedGame& saved) {
+    _rng = Rng(saved.rng_seed, saved.rng_counter);
+    _ghost_moves.clear();
+    for (unsigned int i = 0; i < _width * _height; i++) {
+      if (_pieces[i] != nullptr && _pieces[i]->piece_type() == GHOST_ENUM) {
+        _ghost_location = i;
       }
     }
-    output_file.close();
-  } else {
-    Prompts::save_failure();
-  }
 }
 
+
 // Perform a move from the start Position to the end Position
 // The method returns an integer with the status
 // >= 0 is SUCCESS, < 0 is failure
@@ -109,6 +65,11 @@ int SpookyChessGame::make_move(Position start, Position end) {
   if (result < 0) {
     return result;
   }
+  GhostRecord ghost;
+  ghost.rng_counter = _rng.counter();
+  ghost.from = -1;
+  ghost.captured = 0;
+  _ghost_moves.push_back(ghost);
   Player opponent = static_cast<Player>(1 - player_turn());
   if (checked(opponent, _pieces) && !player_can_move(opponent)) {
     Prompts::checkmate(player_turn());
@@ -119,8 +80,10 @@ int SpookyChessGame::make_move(Position start, Position end) {
     Prompts::stalemate();
     return status::MOVE_STALEMATE;
   }
+  _ghost_moves.back().from = (int8_t) _ghost_location;
   if (move_ghost()) {
     Prompts::ghost_capture();
+    _halfmove_clock = 0;
   }
   //wow the ghost can f*** s*** up
   if (checked(opponent, _pieces) && !player_can_move(opponent)) {
@@ -140,30 +103,25 @@ int SpookyChessGame::make_move(Position start, Position end) {
   if (checked(opponent, _pieces) && checked(player_turn(), _pieces)) {
     Prompts::check(player_turn());
     Prompts::check(opponent);
-    _turn++;
-    return status::MOVE_CHECK;
+    return next_turn(status::MOVE_CHECK);
   }
   if (checked(opponent, _pieces)) {
     Prompts::check(player_turn());
-    _turn++;
-    return status::MOVE_CHECK;
+    return next_turn(status::MOVE_CHECK);
   }
   if (checked(player_turn(), _pieces)) {
     Prompts::checkmate(opponent);
     Prompts::win(opponent, _turn);
     return status::MOVE_CHECKMATE;
   }
-  _turn++;
-  return result;
+  return next_turn(result);
 }
 
 //handles movement for the ghost
 bool SpookyChessGame::move_ghost() {
-  unsigned int spot = rand() % (_height * _width);
-  _random_calls++;
+  unsigned int spot = _rng.below(_height * _width);
   while (_pieces[spot] != nullptr && _pieces[spot]->piece_type() == PieceEnum::KING_ENUM) {
-    spot = rand() % (_height * _width);
-    _random_calls++;
+    spot = _rng.below(_height * _width);
   }
   if (spot == _ghost_location) {
     return false;
@@ -174,17 +132,37 @@ bool SpookyChessGame::move_ghost() {
   _pieces[spot] = g;
   _ghost_location = spot;
   if (q != nullptr) {
+    _ghost_moves.back().captured = piece_state(q);
     delete q;
     return true;
   }
   return false;
 }
 
+//the ghost jumped after the move, so it goes back first
+void SpookyChessGame::take_back(const MoveRecord& record) {
+  GhostRecord ghost = _ghost_moves.back();
+  _ghost_moves.pop_back();
+  if (ghost.from >= 0) {
+    unsigned int landed = _ghost_location;
+    if (landed != (unsigned int) ghost.from) {
+      _pieces[ghost.from] = _pieces[landed];
+      _pieces[landed] = nullptr;
+      _ghost_location = ghost.from;
+      if (ghost.captured) {
+        restore_piece(ghost.captured, landed);
+      }
+    }
+    _rng.seek(ghost.rng_counter);
+  }
+  Game::take_back(record);
+}
+
 
 // Report whether the chess game is over
 bool SpookyChessGame::game_over() const {
   Player opponent = static_cast<Player>(1 - player_turn());
-  return !player_can_move(opponent) || !player_can_move(player_turn());
+  return !player_can_move(opponent) || !player_can_move(player_turn()) || draw_by_rule() != 0;
 }
 
 
@@ -1,10 +1,13 @@
 #ifndef SPOOKY_CHESS_GAME_H
 #define SPOOKY_CHESS_GAME_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "Game.h"
 #include "ChessPiece.h"
 #include "Enumerations.h"
+#include "Rng.h"
 
 /*
 Chess game where a non-allied ghost piece teleports around the board at random taking pieces it encounters
@@ -17,8 +20,8 @@ public:
     // Creates new game in standard start-of-game state
     SpookyChessGame();
 
-    // Creates game with state indicated in specified file
-    SpookyChessGame(std::string filename);
+    // Creates game in the position described by a parsed FEN
+    SpookyChessGame(const FenPosition& fen);
 
     // Perform a move from the start Position to the end Position
     // The method returns an integer with the status
@@ -28,20 +31,36 @@ public:
     // Reports whether the chess game is over
     virtual bool game_over() const override;
 
+    // The generator that moves the ghost
+    virtual const Rng* rng() const override { return &_rng; }
+
 protected:
 
     // Create all needed factories for the kinds of pieces
     // used in chess (doesn't make the actual pieces)
     virtual void initialize_factories();
 
-    virtual void save_file() const;
-
     virtual std::string return_game_type() const override { return "spooky";}
 
+    // Also puts the ghost, whatever it took and its generator back
+    virtual void take_back(const MoveRecord& record) override;
+
+    // The generator and the ghost's square of a loaded game
+    virtual void loaded(const SavedGame& saved) override;
+
 //private methods
 private:
 
-    unsigned int _random_calls;
+    // What the ghost's jump after a move changed, kept alongside _moves
+    struct GhostRecord {
+        uint64_t rng_counter;     // generator position before the jump
+        int8_t from;              // where the ghost jumped from, -1 if it didn't
+        uint8_t captured;         // piece the ghost took, 0 if none
+    };
+
+    Rng _rng;
+
+    std::vector<GhostRecord> _ghost_moves;
 
     bool move_ghost();
 
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "Suite.h"
+#include "Fen.h"
+#include "Pgn.h"
+#include "ThreadPool.h"
+
+namespace {
+
+//moves of a "bm"/"am" operand, SAN first and coordinates otherwise
+bool parse_moves(const Board& b, const std::string& operand, std::vector<Move>& moves, std::string& error) {
+    std::istringstream is(operand);
+    std::string text;
+    while (is >> text) {
+        Move m = parse_san(b, text.c_str());
+        if (m == NO_MOVE) {
+            m = b.parse_move(text);
+        }
+        if (m == NO_MOVE) {
+            error = "not a legal move: " + text;
+            return false;
+        }
+        moves.push_back(m);
+    }
+    return true;
+}
+
+}
+
+bool parse_suite_position(const std::string& line, Variant variant, SuitePosition& position, std::string& error) {
+    FenPosition fen;
+    if (!parse_fen(line.c_str(), variant, fen)) {
+        error = "not a FEN or EPD position";
+        return false;
+    }
+    fen_to_board(fen, variant, position.board);
+    position.best.clear();
+    position.avoid.clear();
+    const EpdOperation* bm = fen.operation("bm");
+    const EpdOperation* am = fen.operation("am");
+    if (bm == nullptr && am == nullptr) {
+        error = "no bm or am operation";
+        return false;
+    }
+    if ((bm && !parse_moves(position.board, bm->operand_string(), position.best, error)) ||
+        (am && !parse_moves(position.board, am->operand_string(), position.avoid, error))) {
+        return false;
+    }
+    const EpdOperation* id = fen.operation("id");
+    if (id) {
+        position.id = id->operand_string();
+    }
+    return true;
+}
+
+bool suite_solved(const SuitePosition& position, Move m) {
+    if (m == NO_MOVE) {
+        return false;
+    }
+    if (!position.best.empty() && std::find(position.best.begin(), position.best.end(), m) == position.best.end()) {
+        return false;
+    }
+    return std::find(position.avoid.begin(), position.avoid.end(), m) == position.avoid.end();
+}
+
+
+//every completed iteration is checked, so a right move found early and
+//later dropped doesn't count until the search comes back to it
+SuiteResult SuiteRunner::search(const SuitePosition& position) const {
+    Engine engine(_hash_mb);
+    SuiteResult result;
+    bool settled = false;
+    engine.set_listener([&](const std::vector<PVLine>& lines) {
+        bool right = !lines.empty() && !lines[0].pv.empty() && suite_solved(position, lines[0].pv[0]);
+        if (right && !settled) {
+            result.solved_nodes = engine.nodes();
+            result.solved_milliseconds = engine.elapsed();
+        }
+        settled = right;
+    });
+    std::vector<PVLine> lines = engine.search(position.board, _limits);
+    result.nodes = engine.nodes();
+    result.milliseconds = engine.elapsed();
+    if (!lines.empty() && !lines[0].pv.empty()) {
+        result.move = lines[0].pv[0];
+        result.score = lines[0].score;
+        result.depth = lines[0].depth;
+    }
+    result.solved = settled && suite_solved(position, result.move);
+    if (!result.solved) {
+        result.solved_nodes = 0;
+        result.solved_milliseconds = 0;
+    }
+    return result;
+}
+
+void SuiteRunner::run(const std::vector<SuitePosition>& positions, std::vector<SuiteResult>& results) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    _report = SuiteReport();
+    results.assign(positions.size(), SuiteResult());
+    std::mutex report;
+    {
+        ThreadPool pool(_threads);
+        for (size_t i = 0; i < positions.size(); i++) {
+            pool.submit([this, i, &positions, &results, &report]() {
+                SuiteResult r = search(positions[i]);
+                std::lock_guard<std::mutex> lock(report);
+                results[i] = r;
+                _report.positions++;
+                _report.nodes += r.nodes;
+                if (r.solved) {
+                    _report.solved++;
+                    _report.solved_nodes += r.solved_nodes;
+                    _report.solved_milliseconds += (uint64_t) r.solved_milliseconds;
+                }
+                if (_listener) {
+                    _listener(positions[i], r);
+                }
+            });
+        }
+        pool.wait();
+    }
+    _report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SuiteRunner::print_report(std::ostream& os) const {
+    double rate = _report.seconds > 0 ? _report.nodes / _report.seconds : 0;
+    //nodes to solution are the same on any machine under a node limit, times are not
+    double mean_nodes = _report.solved > 0 ? (double) _report.solved_nodes / _report.solved : 0;
+    double mean = _report.solved > 0 ? (double) _report.solved_milliseconds / _report.solved : 0;
+    os << "positions:        " << _report.positions << "\n"
+       << "solved:           " << _report.solved << "\n"
+       << "unsolved:         " << _report.positions - _report.solved << "\n"
+       << "mean solve ms:    " << std::fixed << std::setprecision(1) << mean << "\n"
+       << "mean solve nodes: " << std::setprecision(0) << mean_nodes << "\n"
+       << "nodes:            " << _report.nodes << "\n"
+       << "seconds:          " << std::setprecision(3) << _report.seconds << "\n"
+       << "nodes/second:     " << std::setprecision(0) << rate << "\n";
+}
@@ -0,0 +1,101 @@
+#ifndef SUITE_H
+#define SUITE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Board.h"
+#include "Engine.h"
+
+/*
+Engine test suites: EPD positions whose "bm" moves the engine should find
+or whose "am" moves it should avoid, searched in parallel on a ThreadPool,
+one position per worker. Every position gets an Engine of its own with one
+search thread and its own transposition table, so its result doesn't
+depend on which positions ran before it or next to it, and a suite run
+with a node limit gives the same results on any number of threads.
+
+A position counts as solved when the move of the last completed iteration
+is right. Its time to solution is when the search settled on a right move
+for good: the first iteration whose move and every later one were right.
+*/
+
+struct SuitePosition {
+    std::string id;                 // EPD "id", or the line number
+    Board board;
+    std::vector<Move> best;         // bm moves
+    std::vector<Move> avoid;        // am moves
+};
+
+struct SuiteResult {
+    Move move;                      // the engine's choice
+    int score;
+    int depth;
+    uint64_t nodes;
+    int milliseconds;
+    bool solved;
+    uint64_t solved_nodes;          // when solved: nodes and milliseconds
+    int solved_milliseconds;        // at the time to solution
+
+    SuiteResult() : move(NO_MOVE), score(0), depth(0), nodes(0), milliseconds(0),
+                    solved(false), solved_nodes(0), solved_milliseconds(0) {}
+};
+
+// Totals over a suite
+struct SuiteReport {
+    unsigned long positions;
+    unsigned long solved;
+    uint64_t nodes;
+    uint64_t solved_nodes;          // summed over the solved positions
+    uint64_t solved_milliseconds;   // at their times to solution
+    double seconds;                 // wall clock for the whole suite
+
+    SuiteReport() : positions(0), solved(0), nodes(0), solved_nodes(0), solved_milliseconds(0), seconds(0) {}
+};
+
+// Parse an EPD line with "bm" or "am" moves, in SAN or coordinates.
+// Returns false with a reason in `error' if it isn't a suite position.
+bool parse_suite_position(const std::string& line, Variant variant, SuitePosition& position, std::string& error);
+
+
+class SuiteRunner {
+
+public:
+
+    // Called from the worker as each position finishes, one at a time
+    typedef std::function<void(const SuitePosition&, const SuiteResult&)> Listener;
+
+    // Search with `limits' on `threads' workers (one per core when zero),
+    // each engine with a `hash_mb' megabyte transposition table
+    SuiteRunner(const SearchLimits& limits, int threads = 0, size_t hash_mb = 16)
+        : _limits(limits), _threads(threads), _hash_mb(hash_mb) {}
+
+    void set_listener(Listener listener) { _listener = listener; }
+
+    // Search every position, filling `results' in the same order
+    void run(const std::vector<SuitePosition>& positions, std::vector<SuiteResult>& results);
+
+    const SuiteReport& report() const { return _report; }
+
+    // Print solved counts, mean time and nodes to solution and nodes per second
+    void print_report(std::ostream& os) const;
+
+private:
+
+    SearchLimits _limits;
+    int _threads;
+    size_t _hash_mb;
+    Listener _listener;
+    SuiteReport _report;
+
+    SuiteResult search(const SuitePosition& position) const;
+
+};
+
+// Whether `m' answers the position: one of its bm moves, or none of its am moves
+bool suite_solved(const SuitePosition& position, Move m);
+
+#endif // SUITE_H
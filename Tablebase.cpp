@@ -0,0 +1,455 @@
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Tablebase.h"
+#include "Piece.h"
+
+namespace {
+
+// Piece types after the kings, strongest first, and their letters
+const int ORDER[5] = {QUEEN_ENUM, ROOK_ENUM, BISHOP_ENUM, KNIGHT_ENUM, PAWN_ENUM};
+const char LETTERS[] = "QRBNP";
+const int VALUES[5] = {9, 5, 3, 3, 1};
+
+const char MAGIC[4] = {'T', 'C', 'T', 'B'};
+
+// Symmetries folding the white king onto its part of the board
+const int FLIP_FILE = 1, FLIP_RANK = 2, TRANSPOSE = 4;
+
+int order_of(int type) {
+    for (int i = 0; i < 5; i++) {
+        if (ORDER[i] == type) return i;
+    }
+    return -1;
+}
+
+uint8_t swap_colour(uint8_t code) {
+    return piece_code(code_type(code), static_cast<Player>(1 - code_owner(code)));
+}
+
+int symmetry(int king, bool pawns) {
+    int ops = 0;
+    if (square_x(king) > 3) {
+        ops |= FLIP_FILE;
+        king ^= 7;
+    }
+    if (!pawns) {
+        if (square_y(king) > 3) {
+            ops |= FLIP_RANK;
+            king ^= 56;
+        }
+        if (square_y(king) > square_x(king)) {
+            ops |= TRANSPOSE;
+        }
+    }
+    return ops;
+}
+
+int apply(int sq, int ops) {
+    if (ops & FLIP_FILE) sq ^= 7;
+    if (ops & FLIP_RANK) sq ^= 56;
+    if (ops & TRANSPOSE) sq = make_square(square_y(sq), square_x(sq));
+    return sq;
+}
+
+//white king squares: a1-d1-d4 without pawns, files a-d with them
+struct KingSlots {
+    int slot[2][64];
+    int square[2][32];
+
+    KingSlots() {
+        int count[2] = {0, 0};
+        for (int sq = 0; sq < 64; sq++) {
+            int x = square_x(sq), y = square_y(sq);
+            slot[0][sq] = slot[1][sq] = -1;
+            if (x <= 3 && y <= x) {
+                square[0][count[0]] = sq;
+                slot[0][sq] = count[0]++;
+            }
+            if (x <= 3) {
+                square[1][count[1]] = sq;
+                slot[1][sq] = count[1]++;
+            }
+        }
+    }
+};
+
+const KingSlots& king_slots() {
+    static const KingSlots slots;
+    return slots;
+}
+
+//a king and rook that could still castle change the position's value
+bool castling_possible(const Board& b) {
+    for (int p = WHITE; p <= BLACK; p++) {
+        int rank = p == WHITE ? 0 : 7;
+        int king = make_square(4, rank);
+        if (b.at(king) != piece_code(KING_ENUM, static_cast<Player>(p)) || b.has_moved(king)) continue;
+        for (int x = 0; x <= 7; x += 7) {
+            int rook = make_square(x, rank);
+            if (b.at(rook) == piece_code(ROOK_ENUM, static_cast<Player>(p)) && !b.has_moved(rook)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
+
+
+uint8_t tb_value(const TbResult& result) {
+    if (result.outcome == TB_WIN) {
+        return (uint8_t) std::min(127, (result.plies + 1) / 2);
+    }
+    if (result.outcome == TB_LOSS) {
+        return (uint8_t) (128 + std::min(125, result.plies / 2));
+    }
+    return 0;
+}
+
+TbResult tb_result(uint8_t value) {
+    if (value >= 1 && value <= 127) {
+        return TbResult(TB_WIN, 2 * value - 1);
+    }
+    if (value >= 128 && value <= 253) {
+        return TbResult(TB_LOSS, 2 * (value - 128));
+    }
+    return TbResult();
+}
+
+
+bool Material::parse(const std::string& name, Material& m) {
+    size_t v = name.find('v');
+    if (v == std::string::npos || name.size() < 3 || name[0] != 'K' || v + 1 >= name.size() || name[v + 1] != 'K') {
+        return false;
+    }
+    int counts[2][5] = {{0}};
+    for (size_t i = 1; i < name.size(); i++) {
+        if (i == v || i == v + 1) continue;
+        const char* letter = std::strchr(LETTERS, name[i]);
+        if (name[i] == '\0' || letter == nullptr) {
+            return false;
+        }
+        counts[i > v][letter - LETTERS]++;
+    }
+    m.count = 0;
+    int total = 2;
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < 5; i++) total += counts[p][i];
+    }
+    if (total > MAX_TB_PIECES) {
+        return false;
+    }
+    m.codes[m.count++] = piece_code(KING_ENUM, WHITE);
+    m.codes[m.count++] = piece_code(KING_ENUM, BLACK);
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < 5; i++) {
+            for (int n = 0; n < counts[p][i]; n++) {
+                m.codes[m.count++] = piece_code(ORDER[i], static_cast<Player>(p));
+            }
+        }
+    }
+    return true;
+}
+
+Material Material::of(const Board& b) {
+    int counts[2][5] = {{0}};
+    int total = 0;
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t c = b.at(sq);
+        if (c == 0 || c == GHOST_CODE) continue;
+        total++;
+        if (code_type(c) != KING_ENUM) {
+            counts[code_owner(c)][order_of(code_type(c))]++;
+        }
+    }
+    Material m;
+    if (total > MAX_TB_PIECES) {
+        m.count = total;
+        return m;
+    }
+    m.codes[m.count++] = piece_code(KING_ENUM, WHITE);
+    m.codes[m.count++] = piece_code(KING_ENUM, BLACK);
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < 5; i++) {
+            for (int n = 0; n < counts[p][i]; n++) {
+                m.codes[m.count++] = piece_code(ORDER[i], static_cast<Player>(p));
+            }
+        }
+    }
+    return m;
+}
+
+std::string Material::name() const {
+    std::string white = "K", black = "K";
+    for (int i = 2; i < count; i++) {
+        char letter = LETTERS[order_of(code_type(codes[i]))];
+        (code_owner(codes[i]) == WHITE ? white : black) += letter;
+    }
+    return white + "v" + black;
+}
+
+Material Material::flipped() const {
+    Material m;
+    m.codes[m.count++] = piece_code(KING_ENUM, WHITE);
+    m.codes[m.count++] = piece_code(KING_ENUM, BLACK);
+    for (int p = BLACK; p >= WHITE; p--) {
+        for (int i = 2; i < count; i++) {
+            if (code_owner(codes[i]) == p) {
+                m.codes[m.count++] = swap_colour(codes[i]);
+            }
+        }
+    }
+    return m;
+}
+
+//more material wins, then the stronger pieces
+bool Material::canonical() const {
+    int value[2] = {0, 0};
+    std::string pieces[2];
+    for (int i = 2; i < count; i++) {
+        int o = order_of(code_type(codes[i]));
+        value[code_owner(codes[i])] += VALUES[o];
+        pieces[code_owner(codes[i])] += (char) ('a' + o);
+    }
+    if (value[WHITE] != value[BLACK]) {
+        return value[WHITE] > value[BLACK];
+    }
+    return pieces[WHITE] <= pieces[BLACK];
+}
+
+bool Material::has_pawns() const {
+    for (int i = 2; i < count; i++) {
+        if (code_type(codes[i]) == PAWN_ENUM) return true;
+    }
+    return false;
+}
+
+uint64_t Material::size() const {
+    uint64_t n = has_pawns() ? 32 : 10;
+    n *= 64;
+    for (int i = 2; i < count; i++) {
+        n *= code_type(codes[i]) == PAWN_ENUM ? 48 : 64;
+    }
+    return n * 2;
+}
+
+bool Material::operator==(const Material& other) const {
+    return count == other.count && std::memcmp(codes, other.codes, count) == 0;
+}
+
+
+uint64_t tb_index(const Material& m, const Board& b) {
+    bool flip = !(Material::of(b) == m);
+    int squares[MAX_TB_PIECES];
+    uint64_t used = 0;
+    for (int i = 0; i < m.count; i++) {
+        uint8_t code = flip ? swap_colour(m.codes[i]) : m.codes[i];
+        for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+            if (b.at(sq) == code && !((used >> sq) & 1)) {
+                used |= 1ULL << sq;
+                squares[i] = flip ? sq ^ 56 : sq;
+                break;
+            }
+        }
+    }
+    bool pawns = m.has_pawns();
+    int ops = symmetry(squares[0], pawns);
+    uint64_t index = king_slots().slot[pawns][apply(squares[0], ops)];
+    for (int i = 1; i < m.count; i++) {
+        int sq = apply(squares[i], ops);
+        if (code_type(m.codes[i]) == PAWN_ENUM) {
+            index = index * 48 + (sq - 8);
+        } else {
+            index = index * 64 + sq;
+        }
+    }
+    //the side to move splits the table in halves, keeping runs of equal values long
+    Player side = flip ? static_cast<Player>(1 - b.side()) : b.side();
+    return side * (m.size() / 2) + index;
+}
+
+bool tb_position(const Material& m, uint64_t index, Board& b) {
+    uint64_t half = m.size() / 2;
+    Player side = static_cast<Player>(index / half);
+    index %= half;
+    int squares[MAX_TB_PIECES];
+    for (int i = m.count - 1; i >= 1; i--) {
+        if (code_type(m.codes[i]) == PAWN_ENUM) {
+            squares[i] = (int) (index % 48) + 8;
+            index /= 48;
+        } else {
+            squares[i] = (int) (index % 64);
+            index /= 64;
+        }
+    }
+    squares[0] = king_slots().square[m.has_pawns()][index];
+    b.clear();
+    for (int i = 0; i < m.count; i++) {
+        if (b.at(squares[i]) != 0) {
+            return false;
+        }
+        b.put(squares[i], m.codes[i]);
+        b.set_moved(squares[i], true);
+    }
+    b.set_side(side);
+    b.refresh();
+    return true;
+}
+
+
+Tablebases::~Tablebases() {
+    for (std::map<std::string, Table>::iterator it = _tables.begin(); it != _tables.end(); ++it) {
+        munmap(it->second.map, it->second.length);
+    }
+}
+
+int Tablebases::load(const std::string& directory) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return 0;
+    }
+    int found = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".tb") == 0 && add(directory + "/" + name)) {
+            found++;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+bool Tablebases::add(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(TbHeader)) {
+        close(fd);
+        return false;
+    }
+    Table t;
+    t.length = (size_t) st.st_size;
+    t.map = mmap(nullptr, t.length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t.map == MAP_FAILED) {
+        return false;
+    }
+    t.header = static_cast<const TbHeader*>(t.map);
+    t.offsets = reinterpret_cast<const uint64_t*>(t.header + 1);
+    t.data = reinterpret_cast<const uint8_t*>(t.offsets + t.header->blocks + 1);
+    Material m;
+    std::string name(t.header->material, strnlen(t.header->material, sizeof(t.header->material)));
+    size_t data_start = (size_t) (t.data - static_cast<const uint8_t*>(t.map));
+    bool valid = std::memcmp(t.header->magic, MAGIC, 4) == 0 && t.header->version == TB_VERSION &&
+        Material::parse(name, m) && m.size() == t.header->entries && t.header->block_size > 0 &&
+        t.header->blocks == (t.header->entries + t.header->block_size - 1) / t.header->block_size &&
+        data_start <= t.length && t.offsets[t.header->blocks] <= t.length - data_start;
+    if (!valid) {
+        munmap(t.map, t.length);
+        return false;
+    }
+    std::map<std::string, Table>::iterator old = _tables.find(name);
+    if (old != _tables.end()) {
+        munmap(old->second.map, old->second.length);
+    }
+    _tables[name] = t;
+    _max_pieces = std::max(_max_pieces, m.count);
+    return true;
+}
+
+const Tablebases::Table* Tablebases::find(const Board& b, Material& m, bool& flip) const {
+    if (b.variant() != VARIANT_CHESS) {
+        return nullptr;
+    }
+    m = Material::of(b);
+    if (m.count > _max_pieces || castling_possible(b)) {
+        return nullptr;
+    }
+    flip = !m.canonical();
+    if (flip) {
+        m = m.flipped();
+    }
+    std::map<std::string, Table>::const_iterator it = _tables.find(m.name());
+    return it == _tables.end() ? nullptr : &it->second;
+}
+
+bool Tablebases::probe(const Board& b, TbResult& result) const {
+    Material m;
+    bool flip;
+    if (b.variant() == VARIANT_CHESS && Material::of(b).count == 2) {
+        result = TbResult();
+        return true;
+    }
+    const Table* t = find(b, m, flip);
+    if (t == nullptr) {
+        return false;
+    }
+    uint8_t value = read(*t, tb_index(m, b));
+    if (value == TB_ILLEGAL) {
+        return false;
+    }
+    result = tb_result(value);
+    return true;
+}
+
+bool Tablebases::dead_draw(const Board& b) const {
+    Material m;
+    bool flip;
+    if (b.variant() == VARIANT_CHESS && Material::of(b).count == 2) {
+        return true;
+    }
+    const Table* t = find(b, m, flip);
+    return t != nullptr && t->header->wins[WHITE] == 0 && t->header->wins[BLACK] == 0;
+}
+
+int Tablebases::max_plies(const Material& m) const {
+    if (m.count == 2) {
+        return 0;
+    }
+    std::map<std::string, Table>::const_iterator it = _tables.find(m.name());
+    return it == _tables.end() ? -1 : (int) it->second.header->max_plies;
+}
+
+std::string Tablebases::path(const std::string& directory, const Material& m) {
+    return directory + "/" + m.name() + ".tb";
+}
+
+const Tablebases& Tablebases::shared() {
+    //loaded by the first caller, thread safe as a function-local static
+    struct Shared : Tablebases {
+        Shared() {
+            const char* dir = std::getenv("TABLEBASES");
+            load(dir ? dir : "tables");
+        }
+    };
+    static const Shared tables;
+    return tables;
+}
+
+//a header byte below 128 starts that many + 1 literal values, from 128 up
+//it repeats the next value (header - 126) times; each block starts afresh
+uint8_t Tablebases::read(const Table& t, uint64_t index) {
+    uint64_t block = index / t.header->block_size;
+    uint64_t pos = index % t.header->block_size;
+    const uint8_t* p = t.data + t.offsets[block];
+    const uint8_t* end = t.data + t.offsets[block + 1];
+    while (p + 1 < end) {
+        uint64_t header = *p++;
+        uint64_t length = header >= 128 ? header - 126 : header + 1;
+        if (pos < length) {
+            return header >= 128 ? p[0] : p[pos];
+        }
+        pos -= length;
+        p += header >= 128 ? 1 : length;
+    }
+    return TB_ILLEGAL;
+}
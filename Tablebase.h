@@ -0,0 +1,169 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include "Board.h"
+
+/*
+Endgame tablebases for standard chess: for every position of a small set
+of pieces, whether the side to move wins, draws or loses and in how many
+plies mate comes with best play. They are built on this machine by the
+tbgen tool and memory-mapped here for probing.
+
+A table holds one byte per position. Positions are indexed by the
+squares of their pieces, the white king folded onto a quarter of the
+board by symmetry (a tenth without pawns) and pawns only counted on the
+ranks they can stand on. Tables are stored for the stronger side as
+white, the other colour is probed through the mirror image. The bytes
+are run-length encoded in independent blocks, so a probe decodes part of
+one block and the rest of the file is never read. Positions that cannot
+occur are stored as whatever compresses best, so they must not be probed.
+*/
+
+// Most pieces, kings included, a table can hold
+static const int MAX_TB_PIECES = 5;
+
+// Positions per compressed block
+static const uint32_t TB_BLOCK_SIZE = 4096;
+
+// Byte marking positions that can never occur while a table is built
+static const uint8_t TB_ILLEGAL = 255;
+
+// Outcome for the side to move
+enum TbOutcome { TB_LOSS = -1, TB_DRAW = 0, TB_WIN = 1 };
+
+// A probed position: its outcome and the plies to mate (0 for draws)
+struct TbResult {
+    TbOutcome outcome;
+    int plies;
+
+    TbResult(TbOutcome o = TB_DRAW, int p = 0) : outcome(o), plies(p) {}
+};
+
+// Byte of a result: 0 draw, 1-127 win in that many moves, 128 + n lost in n moves
+uint8_t tb_value(const TbResult& result);
+
+TbResult tb_result(uint8_t value);
+
+
+// The pieces of a table in index order: the two kings, then white's and
+// black's other pieces, queens first and pawns last
+struct Material {
+    int count;
+    uint8_t codes[MAX_TB_PIECES];
+
+    Material() : count(0) {}
+
+    // Material of a table name such as "KRPvKR", false if malformed
+    static bool parse(const std::string& name, Material& m);
+
+    // Pieces on a board, count above MAX_TB_PIECES when there are too many
+    static Material of(const Board& b);
+
+    std::string name() const;
+
+    // The same pieces with the colours swapped
+    Material flipped() const;
+
+    // True if white is at least as strong, the way tables are stored
+    bool canonical() const;
+
+    bool has_pawns() const;
+
+    // Number of positions (bytes) in the table
+    uint64_t size() const;
+
+    bool operator==(const Material& other) const;
+};
+
+// Index of a position with material `m' (which may be the board's
+// material or its colour flip)
+uint64_t tb_index(const Material& m, const Board& b);
+
+// Set up the position at `index' in the table of `m'. Returns false when
+// two pieces share a square, so the index is no position at all.
+bool tb_position(const Material& m, uint64_t index, Board& b);
+
+
+// Start of a table file, followed by blocks + 1 data offsets and the data
+struct TbHeader {
+    char magic[4];
+    uint32_t version;
+    char material[16];
+    uint64_t entries;
+    uint32_t block_size;
+    uint32_t blocks;
+    uint64_t wins[2];      // positions won by white and by black
+    uint32_t max_plies;    // longest mate in the table
+    uint32_t reserved;
+};
+
+static const uint32_t TB_VERSION = 1;
+
+
+class Tablebases {
+
+public:
+
+    Tablebases() : _max_pieces(0) {}
+
+    ~Tablebases();
+
+    // Map every table file in the directory, returning how many were found
+    int load(const std::string& directory);
+
+    // Map one table file, false if it is missing or corrupt
+    bool add(const std::string& path);
+
+    // Look up a standard chess position without castling rights. Returns
+    // false if no table covers it.
+    bool probe(const Board& b, TbResult& result) const;
+
+    // True if the position's table has no win for either side, so the
+    // game is drawn whatever is played
+    bool dead_draw(const Board& b) const;
+
+    // Longest mate in the table of `m', -1 if it is not loaded
+    int max_plies(const Material& m) const;
+
+    // Most pieces of any loaded table
+    int max_pieces() const { return _max_pieces; }
+
+    bool empty() const { return _tables.empty(); }
+
+    // File name of a table inside `directory'
+    static std::string path(const std::string& directory, const Material& m);
+
+    // Tables of the directory named by $TABLEBASES ("tables" when unset),
+    // loaded on first use and shared by the engine and the games
+    static const Tablebases& shared();
+
+private:
+
+    struct Table {
+        void* map;
+        size_t length;
+        const TbHeader* header;
+        const uint64_t* offsets;
+        const uint8_t* data;
+    };
+
+    std::map<std::string, Table> _tables;
+    int _max_pieces;
+
+    // The table for the board's pieces, `flip' set when it is stored
+    // with the colours swapped. nullptr if none is loaded.
+    const Table* find(const Board& b, Material& m, bool& flip) const;
+
+    static uint8_t read(const Table& t, uint64_t index);
+
+    //owns its mappings
+    Tablebases(const Tablebases&) = delete;
+    Tablebases& operator=(const Tablebases&) = delete;
+
+};
+
+#endif // TABLEBASE_H
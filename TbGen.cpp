@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "Board.h"
+#include "Piece.h"
+#include "Tablebase.h"
+
+/*
+Endgame tablebase generator:
+    tbgen [--threads N] [--dir tables] KQvK KRvK KPvK ...
+Builds each named table, and first every smaller table its captures and
+promotions lead to, into the directory the games and engine read
+($TABLEBASES, "tables" by default). Tables already there are reused.
+
+Retrograde analysis by levels: after marking mates, stalemates and
+impossible positions, pass n finds the positions whose side to move wins
+(odd n) or loses (even n) in exactly n plies, each thread taking slices
+of the table. A pass only writes values that no other test of the same
+pass reads, so the threads share the table without locks. Whatever is
+left once the passes stop changing anything is a draw.
+*/
+
+namespace {
+
+// Positions not decided yet (never written to a file)
+const uint8_t UNKNOWN = 254;
+
+// Positions handed to a thread at a time
+const uint64_t SLICE = 4096;
+
+//runs of two or more equal values become (header, value) pairs, anything
+//else goes out as literals, up to 128 at a time (see Tablebases::read)
+void pack(const std::vector<uint8_t>& values, std::vector<uint8_t>& out) {
+    size_t i = 0, n = values.size();
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < 129 && values[i + run] == values[i]) run++;
+        if (run >= 2) {
+            out.push_back((uint8_t) (run + 126));
+            out.push_back(values[i]);
+            i += run;
+            continue;
+        }
+        size_t start = i++;
+        while (i < n && i - start < 128 && !(i + 1 < n && values[i + 1] == values[i])) i++;
+        out.push_back((uint8_t) (i - start - 1));
+        out.insert(out.end(), values.begin() + start, values.begin() + i);
+    }
+}
+
+class Generator {
+
+public:
+
+    Generator(const std::string& directory, int threads) : _directory(directory), _threads(threads), _horizon(0) {
+        _tables.load(directory);
+    }
+
+    // Make sure the table of `m' exists, building what it depends on first
+    bool generate(const Material& m);
+
+private:
+
+    std::string _directory;
+    int _threads;
+    Tablebases _tables;
+    std::unique_ptr<std::atomic<uint8_t>[]> _values;
+    Material _material;
+    int _horizon;   // longest mate in the tables this one moves into
+
+    // Run `work(index, board)' over the whole table on every thread,
+    // returning how many calls returned true
+    template <typename Work>
+    uint64_t for_each(Work work);
+
+    // Value for its side to move of the position after a move, UNKNOWN
+    // if it is still undecided
+    uint8_t child_value(const Board& b) const;
+
+    bool build();
+
+    bool write() const;
+
+};
+
+template <typename Work>
+uint64_t Generator::for_each(Work work) {
+    uint64_t size = _material.size();
+    std::atomic<uint64_t> next(0), changed(0);
+    auto run = [&]() {
+        Board b;
+        uint64_t local = 0, first;
+        while ((first = next.fetch_add(SLICE)) < size) {
+            for (uint64_t index = first; index < std::min(size, first + SLICE); index++) {
+                if (work(index, b)) local++;
+            }
+        }
+        changed += local;
+    };
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < _threads; i++) {
+        helpers.push_back(std::thread(run));
+    }
+    run();
+    for (size_t i = 0; i < helpers.size(); i++) {
+        helpers[i].join();
+    }
+    return changed;
+}
+
+bool Generator::generate(const Material& m) {
+    if (m.count <= 2 || _tables.max_plies(m) >= 0) {
+        return true;
+    }
+    //every capture and promotion leads to a smaller or different table
+    std::vector<Material> next;
+    for (int i = 2; i < m.count; i++) {
+        Material less;
+        for (int j = 0; j < m.count; j++) {
+            if (j != i) less.codes[less.count++] = m.codes[j];
+        }
+        next.push_back(less.canonical() ? less : less.flipped());
+        if (code_type(m.codes[i]) == PAWN_ENUM) {
+            Material promoted;
+            Board b;
+            b.put(0, piece_code(KING_ENUM, WHITE));
+            b.put(2, piece_code(KING_ENUM, BLACK));
+            for (int j = 2; j < m.count; j++) {
+                uint8_t code = j == i ? piece_code(QUEEN_ENUM, code_owner(m.codes[j])) : m.codes[j];
+                b.put(8 + j, code);
+            }
+            promoted = Material::of(b);
+            next.push_back(promoted.canonical() ? promoted : promoted.flipped());
+        }
+    }
+    _horizon = 0;
+    for (size_t i = 0; i < next.size(); i++) {
+        if (!generate(next[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < next.size(); i++) {
+        _horizon = std::max(_horizon, _tables.max_plies(next[i]));
+    }
+    _material = m;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::cout << m.name() << ": " << m.size() << " positions" << std::flush;
+    if (!build() || !write() || !_tables.add(Tablebases::path(_directory, m))) {
+        std::cout << "\n";
+        std::cerr << "Could not write " << Tablebases::path(_directory, m) << "\n";
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << ", longest mate " << _tables.max_plies(m) << " plies, " << seconds << " s\n";
+    return true;
+}
+
+uint8_t Generator::child_value(const Board& b) const {
+    Material child = Material::of(b);
+    if (child == _material) {
+        return _values[tb_index(_material, b)].load(std::memory_order_relaxed);
+    }
+    TbResult result;
+    return _tables.probe(b, result) ? tb_value(result) : UNKNOWN;
+}
+
+bool Generator::build() {
+    uint64_t size = _material.size();
+    _values.reset(new std::atomic<uint8_t>[size]);
+    //mates, stalemates and positions that cannot arise
+    for_each([this](uint64_t index, Board& b) {
+        uint8_t value = UNKNOWN;
+        if (!tb_position(_material, index, b) || b.in_check(static_cast<Player>(1 - b.side()))) {
+            value = TB_ILLEGAL;
+        } else if (!b.has_legal_move()) {
+            value = b.in_check(b.side()) ? tb_value(TbResult(TB_LOSS, 0)) : 0;
+        }
+        _values[index].store(value, std::memory_order_relaxed);
+        return false;
+    });
+    //moves into other tables can mate later than anything in this one
+    int quiet = 0;
+    for (int n = 1; (quiet < 2 || n <= _horizon + 1) && n < 2 * 127; n++) {
+        bool winning = n % 2 == 1;
+        uint64_t changed = for_each([this, n, winning](uint64_t index, Board& b) {
+            if (_values[index].load(std::memory_order_relaxed) != UNKNOWN) {
+                return false;
+            }
+            tb_position(_material, index, b);
+            MoveList list;
+            b.generate_moves(list);
+            bool decided = !winning;
+            for (int i = 0; i < list.size; i++) {
+                Undo undo;
+                b.make(list.moves[i], undo);
+                TbResult child = tb_result(child_value(b));
+                b.unmake(list.moves[i], undo);
+                bool child_lost = child.outcome == TB_LOSS && child.plies <= n - 1;
+                bool child_won = child.outcome == TB_WIN && child.plies <= n - 1;
+                if (winning && child_lost) {
+                    decided = true;
+                    break;
+                }
+                if (!winning && !child_won) {
+                    decided = false;
+                    break;
+                }
+            }
+            if (decided) {
+                _values[index].store(tb_value(TbResult(winning ? TB_WIN : TB_LOSS, n)), std::memory_order_relaxed);
+            }
+            return decided;
+        });
+        quiet = changed ? 0 : quiet + 1;
+    }
+    return true;
+}
+
+//independent compressed blocks; impossible positions repeat the value before
+//them, since nobody probes them
+bool Generator::write() const {
+    TbHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "TCTB", 4);
+    header.version = TB_VERSION;
+    std::string name = _material.name();
+    std::strncpy(header.material, name.c_str(), sizeof(header.material) - 1);
+    header.entries = _material.size();
+    header.block_size = TB_BLOCK_SIZE;
+    header.blocks = (uint32_t) ((header.entries + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE);
+    std::vector<uint64_t> offsets(1, 0);
+    std::vector<uint8_t> data, block;
+    uint64_t half = header.entries / 2;
+    for (uint64_t first = 0; first < header.entries; first += TB_BLOCK_SIZE) {
+        uint64_t last = std::min(header.entries, first + TB_BLOCK_SIZE);
+        block.clear();
+        for (uint64_t index = first; index < last; index++) {
+            uint8_t value = _values[index].load(std::memory_order_relaxed);
+            if (value == UNKNOWN) {
+                value = 0;
+            }
+            if (value == TB_ILLEGAL) {
+                value = block.empty() ? 0 : block.back();
+            } else if (tb_result(value).outcome != TB_DRAW) {
+                //tables count wins for white and black, not the side to move
+                TbResult r = tb_result(value);
+                Player side = static_cast<Player>(index / half);
+                header.wins[r.outcome == TB_WIN ? side : 1 - side]++;
+                header.max_plies = std::max(header.max_plies, (uint32_t) r.plies);
+            }
+            block.push_back(value);
+        }
+        pack(block, data);
+        offsets.push_back(data.size());
+    }
+    mkdir(_directory.c_str(), 0755);
+    std::string path = Tablebases::path(_directory, _material);
+    std::string temporary = path + ".tmp";
+    FILE* f = std::fopen(temporary.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1 &&
+        std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+        (data.empty() || std::fwrite(data.data(), 1, data.size(), f) == data.size());
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+}
+
+
+int main(int argc, char* argv[]) {
+    std::string directory = std::getenv("TABLEBASES") ? std::getenv("TABLEBASES") : "tables";
+    int threads = std::max(1, (int) std::thread::hardware_concurrency());
+    std::vector<Material> wanted;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        Material m;
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (Material::parse(arg, m)) {
+            wanted.push_back(m.canonical() ? m : m.flipped());
+        } else {
+            std::cerr << "Not a table: " << arg << " (tables are named like KQvK or KRPvKR, at most "
+                      << MAX_TB_PIECES << " pieces)\n";
+            return 1;
+        }
+    }
+    if (wanted.empty()) {
+        std::cerr << "usage: tbgen [--threads N] [--dir tables] KQvK KRvK ...\n";
+        return 1;
+    }
+    Generator generator(directory, threads);
+    for (size_t i = 0; i < wanted.size(); i++) {
+        if (!generator.generate(wanted[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace {
+
+// Pool and queue the current thread works for, so that tasks submitted
+// from a task stay with the worker that submitted them
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_index = -1;
+
+}
+
+ThreadPool::ThreadPool(int threads) : _queued(0), _pending(0), _next(0), _stopping(false) {
+    if (threads <= 0) {
+        threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 0; i < threads; i++) {
+        _threads.push_back(std::thread(&ThreadPool::work, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (size_t i = 0; i < _threads.size(); i++) {
+        _threads[i].join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    int index = current_pool == this ? current_index : (int) (_next++ % _queues.size());
+    _pending++;
+    _queued++;
+    {
+        std::lock_guard<std::mutex> guard(_queues[index]->lock);
+        _queues[index]->tasks.push_back(std::move(task));
+    }
+    //taking the mutex orders this against a worker about to sleep
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+    }
+    _wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this] { return _pending == 0; });
+}
+
+//own queue from the back, others from the front
+bool ThreadPool::take(int index, Task& task) {
+    size_t count = _queues.size();
+    for (size_t k = 0; k < count; k++) {
+        Queue& queue = *_queues[(index + k) % count];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        _queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(int index) {
+    current_pool = this;
+    current_index = index;
+    for (;;) {
+        Task task;
+        if (take(index, task)) {
+            task();
+            if (--_pending == 0) {
+                std::lock_guard<std::mutex> guard(_mutex);
+                _finished.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this] { return _stopping || _queued > 0; });
+        if (_stopping && _queued == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Work-stealing thread pool. Every worker owns a queue: it runs its own
+tasks newest first, so a task submitted from a worker usually runs on the
+same core while its data is still in cache, and when its queue is empty it
+steals the oldest task of another worker. Tasks submitted from outside the
+pool are dealt out to the queues in turn.
+*/
+
+class ThreadPool {
+
+public:
+
+    typedef std::function<void()> Task;
+
+    // Start `threads' workers, one per core when zero
+    ThreadPool(int threads = 0);
+
+    // Runs the tasks still queued, then joins the workers
+    ~ThreadPool();
+
+    // Queue a task (thread safe)
+    void submit(Task task);
+
+    // Block until every task submitted so far has finished
+    void wait();
+
+    int threads() const { return (int) _threads.size(); }
+
+private:
+
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue> > _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake;        // tasks were queued, or stopping
+    std::condition_variable _finished;    // nothing pending any more
+    std::atomic<size_t> _queued;          // tasks waiting in the queues
+    std::atomic<size_t> _pending;         // tasks queued or running
+    std::atomic<unsigned int> _next;      // queue the next outside task goes to
+    bool _stopping;
+
+    void work(int index);
+
+    // Take a task from the worker's own queue, or steal one
+    bool take(int index, Task& task);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,76 @@
+#include "TranspositionTable.h"
+
+//data layout: move 0-15, score 16-31, depth 32-39, bound 40-41, generation 42-47
+namespace {
+
+uint64_t pack(Move move, int score, int depth, Bound bound, unsigned int generation) {
+    return (uint64_t) move |
+        ((uint64_t) (uint16_t) (int16_t) score << 16) |
+        ((uint64_t) (uint8_t) depth << 32) |
+        ((uint64_t) bound << 40) |
+        ((uint64_t) generation << 42);
+}
+
+int data_depth(uint64_t data) { return (int) ((data >> 32) & 0xFF); }
+unsigned int data_generation(uint64_t data) { return (unsigned int) ((data >> 42) & 63); }
+
+}
+
+
+TranspositionTable::TranspositionTable(size_t megabytes) : _mask(0), _megabytes(0), _generation(0) {
+    resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+    if (megabytes == 0) {
+        megabytes = 1;
+    }
+    //round the slot count down to a power of two so indexing is a mask
+    size_t slots = 1;
+    while (slots * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+        slots *= 2;
+    }
+    _table.reset(new Entry[slots]);
+    _mask = slots - 1;
+    _megabytes = megabytes;
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (uint64_t i = 0; i <= _mask; i++) {
+        _table[i].key.store(0, std::memory_order_relaxed);
+        _table[i].data.store(0, std::memory_order_relaxed);
+    }
+    _generation = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTHit& hit) const {
+    const Entry& e = _table[key & _mask];
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    if ((e.key.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+        return false;
+    }
+    hit.move = (Move) (data & 0xFFFF);
+    hit.score = (int16_t) ((data >> 16) & 0xFFFF);
+    hit.depth = data_depth(data);
+    hit.bound = (Bound) ((data >> 40) & 3);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int depth, Bound bound) {
+    Entry& e = _table[key & _mask];
+    uint64_t old = e.data.load(std::memory_order_relaxed);
+    bool same = (e.key.load(std::memory_order_relaxed) ^ old) == key;
+    //keep a deeper result for the same position unless this one is exact,
+    //and keep deeper results of other positions from the current search
+    if (old != 0 && data_generation(old) == _generation) {
+        if (same && depth < data_depth(old) && bound != BOUND_EXACT) return;
+        if (!same && depth + 2 < data_depth(old)) return;
+    }
+    if (same && move == NO_MOVE) {
+        move = (Move) (old & 0xFFFF);
+    }
+    uint64_t data = pack(move, score, depth < 0 ? 0 : depth, bound, _generation);
+    e.key.store(key ^ data, std::memory_order_relaxed);
+    e.data.store(data, std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "Board.h"
+
+// Kind of bound a stored score represents
+enum Bound {
+    BOUND_NONE = 0,
+    BOUND_UPPER,
+    BOUND_LOWER,
+    BOUND_EXACT
+};
+
+// Result of a successful table lookup
+struct TTHit {
+    Move move;
+    int score;
+    int depth;
+    Bound bound;
+};
+
+/*
+Hash table of previously searched positions shared by every search that
+runs on one Engine. Each slot stores its key xor'ed with its data, so a
+slot torn by two threads writing at once simply fails to match on probe.
+*/
+
+class TranspositionTable {
+
+public:
+
+    // Creates a table using roughly `megabytes' of memory
+    TranspositionTable(size_t megabytes = 16);
+
+    // Reallocate the table, dropping all stored positions
+    void resize(size_t megabytes);
+
+    // Forget all stored positions
+    void clear();
+
+    // Start a new search: entries from older searches become
+    // preferred targets for replacement
+    void new_search() { _generation = (_generation + 1) & 63; }
+
+    // Look up a position. Returns true and fills `hit' when found.
+    bool probe(uint64_t key, TTHit& hit) const;
+
+    // Store the result of searching a position
+    void store(uint64_t key, Move move, int score, int depth, Bound bound);
+
+    // Megabytes currently allocated
+    size_t megabytes() const { return _megabytes; }
+
+private:
+
+    struct Entry {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data;
+    };
+
+    std::unique_ptr<Entry[]> _table;
+    uint64_t _mask;
+    size_t _megabytes;
+    unsigned int _generation;
+
+};
+
+#endif // TRANSPOSITION_TABLE_H
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.h"
+#include "Board.h"
+#include "Engine.h"
+#include "Fen.h"
+
+/*
+Universal Chess Interface front end so the engine can be driven by chess
+GUIs and tournament managers. Commands are read on the main thread while
+the search runs on its own thread, so "stop", "ponderhit" and "isready"
+are answered immediately.
+
+"bench [depth]", also run as "uci bench [depth]", searches the built-in
+bench positions and prints the node total, a signature of the search.
+*/
+
+namespace {
+
+const char* VARIANT_NAMES[3] = {"chess", "kingofthehill", "spooky"};
+
+// Everything the protocol needs between commands
+class UciSession {
+
+public:
+
+    UciSession() : _board(Board::start_position(VARIANT_CHESS)), _variant(VARIANT_CHESS),
+                   _multipv(1), _waiting(false), _ponder_budget(0) {
+        _engine.set_listener([this](const std::vector<PVLine>& lines) { report(lines); });
+        _engine.set_own_book(true);
+    }
+
+    ~UciSession() {
+        stop_search();
+    }
+
+    // Handle one command line. Returns false on "quit".
+    bool process(const std::string& line);
+
+private:
+
+    Engine _engine;
+    Board _board;
+    Variant _variant;
+    int _multipv;
+
+    std::thread _search;
+    std::mutex _mutex;
+    std::condition_variable _released;
+    bool _waiting;    // infinite or ponder search holding back its bestmove
+    int _ponder_budget;
+    std::chrono::steady_clock::time_point _go_time;
+
+    void send(const std::string& line);
+
+    void report(const std::vector<PVLine>& lines);
+
+    void identify();
+
+    void set_option(std::istringstream& is);
+
+    void set_position(std::istringstream& is);
+
+    void go(std::istringstream& is);
+
+    void ponder_hit();
+
+    void stop_search();
+
+};
+
+// Run the bench and print its totals
+void bench(int depth);
+
+std::mutex output_mutex;
+
+void UciSession::send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << '\n' << std::flush;
+}
+
+bool UciSession::process(const std::string& line) {
+    std::istringstream is(line);
+    std::string command;
+    is >> command;
+    if (command == "uci") {
+        identify();
+    } else if (command == "isready") {
+        send("readyok");
+    } else if (command == "ucinewgame") {
+        stop_search();
+        _engine.clear();
+    } else if (command == "setoption") {
+        set_option(is);
+    } else if (command == "position") {
+        set_position(is);
+    } else if (command == "go") {
+        go(is);
+    } else if (command == "stop") {
+        stop_search();
+    } else if (command == "ponderhit") {
+        ponder_hit();
+    } else if (command == "bench") {
+        int depth = BENCH_DEPTH;
+        is >> depth;
+        stop_search();
+        bench(depth);
+    } else if (command == "quit") {
+        stop_search();
+        return false;
+    } else if (!command.empty()) {
+        send("info string unknown command " + command);
+    }
+    return true;
+}
+
+void UciSession::identify() {
+    send("id name TerminalChess");
+    send("id author TerminalChess authors");
+    send("option name Hash type spin default 16 min 1 max 4096");
+    send("option name Threads type spin default 1 min 1 max 64");
+    send("option name MultiPV type spin default 1 min 1 max 64");
+    send("option name Ponder type check default false");
+    send("option name OwnBook type check default true");
+    send("option name UCI_Variant type combo default chess var chess var kingofthehill var spooky");
+    send("uciok");
+}
+
+//setoption name <id> value <x>
+void UciSession::set_option(std::istringstream& is) {
+    std::string token, name, value;
+    is >> token;
+    while (is >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    is >> value;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    int number = std::atoi(value.c_str());
+    stop_search();
+    if (name == "hash") {
+        _engine.set_hash(std::max(1, number));
+    } else if (name == "threads") {
+        _engine.set_threads(std::max(1, number));
+    } else if (name == "multipv") {
+        _multipv = std::max(1, number);
+    } else if (name == "ownbook") {
+        _engine.set_own_book(value == "true");
+    } else if (name == "uci_variant") {
+        for (int v = 0; v < 3; v++) {
+            if (value == VARIANT_NAMES[v]) {
+                _variant = static_cast<Variant>(v);
+                _board = Board::start_position(_variant);
+                return;
+            }
+        }
+        send("info string unknown variant " + value);
+    } else if (name != "ponder") {
+        send("info string unknown option " + name);
+    }
+}
+
+//position startpos|fen <fen> [moves m1 m2 ...]
+void UciSession::set_position(std::istringstream& is) {
+    std::string token;
+    is >> token;
+    Board start = Board::start_position(_variant);
+    if (token == "fen") {
+        std::string fen;
+        while (is >> token && token != "moves") {
+            fen += token + " ";
+        }
+        FenPosition position;
+        if (!parse_fen(fen.c_str(), _variant, position)) {
+            send("info string invalid fen " + fen);
+            return;
+        }
+        fen_to_board(position, _variant, start);
+    } else if (token == "startpos") {
+        is >> token;
+    } else {
+        send("info string unknown position " + token);
+        return;
+    }
+    //the moves are played on a copy, so an illegal one leaves the position alone
+    while (is >> token) {
+        Move m = start.parse_move(token);
+        if (m == NO_MOVE) {
+            send("info string illegal move " + token);
+            return;
+        }
+        Undo undo;
+        start.make(m, undo);
+        //the ghost jumps after every move that doesn't end the game, as in SpookyChessGame::make_move
+        if (_variant == VARIANT_SPOOKY && start.has_legal_move()) {
+            start.move_ghost();
+        }
+    }
+    stop_search();
+    _board = start;
+}
+
+//go [wtime/btime/winc/binc/movestogo/depth/nodes/movetime/infinite/ponder]
+void UciSession::go(std::istringstream& is) {
+    stop_search();
+    _go_time = std::chrono::steady_clock::now();
+    SearchLimits limits;
+    limits.multipv = _multipv;
+    int time[2] = {0, 0}, inc[2] = {0, 0}, moves_to_go = 30;
+    bool infinite = false, ponder = false;
+    std::string token;
+    while (is >> token) {
+        if (token == "wtime") is >> time[WHITE];
+        else if (token == "btime") is >> time[BLACK];
+        else if (token == "winc") is >> inc[WHITE];
+        else if (token == "binc") is >> inc[BLACK];
+        else if (token == "movestogo") is >> moves_to_go;
+        else if (token == "depth") is >> limits.depth;
+        else if (token == "nodes") is >> limits.nodes;
+        else if (token == "movetime") is >> limits.movetime;
+        else if (token == "infinite") infinite = true;
+        else if (token == "ponder") ponder = true;
+    }
+    //spend an even share of the clock plus most of the increment
+    Player us = _board.side();
+    int budget = 0;
+    if (time[us] > 0) {
+        budget = time[us] / std::max(1, moves_to_go) + inc[us] * 3 / 4;
+        budget = std::max(1, std::min(budget, time[us] / 2));
+    }
+    if (!limits.movetime) {
+        limits.movetime = ponder ? 0 : budget;
+    }
+    _ponder_budget = budget;
+    _waiting = infinite || ponder;
+    _search = std::thread([this, limits]() {
+        std::vector<PVLine> lines = _engine.search(_board, limits);
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _released.wait(lock, [this]() { return !_waiting; });
+        }
+        if (lines.empty() || lines[0].pv.empty()) {
+            send("bestmove 0000");
+            return;
+        }
+        std::string best = "bestmove " + move_to_string(lines[0].pv[0]);
+        if (lines[0].pv.size() > 1) {
+            best += " ponder " + move_to_string(lines[0].pv[1]);
+        }
+        send(best);
+    });
+}
+
+//the opponent played the expected move: keep searching on the real clock
+void UciSession::ponder_hit() {
+    if (!_search.joinable()) {
+        return;
+    }
+    if (_ponder_budget) {
+        int since_go = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - _go_time).count();
+        _engine.set_movetime(since_go + _ponder_budget);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _waiting = false;
+    }
+    _released.notify_all();
+}
+
+void UciSession::stop_search() {
+    if (!_search.joinable()) {
+        return;
+    }
+    _engine.stop();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _waiting = false;
+    }
+    _released.notify_all();
+    _search.join();
+}
+
+//info line per Multi-PV line after each completed iteration
+void UciSession::report(const std::vector<PVLine>& lines) {
+    uint64_t nodes = _engine.nodes();
+    int time = _engine.elapsed();
+    for (size_t i = 0; i < lines.size(); i++) {
+        std::ostringstream os;
+        int score = lines[i].score;
+        os << "info depth " << lines[i].depth << " multipv " << i + 1 << " score ";
+        if (score >= MATE_BOUND) {
+            os << "mate " << (MATE_SCORE - score + 1) / 2;
+        } else if (score <= -MATE_BOUND) {
+            os << "mate -" << (MATE_SCORE + score) / 2;
+        } else {
+            os << "cp " << score;
+        }
+        os << " nodes " << nodes << " nps " << nodes * 1000 / (time + 1) << " time " << time << " pv";
+        for (size_t j = 0; j < lines[i].pv.size(); j++) {
+            os << ' ' << move_to_string(lines[i].pv[j]);
+        }
+        send(os.str());
+    }
+}
+
+void bench(int depth) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    BenchReport report = run_bench(std::max(1, std::min(MAX_PLY - 1, depth)), &std::cout);
+    std::cout << "nodes:        " << report.nodes << "\n"
+              << "milliseconds: " << report.milliseconds << "\n"
+              << "nodes/second: " << report.nodes_per_second() << "\n" << std::flush;
+}
+
+}
+
+
+int main(int argc, char* argv[]) {
+    std::ios::sync_with_stdio(false);
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        bench(argc > 2 ? std::atoi(argv[2]) : BENCH_DEPTH);
+        return 0;
+    }
+    UciSession session;
+    std::string line;
+    while (std::getline(std::cin, line) && session.process(line)) {
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "WinEstimator.h"
+#include "Board.h"
+#include "Piece.h"
+
+namespace {
+
+// Rough piece values indexed by PieceEnum, for picking captures
+const int VICTIM_VALUES[7] = {1, 5, 3, 3, 9, 0, 0};
+
+// Playouts handed to a thread at a time
+const uint64_t CHUNK = 16;
+
+//nobody can be mated once only the kings (and the ghost) are left
+bool bare_kings(const Board& b) {
+    for (int sq = 0; sq < BOARD_SQUARES; sq++) {
+        uint8_t c = b.at(sq);
+        if (c != 0 && c != GHOST_CODE && code_type(c) != KING_ENUM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+
+double WinEstimate::probability(Player p) const {
+    if (playouts == 0) {
+        return 0;
+    }
+    return (double) (p == NO_ONE ? draws : wins[p]) / playouts;
+}
+
+double WinEstimate::margin(Player p) const {
+    if (playouts == 0) {
+        return 1;
+    }
+    double q = probability(p);
+    return 1.96 * std::sqrt(q * (1 - q) / playouts);
+}
+
+
+WinEstimator::WinEstimator(int threads) : _threads(threads), _max_plies(300), _stop(false) {
+    if (_threads <= 0) {
+        _threads = std::max(1, (int) std::thread::hardware_concurrency());
+    }
+}
+
+WinEstimate WinEstimator::estimate(const Board& root, uint64_t playouts) {
+    _stop = false;
+    WinEstimate total;
+    //playout k always uses the stream seeded by seeds.at(k)
+    const Rng seeds(root.key());
+    uint64_t round = 256 * (uint64_t) _threads;
+    while (total.playouts < playouts && !_stop) {
+        uint64_t last = std::min(playouts, total.playouts + round);
+        std::atomic<uint64_t> next(total.playouts);
+        std::vector<WinEstimate> tallies(_threads);
+        auto work = [&](int id) {
+            WinEstimate local;
+            uint64_t first;
+            while (!_stop && (first = next.fetch_add(CHUNK)) < last) {
+                for (uint64_t k = first; k < std::min(first + CHUNK, last); k++) {
+                    Rng rng(seeds.at(k));
+                    Player winner = playout(root, rng);
+                    local.playouts++;
+                    if (winner == NO_ONE) {
+                        local.draws++;
+                    } else {
+                        local.wins[winner]++;
+                    }
+                }
+            }
+            tallies[id] = local;
+        };
+        std::vector<std::thread> helpers;
+        for (int id = 1; id < _threads; id++) {
+            helpers.push_back(std::thread(work, id));
+        }
+        work(0);
+        for (size_t i = 0; i < helpers.size(); i++) {
+            helpers[i].join();
+        }
+        for (int id = 0; id < _threads; id++) {
+            total.playouts += tallies[id].playouts;
+            total.wins[WHITE] += tallies[id].wins[WHITE];
+            total.wins[BLACK] += tallies[id].wins[BLACK];
+            total.draws += tallies[id].draws;
+        }
+        if (_listener) {
+            _listener(total);
+        }
+        round *= 2;
+    }
+    return total;
+}
+
+Player WinEstimator::playout(Board b, Rng& rng) const {
+    for (int ply = 0; ply < _max_plies; ply++) {
+        MoveList list;
+        b.generate_moves(list);
+        if (list.size == 0) {
+            return b.in_check(b.side()) ? static_cast<Player>(1 - b.side()) : NO_ONE;
+        }
+        Player winner;
+        if (b.play(pick(b, list, rng), rng, winner)) {
+            return winner;
+        }
+        if (b.variant() != VARIANT_KOTH && bare_kings(b)) {
+            return NO_ONE;
+        }
+    }
+    return NO_ONE;
+}
+
+Move WinEstimator::pick(const Board& b, const MoveList& list, Rng& rng) {
+    if (rng.below(4) != 0) {
+        Move best = NO_MOVE;
+        int best_value = 0;
+        for (int i = 0; i < list.size; i++) {
+            Move m = list.moves[i];
+            if (!(move_flags(m) & FLAG_CAPTURE)) continue;
+            int value = VICTIM_VALUES[code_type(b.at(move_to(m)))];
+            if (value > best_value) {
+                best = m;
+                best_value = value;
+            }
+        }
+        if (best != NO_MOVE) {
+            return best;
+        }
+    }
+    return list.moves[rng.below(list.size)];
+}
@@ -0,0 +1,74 @@
+#ifndef WIN_ESTIMATOR_H
+#define WIN_ESTIMATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "Board.h"
+#include "Rng.h"
+
+/*
+Monte Carlo estimate of each side's chances: many independent random
+playouts from a position, spread over a pool of threads. Every playout
+draws its moves and ghost jumps from its own Rng stream, derived from the
+position and the playout number, so the game's own generator is never
+touched and the result does not depend on the number of threads.
+*/
+
+// Tally of finished playouts
+struct WinEstimate {
+    uint64_t playouts;
+    uint64_t wins[2];
+    uint64_t draws;
+
+    WinEstimate() : playouts(0), draws(0) { wins[WHITE] = wins[BLACK] = 0; }
+
+    // Fraction of playouts won by `p', or drawn for NO_ONE
+    double probability(Player p) const;
+
+    // Half width of the 95% confidence interval of probability(p)
+    double margin(Player p) const;
+};
+
+
+class WinEstimator {
+
+public:
+
+    // Called with the running tally after every round of playouts
+    typedef std::function<void(const WinEstimate&)> Listener;
+
+    // Creates an estimator using `threads' threads (0 for one per core)
+    WinEstimator(int threads = 0);
+
+    // Play `playouts' random games from the position. Rounds double in
+    // size, so the listener sees the interval narrow as samples accumulate.
+    WinEstimate estimate(const Board& root, uint64_t playouts);
+
+    // Ask a running estimate to return after the current round (thread safe)
+    void stop() { _stop = true; }
+
+    void set_listener(Listener listener) { _listener = listener; }
+
+    // Playouts still running after this many plies count as draws
+    void set_max_plies(int plies) { _max_plies = plies; }
+
+    int threads() const { return _threads; }
+
+    // Light policy: three times in four take the most valuable capture, otherwise
+    // any legal move at random
+    static Move pick(const Board& b, const MoveList& list, Rng& rng);
+
+private:
+
+    int _threads;
+    int _max_plies;
+    std::atomic<bool> _stop;
+    Listener _listener;
+
+    // Play one game to its end: the winner, NO_ONE for a draw
+    Player playout(Board b, Rng& rng) const;
+
+};
+
+#endif // WIN_ESTIMATOR_H